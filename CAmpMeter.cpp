@@ -1,6 +1,10 @@
 #include <iostream>
 #include <math.h>
+#include <string.h>
 using namespace std;
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include <SKSLib.h>
 #include "CAmpMeter.h"
@@ -8,6 +12,181 @@ using namespace std;
 #include "CIOWarrior.h"
 #include "CPlayerCVDevice.h"
 
+/*
+ * polyphase coefficients of the 4x oversampling interpolator for the true peak
+ * (ITU-R BS.1770-4, annex 2), phase p: y_p[n] = sum_k tpCoeffs[p][k] * x[n-k]
+ */
+static const float tpCoeffs[4][CAMP_TPTAPS] = {
+	{ 0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f,
+	 -0.0594482421875f, 0.1373291015625f, 0.9721679687500f, -0.1022949218750f,
+	  0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f },
+	{-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f,
+	 -0.1665039062500f, 0.4650878906250f, 0.7797851562500f, -0.2003173828125f,
+	  0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f },
+	{-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f,
+	 -0.2003173828125f, 0.7797851562500f, 0.4650878906250f, -0.1665039062500f,
+	  0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f },
+	{-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f,
+	 -0.1022949218750f, 0.9721679687500f, 0.1373291015625f, -0.0594482421875f,
+	  0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f }
+};
+
+/*
+ * The kernels reduce interleaved samples per channel in one pass. With SSE they
+ * step over lcm(numChan, 4) samples (a whole number of frames and of vectors),
+ * so lane l of vector j of a stride always belongs to channel (4j + l) % numChan
+ * and each vector has an accumulator of its own.
+ *
+ * \return number of vectors per stride (at least 2 to hide the latency of the
+ * accumulating instruction)
+ */
+static int strideVectors(int numChan) {
+	int v = (numChan % 4 == 0) ? numChan / 4 : (numChan % 2 == 0) ? numChan / 2 : numChan;
+	return (v < 2) ? 2 : v;
+}
+
+#ifdef __SSE__
+/*
+ * combines the lanes of the stride accumulators per channel (maximum or sum)
+ */
+static void reduceLanes(const __m128 *acc, int numVectors, int numChan,
+		float *values, bool sum) {
+	float tmp[4];
+	for (int j = 0; j < numVectors; j++) {
+		_mm_storeu_ps(tmp, acc[j]);
+		for (int l = 0; l < 4; l++) {
+			int ch = (4 * j + l) % numChan;
+			if (sum)
+				values[ch] += tmp[l];
+			else
+				values[ch] = fmax(values[ch], tmp[l]);
+		}
+	}
+}
+#endif
+
+/*
+ * values[ch] = max(values[ch], highest absolute sample of channel ch)
+ */
+static void peakPerChannel(const float *x, unsigned long n, int numChan, float *values) {
+	unsigned long i = 0;
+#ifdef __SSE__
+	const __m128 sign = _mm_set1_ps(-0.f);
+	int numVectors = strideVectors(numChan);
+	unsigned long stride = 4 * numVectors;
+	__m128 acc[CAMP_MAXCHANNELS];
+	for (int j = 0; j < numVectors; j++)
+		acc[j] = _mm_setzero_ps();
+	if (numVectors == 2) {		// 1, 2 or 4 channels: accumulators in registers
+		__m128 m0 = acc[0], m1 = acc[1];
+		for (; i + 8 <= n; i += 8) {
+			m0 = _mm_max_ps(_mm_andnot_ps(sign, _mm_loadu_ps(x + i)), m0);
+			m1 = _mm_max_ps(_mm_andnot_ps(sign, _mm_loadu_ps(x + i + 4)), m1);
+		}
+		acc[0] = m0;
+		acc[1] = m1;
+	}
+	for (; i + stride <= n; i += stride)
+		for (int j = 0; j < numVectors; j++)
+			// the accumulator is the second operand, so NaN samples are ignored
+			acc[j] = _mm_max_ps(_mm_andnot_ps(sign, _mm_loadu_ps(x + i + 4 * j)), acc[j]);
+	reduceLanes(acc, numVectors, numChan, values, false);
+#endif
+	for (; i < n; i++) {
+		int ch = i % numChan;
+		if (values[ch] < fabs(x[i]))
+			values[ch] = fabs(x[i]);
+	}
+}
+
+/*
+ * values[ch] += sum of the squared samples of channel ch
+ */
+static void squaresPerChannel(const float *x, unsigned long n, int numChan,
+		float *values) {
+	unsigned long i = 0;
+#ifdef __SSE__
+	int numVectors = strideVectors(numChan);
+	unsigned long stride = 4 * numVectors;
+	__m128 acc[CAMP_MAXCHANNELS];
+	for (int j = 0; j < numVectors; j++)
+		acc[j] = _mm_setzero_ps();
+	if (numVectors == 2) {		// 1, 2 or 4 channels: accumulators in registers
+		__m128 s0 = acc[0], s1 = acc[1];
+		for (; i + 8 <= n; i += 8) {
+			__m128 v0 = _mm_loadu_ps(x + i);
+			__m128 v1 = _mm_loadu_ps(x + i + 4);
+			s0 = _mm_add_ps(s0, _mm_mul_ps(v0, v0));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(v1, v1));
+		}
+		acc[0] = s0;
+		acc[1] = s1;
+	}
+	for (; i + stride <= n; i += stride)
+		for (int j = 0; j < numVectors; j++) {
+			__m128 v = _mm_loadu_ps(x + i + 4 * j);
+			acc[j] = _mm_add_ps(acc[j], _mm_mul_ps(v, v));
+		}
+	reduceLanes(acc, numVectors, numChan, values, true);
+#endif
+	for (; i < n; i++)
+		values[i % numChan] += x[i] * x[i];
+}
+
+/*
+ * values[ch] = max(values[ch], highest absolute value of the interpolated
+ * samples of channel ch of x[from] ... x[to-1])
+ *
+ * (from is a multiple of numChan, x[from - (CAMP_TPTAPS-1)*numChan] must be valid)
+ *
+ * four neighbouring samples are interpolated at a time: each tap is one
+ * (unaligned) load shared by the four phases
+ */
+static void truePeakPerChannel(const float *x, long from, long to, int numChan,
+		float *values) {
+	long i = from;
+#ifdef __SSE__
+	const __m128 sign = _mm_set1_ps(-0.f);
+	__m128 c[4][CAMP_TPTAPS];
+	for (int p = 0; p < 4; p++)
+		for (int k = 0; k < CAMP_TPTAPS; k++)
+			c[p][k] = _mm_set1_ps(tpCoeffs[p][k]);
+	int numVectors = strideVectors(numChan);
+	long stride = 4 * numVectors;
+	__m128 acc[CAMP_MAXCHANNELS];
+	for (int j = 0; j < numVectors; j++)
+		acc[j] = _mm_setzero_ps();
+	for (; i + stride <= to; i += stride) {
+		for (int j = 0; j < numVectors; j++) {
+			const float *xj = x + i + 4 * j;
+			__m128 y0 = _mm_setzero_ps(), y1 = y0, y2 = y0, y3 = y0;
+			for (int k = 0; k < CAMP_TPTAPS; k++) {
+				__m128 v = _mm_loadu_ps(xj - k * numChan);
+				y0 = _mm_add_ps(y0, _mm_mul_ps(c[0][k], v));
+				y1 = _mm_add_ps(y1, _mm_mul_ps(c[1][k], v));
+				y2 = _mm_add_ps(y2, _mm_mul_ps(c[2][k], v));
+				y3 = _mm_add_ps(y3, _mm_mul_ps(c[3][k], v));
+			}
+			__m128 m = _mm_max_ps(_mm_andnot_ps(sign, y0), acc[j]);
+			m = _mm_max_ps(_mm_andnot_ps(sign, y1), m);
+			m = _mm_max_ps(_mm_andnot_ps(sign, y2), m);
+			acc[j] = _mm_max_ps(_mm_andnot_ps(sign, y3), m);
+		}
+	}
+	reduceLanes(acc, numVectors, numChan, values, false);
+#endif
+	for (; i < to; i++) {
+		int ch = i % numChan;
+		for (int p = 0; p < 4; p++) {
+			float y = 0.f;
+			for (int k = 0; k < CAMP_TPTAPS; k++)
+				y += tpCoeffs[p][k] * x[i - k * numChan];
+			if (values[ch] < fabs(y))
+				values[ch] = fabs(y);
+		}
+	}
+}
+
 
 CAmpMeter::CAmpMeter() {
 	m_scmode = SCALING_MODE_LIN;		// logarithmic or linear bar?
@@ -15,6 +194,16 @@ CAmpMeter::CAmpMeter() {
 	for (int i = 0; i < 16; i++)
 		m_thresholds[i] = 0;			// thresholds for the bar with 16 segments
 	m_IoDev = NULL;						// address of the IOWarrior extension board control object (visualizer)
+	m_meterMode = METER_MODE_PEAK;		// value displayed for a data buffer
+	m_tpChannels = 0;					// channels of the true peak history (none yet)
+	m_attack = CAMP_ATTACK;				// ballistics of measure()
+	m_release = CAMP_RELEASE;
+	m_holdTime = CAMP_HOLD;
+	m_envFs = m_envChannels = 0;		// no stream measured yet
+	resetBallistics();
+	m_layout = LAYOUT_COMBINED;			// one bar for all channels
+	m_cycleStart = chrono::steady_clock::now();
+	_buildLUT();
 }
 
 void CAmpMeter::init(CPlayerCVDevice *pIoDev, SCALING_MODE scmode, float inValMin,
@@ -73,13 +262,130 @@ void CAmpMeter::init(CPlayerCVDevice *pIoDev, SCALING_MODE scmode, float inValMi
 		else
 			m_thresholds[i]=(i)*inValMax/16.0;
 	}
+	_buildLUT();
+}
+
+void CAmpMeter::write(float *databuf, unsigned long databufsize, int numChan) {
+	if (NULL == databuf)
+		throw CException(CException::SRC_AmpMeter, AMP_E_NOBUFFER,
+				"Invalid data buffer.");
+	return write(_getValueFromBuffer(databuf, databufsize, numChan));
 }
 
-void CAmpMeter::write(float *databuf, unsigned long databufsize) {
+void CAmpMeter::setMeterMode(METER_MODE mode) {
+	m_meterMode = mode;
+	m_tpChannels = 0;		// the history is stale
+}
+
+CAmpMeter::METER_MODE CAmpMeter::getMeterMode() {
+	return m_meterMode;
+}
+
+float CAmpMeter::getValue(float *databuf, unsigned long databufsize, int numChan) {
+	if (NULL == databuf)
+		throw CException(CException::SRC_AmpMeter, AMP_E_NOBUFFER,
+				"Invalid data buffer.");
+	return _getValueFromBuffer(databuf, databufsize, numChan);
+}
+
+void CAmpMeter::measure(float *databuf, unsigned long databufsize, int numChan,
+		int fs, METERSNAPSHOT &snap) {
 	if (NULL == databuf)
 		throw CException(CException::SRC_AmpMeter, AMP_E_NOBUFFER,
 				"Invalid data buffer.");
-	return write(_getValueFromBuffer(databuf, databufsize));
+	if (numChan < 1)
+		numChan = 1;
+	if ((fs != m_envFs) || (numChan != m_envChannels)) {		// new stream
+		resetBallistics();
+		m_envFs = fs;
+		m_envChannels = numChan;
+	}
+
+	long frames = databufsize / numChan;
+	long segFrames = CAMP_SEGMENT * fs;
+	if (segFrames < 1)
+		segFrames = 1;
+	long numSeg = (frames + segFrames - 1) / segFrames;
+	// a long block is reduced to the number of points that fit into the snapshot (maximum of their segments)
+	int numOut = (numChan > CAMP_MAXCHANNELS) ? 1 : numChan;
+	long maxPoints = METER_MAXVALUES / numOut;
+	if (maxPoints > METER_MAXPOINTS)
+		maxPoints = METER_MAXPOINTS;
+	long segPerPoint = (numSeg + maxPoints - 1) / maxPoints;
+	if (segPerPoint < 1)
+		segPerPoint = 1;
+
+	snap.spectrum = (m_meterMode == METER_MODE_SPECTRUM);
+	if (snap.spectrum) {
+		snap.ringPos = m_spectrum.write(databuf, frames, numChan);
+		snap.fs = fs;
+		snap.frames = frames;
+		snap.numChannels = 1;
+		snap.value[0] = snap.hold[0] = 0.f;
+		snap.numPoints = 0;
+		return;
+	}
+	snap.numChannels = numOut;
+	snap.numPoints = 0;
+	snap.pointDur = (double) (segPerPoint * segFrames) / fs;
+	snap.frames = frames;
+	float values[CAMP_MAXCHANNELS];
+	float *pPoint = snap.points;
+	for (int ch = 0; ch < numOut; ch++)
+		pPoint[ch] = 0.f;
+	long seg = 0;
+	for (long f = 0; f < frames; f += segFrames, seg++) {
+		long n = (frames - f < segFrames) ? frames - f : segFrames;
+		_getChannelValues(databuf + f * numChan, n * numChan, numChan, values);
+		for (int ch = 0; ch < numOut; ch++) {
+			_updateEnvelope(ch, values[ch], (float) n / fs);
+			if (pPoint[ch] < m_env[ch])
+				pPoint[ch] = m_env[ch];
+		}
+		if ((((seg + 1) % segPerPoint == 0) || (f + n >= frames))) {
+			snap.numPoints++;
+			pPoint += numOut;
+			if (snap.numPoints < maxPoints)
+				for (int ch = 0; ch < numOut; ch++)
+					pPoint[ch] = 0.f;
+		}
+	}
+	for (int ch = 0; ch < numOut; ch++) {
+		snap.value[ch] = m_env[ch];
+		snap.hold[ch] = m_hold[ch];
+	}
+}
+
+void CAmpMeter::setBallistics(float attack, float release, float hold) {
+	m_attack = (attack < 0.f) ? 0.f : attack;
+	m_release = (release < 0.f) ? 0.f : release;
+	m_holdTime = (hold < 0.f) ? 0.f : hold;
+}
+
+void CAmpMeter::resetBallistics() {
+	for (int ch = 0; ch < CAMP_MAXCHANNELS; ch++)
+		m_env[ch] = m_hold[ch] = m_holdLeft[ch] = 0.f;
+}
+
+void CAmpMeter::_updateEnvelope(int ch, float value, float dt) {
+	/*
+	 * one pole smoothing with the time constant of the direction: the falling
+	 * envelope decays exponentially, i.e. by a constant number of dB per second
+	 */
+	float tau = (value > m_env[ch]) ? m_attack : m_release;
+	float a = (tau > 0.f) ? 1.f - exp(-dt / tau) : 1.f;
+	m_env[ch] += a * (value - m_env[ch]);
+
+	// the hold value follows a rising envelope at once, stays for the hold time and then falls
+	if (m_env[ch] >= m_hold[ch]) {
+		m_hold[ch] = m_env[ch];
+		m_holdLeft[ch] = m_holdTime;
+	} else if (m_holdLeft[ch] > 0.f)
+		m_holdLeft[ch] -= dt;
+	else {
+		float r = (m_release > 0.f) ? 1.f - exp(-dt / m_release) : 1.f;
+		m_hold[ch] += r * (m_env[ch] - m_hold[ch]);
+	}
 }
 
 void CAmpMeter::writeLEDs(float data) {
@@ -98,6 +404,97 @@ void CAmpMeter::write(double data) {
 	m_IoDev->writeLEDs(_getBarPattern(data));
 }
 
+void CAmpMeter::write(double data, double hold) {
+	if (NULL == m_IoDev)
+		throw CException(CException::SRC_AmpMeter, AMP_E_NOVISUALIZER,
+				"Can't do binary pattern output.");
+
+	// the hold LED is the rightmost LED of the bar of the hold value
+	uint16_t holdBar = _getBarPattern(hold);
+	m_IoDev->writeLEDs(_getBarPattern(data) | (holdBar ^ (holdBar >> 1)));
+}
+
+/*
+ * bar of leds LEDs for a bar length of 16 LEDs (rounded up, so any value above
+ * the first threshold switches on an LED)
+ */
+static int scaleBar(int length, int leds) {
+	return (length * leds + 15) / 16;
+}
+
+void CAmpMeter::write(const float *values, const float *holds, int numChan) {
+	if (NULL == m_IoDev)
+		throw CException(CException::SRC_AmpMeter, AMP_E_NOVISUALIZER,
+				"Can't do binary pattern output.");
+	if (numChan < 1)
+		return;
+
+	uint16_t pattern = 0;
+	if ((m_layout == LAYOUT_SPLIT) && (numChan > 1)) {
+		float v[2] = { 0.f, 0.f }, h[2] = { 0.f, 0.f };
+		for (int ch = 0; ch < numChan; ch++) {
+			v[ch & 1] = fmax(v[ch & 1], values[ch]);
+			h[ch & 1] = fmax(h[ch & 1], holds[ch]);
+		}
+		// left: LEDs 8 ... 1, right: LEDs 9 ... 16
+		int left = scaleBar(_getBarLength(v[0]), 8);
+		int right = scaleBar(_getBarLength(v[1]), 8);
+		pattern = (((1u << left) - 1) << (8 - left)) | (((1u << right) - 1) << 8);
+		int holdLeft = scaleBar(_getBarLength(h[0]), 8);
+		int holdRight = scaleBar(_getBarLength(h[1]), 8);
+		if (holdLeft)
+			pattern |= 1u << (8 - holdLeft);
+		if (holdRight)
+			pattern |= 1u << (7 + holdRight);
+	} else if ((m_layout == LAYOUT_CYCLE) && (numChan > 1)) {
+		double t = chrono::duration<double>(chrono::steady_clock::now() - m_cycleStart).count();
+		int ch = (long) (t / CAMP_CYCLETIME) % numChan;
+		int length = scaleBar(_getBarLength(values[ch]), 11);
+		int hold = scaleBar(_getBarLength(holds[ch]), 11);
+		pattern = (1u << length) - 1;
+		if (hold)
+			pattern |= 1u << (hold - 1);
+		for (int b = 0; b < 5; b++)		// channel number, MSB on LED 12
+			if (ch & (1 << b))
+				pattern |= 1u << (15 - b);
+	} else {		// combined (and a single channel in any layout)
+		float v = 0.f, h = 0.f;
+		for (int ch = 0; ch < numChan; ch++) {
+			v = fmax(v, values[ch]);
+			h = fmax(h, holds[ch]);
+		}
+		int hold = _getBarLength(h);
+		pattern = (1u << _getBarLength(v)) - 1;
+		if (hold)
+			pattern |= 1u << (hold - 1);
+	}
+	m_IoDev->writeLEDs(pattern);
+}
+
+void CAmpMeter::writeSpectrum(unsigned long endPos, int fs) {
+	if (NULL == m_IoDev)
+		throw CException(CException::SRC_AmpMeter, AMP_E_NOVISUALIZER,
+				"Can't do binary pattern output.");
+
+	float bands[SPEC_NUMBANDS];
+	if (!m_spectrum.analyze(endPos, fs, bands))
+		return;		// samples overwritten, the next refresh will show them
+	uint16_t pattern = 0;
+	for (int b = 0; b < SPEC_NUMBANDS; b++)
+		if (_getBarLength(bands[b]) >= CAMP_SPECTRUMLEVEL)
+			pattern |= 1u << b;
+	m_IoDev->writeLEDs(pattern);
+}
+
+void CAmpMeter::setLayout(LED_LAYOUT layout) {
+	m_layout = layout;
+	m_cycleStart = chrono::steady_clock::now();
+}
+
+CAmpMeter::LED_LAYOUT CAmpMeter::getLayout() {
+	return m_layout;
+}
+
 void CAmpMeter::writeConsole(float data) {
 	uint16_t pattern = _getBarPattern(data);
 	uint16_t revPattern = 0;
@@ -134,33 +531,136 @@ uint16_t CAmpMeter::_getBarPattern(float data) {
 	 * (peak normalization).
 	 */
 	//  bar pattern generation is here
+	pattern = (1u << _getBarLength(data)) - 1;	// switch on the n leftmost LEDs
+	return pattern;
+}
+
+int CAmpMeter::_getBarLength(float data) {
 	if(m_scmode==SCALING_MODE_LOG){
 		data = fabs(data/m_inValMax); // normalizing the data value
 	}
 	else
 		data=fabs(data);
 
-	int i=0;
-	uint16_t bitmask=1;
-	while(data > m_thresholds[i])   // switch on leds by comparing the threshold val. amp of the signal
-	{
-		pattern = pattern | bitmask;  // bitwise OR
-		bitmask <<= 1;  // shift bitmask one position to the left
-		i++;
+	if (!(data > m_thresholds[0]))		// silence (and NaN)
+		return 0;
+
+	/*
+	 * the lookup table gives the number of thresholds below the bucket of data,
+	 * at most one more threshold can lie within the bucket
+	 */
+	uint32_t bits;
+	memcpy(&bits, &data, sizeof(bits));
+	int n = m_lut[bits >> CAMP_LUTSHIFT];
+	while ((n < 16) && (data > m_thresholds[n]))
+		n++;
+	return n;
+}
+
+void CAmpMeter::_buildLUT() {
+	/*
+	 * entry i covers the positive floats whose bits start with i, the lowest one
+	 * has the bits i << CAMP_LUTSHIFT (the bit pattern of positive floats is
+	 * ordered like their values)
+	 */
+	for (uint32_t i = 0; i < CAMP_LUTSIZE; i++) {
+		uint32_t bits = i << CAMP_LUTSHIFT;
+		float low;
+		memcpy(&low, &bits, sizeof(low));
+		int n = 0;
+		while ((n < 16) && (low > m_thresholds[n]))
+			n++;
+		m_lut[i] = n;
 	}
-	return pattern;
 }
 
 float CAmpMeter::_getValueFromBuffer(float *databuf,
-		unsigned long databufsize) {
-	float maxVal = 0., tmpVal;
-	for (unsigned long idx = 0; idx < databufsize; idx++) {
-		tmpVal = fabs(databuf[idx]);
-		if (maxVal < tmpVal) {
-			maxVal = tmpVal;
-		}
+		unsigned long databufsize, int numChan) {
+	float values[CAMP_MAXCHANNELS];
+	int n = _getChannelValues(databuf, databufsize, numChan, values);
+	float value = 0.;
+	if (m_meterMode == METER_MODE_RMS) {		// RMS of all samples
+		for (int ch = 0; ch < n; ch++)
+			value += values[ch] * values[ch];
+		return sqrt(value / n);
+	}
+	for (int ch = 0; ch < n; ch++)
+		value = fmax(value, values[ch]);
+	return value;
+}
+
+int CAmpMeter::_getChannelValues(const float *databuf, unsigned long databufsize,
+		int numChan, float *values) {
+	if (numChan < 1)
+		numChan = 1;
+	if (numChan > CAMP_MAXCHANNELS) {
+		// all samples together (no true peak history for that many channels)
+		if (m_meterMode == METER_MODE_RMS)
+			_getRms(databuf, databufsize, 1, values);
+		else
+			_getPeak(databuf, databufsize, 1, values);
+		return 1;
+	}
+	switch (m_meterMode) {
+	case METER_MODE_RMS:
+		_getRms(databuf, databufsize, numChan, values);
+		break;
+	case METER_MODE_TRUEPEAK:
+		_getTruePeak(databuf, databufsize, numChan, values);
+		break;
+	default:
+		_getPeak(databuf, databufsize, numChan, values);
 	}
-	return maxVal;
+	return numChan;
+}
+
+void CAmpMeter::_getPeak(const float *databuf, unsigned long databufsize,
+		int numChan, float *values) {
+	for (int ch = 0; ch < numChan; ch++)
+		values[ch] = 0.f;
+	peakPerChannel(databuf, (databufsize / numChan) * numChan, numChan, values);
+}
+
+void CAmpMeter::_getRms(const float *databuf, unsigned long databufsize,
+		int numChan, float *values) {
+	for (int ch = 0; ch < numChan; ch++)
+		values[ch] = 0.f;
+	unsigned long frames = databufsize / numChan;
+	if (frames == 0)
+		return;
+	squaresPerChannel(databuf, frames * numChan, numChan, values);
+	for (int ch = 0; ch < numChan; ch++)
+		values[ch] = sqrt(values[ch] / frames);
 }
 
+void CAmpMeter::_getTruePeak(const float *databuf, unsigned long databufsize,
+		int numChan, float *values) {
+	const long histLen = (CAMP_TPTAPS - 1) * numChan;
+	if (m_tpChannels != numChan) {		// new stream: start from silence
+		memset(m_tpHistory, 0, sizeof(m_tpHistory));
+		m_tpChannels = numChan;
+	}
+	long size = (databufsize / numChan) * numChan;		// whole frames only
+	for (int ch = 0; ch < numChan; ch++)
+		values[ch] = 0.f;
 
+	/*
+	 * the interpolation of the first CAMP_TPTAPS-1 frames reaches back into the
+	 * previous buffer: they are processed in a copy behind the history
+	 */
+	float edge[2 * (CAMP_TPTAPS - 1) * CAMP_MAXCHANNELS];
+	long head = (size < histLen) ? size : histLen;
+	memcpy(edge, m_tpHistory, histLen * sizeof(float));
+	memcpy(edge + histLen, databuf, head * sizeof(float));
+	truePeakPerChannel(edge + histLen, 0, head, numChan, values);
+	if (size > histLen)
+		truePeakPerChannel(databuf, histLen, size, numChan, values);
+
+	// keep the last CAMP_TPTAPS-1 frames for the next buffer
+	if (size >= histLen)
+		memcpy(m_tpHistory, databuf + size - histLen, histLen * sizeof(float));
+	else {
+		memmove(m_tpHistory, m_tpHistory + size, (histLen - size) * sizeof(float));
+		memcpy(m_tpHistory + histLen - size, databuf, size * sizeof(float));
+	}
+}
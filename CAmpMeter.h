@@ -1,12 +1,96 @@
 #ifndef CAMPMETER_H_
 #define CAMPMETER_H_
 
+#include <stdint.h>
+#include <chrono>
+using namespace std;
+#include "CMeterBuffer.h"
+#include "CSpectrumAnalyzer.h"
+
+/**
+ * maximum number of interleaved channels metered separately (more channels are
+ * metered together as one)
+ */
+#define CAMP_MAXCHANNELS METER_MAXCHANNELS
+/**
+ * taps per phase of the 4x oversampling interpolator (ITU-R BS.1770-4, annex 2)
+ */
+#define CAMP_TPTAPS 12
+/**
+ * the bar pattern lookup is indexed by the bits of a positive float value above
+ * this bit (exponent and 5 mantissa bits, i.e. 1/32 octave per entry)
+ */
+#define CAMP_LUTSHIFT 18
+#define CAMP_LUTSIZE (1 << (31 - CAMP_LUTSHIFT))
+/**
+ * default ballistics: time constants of the rising and the falling envelope [s]
+ * and peak hold time [s]
+ */
+#define CAMP_ATTACK 0.005
+#define CAMP_RELEASE 0.3
+#define CAMP_HOLD 1.5
+/**
+ * duration of the segments a block is measured in [s] (time resolution of the envelope)
+ */
+#define CAMP_SEGMENT 0.005
+/**
+ * time each channel is shown in the cycling layout [s]
+ */
+#define CAMP_CYCLETIME 2.0
+/**
+ * spectrum mode: the LED of a band is on if the band would light this number
+ * of LEDs of the bar
+ */
+#define CAMP_SPECTRUMLEVEL 4
+
 class CPlayerCVDevice;
 class CAmpMeter {
+	friend class CBenchmark;	// measures the private hot paths
 public:
 	enum SCALING_MODE {
 		SCALING_MODE_LIN, SCALING_MODE_LOG
 	};
+	/**
+	 * value displayed for a data buffer
+	 */
+	enum METER_MODE {
+		/**
+		 * highest absolute sample value
+		 */
+		METER_MODE_PEAK,
+		/**
+		 * root mean square of the samples
+		 */
+		METER_MODE_RMS,
+		/**
+		 * highest absolute value of the 4x oversampled signal (ITU-R BS.1770)
+		 */
+		METER_MODE_TRUEPEAK,
+		/**
+		 * one LED per band of the spectrum (CSpectrumAnalyzer, lowest band left)
+		 */
+		METER_MODE_SPECTRUM
+	};
+	/**
+	 * assignment of the channels to the 16 LEDs
+	 */
+	enum LED_LAYOUT {
+		/**
+		 * one bar of 16 LEDs for the maximum of all channels
+		 */
+		LAYOUT_COMBINED,
+		/**
+		 * two bars of 8 LEDs growing from the middle to the left (channel 0)
+		 * and to the right (channel 1), with more channels: maximum of the even
+		 * and of the odd channels
+		 */
+		LAYOUT_SPLIT,
+		/**
+		 * a bar of 11 LEDs for one channel after the other (CAMP_CYCLETIME
+		 * each) and the channel number in binary on the LEDs 12 (MSB) ... 16
+		 */
+		LAYOUT_CYCLE
+	};
 	enum AMP_ERROR {
 		AMP_E_NOBUFFER, AMP_E_NOVISUALIZER
 	};
@@ -36,6 +120,44 @@ private:
 	 * the content is calculated in init()
 	 */
 	float m_thresholds[16];
+	/**
+	 * number of active LEDs for the lowest value of each lookup entry (calculated in init())
+	 */
+	uint8_t m_lut[CAMP_LUTSIZE];
+	METER_MODE m_meterMode;
+	/**
+	 * last CAMP_TPTAPS-1 frames of the previous buffer (interleaved) for the true peak interpolator
+	 */
+	float m_tpHistory[(CAMP_TPTAPS - 1) * CAMP_MAXCHANNELS];
+	int m_tpChannels;
+
+	/**
+	 * ballistics [s]
+	 */
+	float m_attack;
+	float m_release;
+	float m_holdTime;
+	/**
+	 * envelope, peak hold value and remaining hold time [s] per channel (updated by measure())
+	 */
+	float m_env[CAMP_MAXCHANNELS];
+	float m_hold[CAMP_MAXCHANNELS];
+	float m_holdLeft[CAMP_MAXCHANNELS];
+	/**
+	 * format of the measured stream (a new format resets the envelope)
+	 */
+	int m_envFs;
+	int m_envChannels;
+	/**
+	 * spectrum mode: written by measure(), analyzed by writeSpectrum()
+	 */
+	CSpectrumAnalyzer m_spectrum;
+
+	LED_LAYOUT m_layout;
+	/**
+	 * start of the cycling layout
+	 */
+	chrono::steady_clock::time_point m_cycleStart;
 	/**
 	 * pointer to an instance of the IOWarrior extension board class that shows the bar patterns on
 	 * a line of 16 LEDs
@@ -102,11 +224,66 @@ public:
 	 * \param databuf [in] The address of the first data buffer element.
 	 * \param databufsize [in] The number of elements of the data buffer.
 	 *
+	 * \param numChan [in] number of interleaved channels (only relevant for the true peak)
+	 *
 	 * the displayed value is an amplitude value representative for the data buffer
+	 * (see setMeterMode())
 	 *
 	 * the bar is displayed from left to right
 	 */
-	void write(float *databuf, unsigned long databufsize);
+	void write(float *databuf, unsigned long databufsize, int numChan = 1);
+
+	/**
+	 * \brief sets the value displayed for a data buffer (peak, RMS or true peak)
+	 */
+	void setMeterMode(METER_MODE mode);
+	METER_MODE getMeterMode();
+
+	/**
+	 * \brief measures the value of a data buffer without displaying it
+	 *
+	 * (the audio path measures, the visualizer thread displays the value with write(double))
+	 *
+	 * \param databuf [in] pointer to the data buffer
+	 * \param databufsize [in] number of elements of the data buffer
+	 * \param numChan [in] number of interleaved channels
+	 * \return meter value of the buffer (see setMeterMode())
+	 */
+	float getValue(float *databuf, unsigned long databufsize, int numChan = 1);
+
+	/**
+	 * \brief measures each channel of a data buffer with ballistics
+	 *
+	 * The buffer is measured in segments of CAMP_SEGMENT seconds (one pass for
+	 * all channels). Each segment value drives the envelope of its channel
+	 * (rising with the attack, falling with the release time constant) and the
+	 * peak hold value (falls like the envelope after the hold time). The state
+	 * is kept from buffer to buffer.
+	 *
+	 * In spectrum mode, the buffer is only appended to the spectrum analyzer
+	 * (analyzed by writeSpectrum()).
+	 *
+	 * \param databuf [in] pointer to the data buffer
+	 * \param databufsize [in] number of elements of the data buffer
+	 * \param numChan [in] number of interleaved channels
+	 * \param fs [in] sample rate
+	 * \param snap [out] envelope over the buffer and peak hold value
+	 */
+	void measure(float *databuf, unsigned long databufsize, int numChan, int fs,
+			METERSNAPSHOT &snap);
+
+	/**
+	 * \brief sets the ballistics of measure()
+	 * \param attack [in] time constant of the rising envelope [s] (0: immediate)
+	 * \param release [in] time constant of the falling envelope [s]
+	 * \param hold [in] peak hold time [s]
+	 */
+	void setBallistics(float attack, float release, float hold);
+
+	/**
+	 * \brief resets envelope and peak hold value to silence
+	 */
+	void resetBallistics();
 
 	/**
 	 * \brief Visualizes the amplitude of one single data value on the connected IODevice as a bar pattern
@@ -128,6 +305,37 @@ public:
 	void writeConsole(float data);
 
 	void write(double data);
+
+	/**
+	 * \brief displays a value as bar and the peak hold value as single LED
+	 *
+	 * \param data [in] value
+	 * \param hold [in] peak hold value
+	 */
+	void write(double data, double hold);
+
+	/**
+	 * \brief displays the values of several channels in the current layout
+	 *
+	 * \param values [in] value per channel
+	 * \param holds [in] peak hold value per channel
+	 * \param numChan [in] number of channels
+	 */
+	void write(const float *values, const float *holds, int numChan);
+
+	/**
+	 * \brief displays the spectrum of the measured signal up to a position (spectrum mode)
+	 *
+	 * \param endPos [in] position after the last sample analyzed (see METERSNAPSHOT::ringPos)
+	 * \param fs [in] sample rate
+	 */
+	void writeSpectrum(unsigned long endPos, int fs);
+
+	/**
+	 * \brief sets the assignment of the channels to the LEDs
+	 */
+	void setLayout(LED_LAYOUT layout);
+	LED_LAYOUT getLayout();
 private:
 	/**
 	 * \brief Returns an appropriate bar pattern for the data value scaled according to
@@ -143,7 +351,49 @@ private:
 	 *
 	 * \param databuf [in] The address of the first data buffer element.
 	 * \param databufsize [in] The number of elements of the data buffer.
+	 * \param numChan [in] number of interleaved channels
+	 */
+	float _getValueFromBuffer(float *databuf, unsigned long databufsize,
+			int numChan = 1);
+
+	/**
+	 * \brief calculates the value of each channel of a data buffer in one pass
+	 *
+	 * \param databuf [in] pointer to the data buffer
+	 * \param databufsize [in] number of elements of the data buffer
+	 * \param numChan [in] number of interleaved channels
+	 * \param values [out] value per channel (CAMP_MAXCHANNELS elements)
+	 * \return number of values (1 if there are more than CAMP_MAXCHANNELS channels)
+	 */
+	int _getChannelValues(const float *databuf, unsigned long databufsize,
+			int numChan, float *values);
+
+	/**
+	 * \brief kernels of the meter modes per channel (SSE if available)
+	 */
+	void _getPeak(const float *databuf, unsigned long databufsize, int numChan,
+			float *values);
+	void _getRms(const float *databuf, unsigned long databufsize, int numChan,
+			float *values);
+	void _getTruePeak(const float *databuf, unsigned long databufsize, int numChan,
+			float *values);
+
+	/**
+	 * \return number of thresholds exceeded by the absolute value of data (0 ... 16)
+	 */
+	int _getBarLength(float data);
+
+	/**
+	 * \brief calculates m_lut from m_thresholds
+	 */
+	void _buildLUT();
+
+	/**
+	 * \brief updates envelope and peak hold value of a channel with the value of a segment
+	 * \param ch [in] channel
+	 * \param value [in] meter value of the segment
+	 * \param dt [in] duration of the segment [s]
 	 */
-	float _getValueFromBuffer(float *databuf, unsigned long databufsize);
+	void _updateEnvelope(int ch, float value, float dt);
 };
 #endif /* CAMPMETER_H_ */
@@ -1,6 +1,8 @@
 #include "CAudioOutStream.h"
 #include <cstddef>
+#include <chrono>
 #include <SKSLib.h>
+#include "CTrace.h"
 using namespace std;
 
 
@@ -8,11 +10,22 @@ using namespace std;
 CAudioOutStream::CAudioOutStream() {
 	m_stream=NULL;
 	m_state=NOTREADY;
+	m_bufferFrames=0;
+	m_firstBlock=true;
+	m_format=FMT_FLOAT32;
+	m_convBuf=NULL;
+	m_convBufSize=0;
+	m_numChan=0;
+	m_fs=0.;
+	m_pSink=NULL;
+	resetStatistics();
 }
 
 CAudioOutStream::~CAudioOutStream() {
 	// call the close method to ensure that all resources have been closed
 	close();
+	if(m_convBuf)
+		delete[] m_convBuf;
 	// released when the object is destroyed
 	Pa_Terminate();
 }
@@ -43,13 +56,27 @@ void CAudioOutStream::open(int numChan, double fSample,
 				throw(myException);
 			}
 			outParams.channelCount = numChan;
-			outParams.sampleFormat = paFloat32; /* 32 Bit Floating point Output */
+			PaStreamFlags flags = paClipOff;	/* we won't output out of range samples so don't bother clipping them */
+			switch(m_format){
+			case FMT_INT16:
+				outParams.sampleFormat = paInt16;	/* converted (and dithered) by m_converter */
+				flags |= paDitherOff;
+				break;
+			case FMT_INT24:
+				outParams.sampleFormat = paInt24;
+				flags |= paDitherOff;
+				break;
+			case FMT_FLOAT32:
+			default:
+				outParams.sampleFormat = paFloat32; /* 32 Bit Floating point Output */
+				break;
+			}
 			// Default Latency Value for Playing Sound Files
 			outParams.suggestedLatency = Pa_GetDeviceInfo(outParams.device) -> defaultHighOutputLatency;
 			outParams.hostApiSpecificStreamInfo = NULL;
 
 			err = Pa_OpenStream(&m_stream, NULL, /* no input */&outParams, fSample, framesPerBuffer,
-										paClipOff,	/* we won't output out of range samples so don't bother clipping them */
+										flags,
 										NULL, 		/* no callback, use blocking API */
 										NULL ); 	/* no callback, so no callback userData */
 			if(err != paNoError){
@@ -57,9 +84,26 @@ void CAudioOutStream::open(int numChan, double fSample,
 				throw(myException);
 			}
 
+			m_numChan = numChan;
+			m_fs = fSample;
+			if((m_format != FMT_FLOAT32) && ((long)framesPerBuffer * numChan > m_convBufSize))
+			{
+				if(m_convBuf)
+					delete[] m_convBuf;
+				m_convBufSize = framesPerBuffer * numChan;
+				m_convBuf = new uint8_t[4 * m_convBufSize];
+			}
+
+			// the device buffer holds (at least) one block and the output latency
+			const PaStreamInfo *info = Pa_GetStreamInfo(m_stream);
+			m_bufferFrames = framesPerBuffer;
+			if(info && (info->outputLatency * fSample > m_bufferFrames))
+				m_bufferFrames = info->outputLatency * fSample;
 	}
 	}
 
+	resetStatistics();
+
 	// if all the actions have been successful
 	m_state=READY;
 }
@@ -82,6 +126,9 @@ void CAudioOutStream::start() {
 				throw(CException(CException::SRC_SimpleAudioDevice, err, Pa_GetErrorText(err)));
 			}
 			m_state=PLAYING;
+			m_firstBlock=true;
+			if(m_pSink)
+				m_pSink->streamStateChanged(true, chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count());
 
 }
 
@@ -91,8 +138,74 @@ void CAudioOutStream::play(float* pBuffer, int noFrames)
 	if(m_state == NOTREADY)throw(CException(CException::SRC_SimpleAudioDevice, paNoError, "Device is not initialized!"));
 	else if(m_state == PLAYING)
 	{
-		err = Pa_WriteStream( m_stream, pBuffer, noFrames);
-		if( err != paNoError )throw(CException(CException::SRC_SimpleAudioDevice, err, Pa_GetErrorText(err)));
+		// fill level of the device buffer before the block is written
+		long avail = Pa_GetStreamWriteAvailable(m_stream);
+		if(avail >= 0)
+		{
+			if(avail > m_bufferFrames)
+				m_bufferFrames = avail;	// the device buffer is larger than estimated
+			long fill = m_bufferFrames - avail;
+			if(!m_firstBlock)
+			{
+				if(fill == 0)
+					m_stats.lateBlocks++;
+				if((m_stats.fillLow < 0) || (fill < m_stats.fillLow))
+					m_stats.fillLow = fill;
+			}
+			if(fill > m_stats.fillHigh)
+				m_stats.fillHigh = fill;
+		}
+		m_firstBlock = false;
+
+		void *pOut = pBuffer;
+		if(m_format != FMT_FLOAT32)
+		{
+			TRACE_SCOPE("convert");
+			long numSamples = (long)noFrames * m_numChan;
+			if(numSamples > m_convBufSize)
+			{
+				// 4 bytes per sample are enough for all integer formats
+				if(m_convBuf)
+					delete[] m_convBuf;
+				m_convBuf = new uint8_t[4 * numSamples];
+				m_convBufSize = numSamples;
+			}
+			if(m_format == FMT_INT16)
+				m_converter.toInt16(pBuffer, (int16_t*)m_convBuf, numSamples);
+			else
+				m_converter.toInt24(pBuffer, m_convBuf, numSamples);
+			pOut = m_convBuf;
+		}
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		{
+			TRACE_SCOPE("Pa_WriteStream");
+			err = Pa_WriteStream( m_stream, pOut, noFrames);
+		}
+		chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+		double dt = chrono::duration<double>(t1 - t0).count();
+
+		// an underflow is a dropout, but not a reason to stop playing
+		if(err == paOutputUnderflowed)
+			m_stats.underflows++;
+		else if( err != paNoError )throw(CException(CException::SRC_SimpleAudioDevice, err, Pa_GetErrorText(err)));
+
+		if((m_stats.blocks == 0) || (dt < m_stats.writeTimeMin))
+			m_stats.writeTimeMin = dt;
+		if(dt > m_stats.writeTimeMax)
+			m_stats.writeTimeMax = dt;
+		m_writeTimeSum += dt;
+		m_stats.blocks++;
+		m_stats.writeTimeMean = m_writeTimeSum / m_stats.blocks;
+
+		if(m_pSink)
+		{
+			// the block is the last one in the device buffer
+			long avail = Pa_GetStreamWriteAvailable(m_stream);
+			long queued = (avail >= 0) ? m_bufferFrames - avail : noFrames;
+			double tWritten = chrono::duration<double>(t1.time_since_epoch()).count();
+			double tDac = tWritten + (queued > noFrames ? queued - noFrames : 0) / m_fs;
+			m_pSink->blockWritten(pBuffer, noFrames, tWritten, tDac);
+		}
 	}
 	else if(m_state == READY)throw(CException(CException::SRC_SimpleAudioDevice, paNoError, "First You have to Start the Device"));
 }
@@ -107,6 +220,10 @@ void CAudioOutStream::stop() {
 	else if(m_state == PLAYING)
 	{
 		err=Pa_StopStream(m_stream);
+		// also a stream that failed to stop doesn't play anymore for the sink
+		// (e.g. the throttled library analysis)
+		if(m_pSink)
+			m_pSink->streamStateChanged(false, chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count());
 		if(err != paNoError)throw(CException(CException::SRC_SimpleAudioDevice, err, Pa_GetErrorText(err)));
 		else
 			m_state= READY;
@@ -116,7 +233,17 @@ void CAudioOutStream::stop() {
 void CAudioOutStream::close()
 {
 	if(m_state == NOTREADY)return;
-	stop();
+	try
+	{
+		stop();
+	}
+	catch(CException &e)
+	{
+		// closed anyway (Pa_CloseStream aborts a running stream)
+		Pa_CloseStream(m_stream);
+		m_state= NOTREADY;
+		throw;
+	}
 	PaError err;
 	err = Pa_CloseStream(m_stream);
 	if(err != paNoError)throw(CException(CException::SRC_SimpleAudioDevice, err, Pa_GetErrorText(err)));
@@ -133,3 +260,37 @@ void CAudioOutStream::resume()
 	start();
 }
 
+void CAudioOutStream::setSampleFormat(SAMPLEFORMATS format, bool dither)
+{
+	m_format = format;
+	m_converter.setDither(dither);
+}
+
+CAudioOutStream::SAMPLEFORMATS CAudioOutStream::getSampleFormat()
+{
+	return m_format;
+}
+
+void CAudioOutStream::setSink(CAudioOutSink *pSink)
+{
+	m_pSink = pSink;
+}
+
+CAudioOutStream::STATISTICS CAudioOutStream::getStatistics()
+{
+	return m_stats;
+}
+
+void CAudioOutStream::resetStatistics()
+{
+	m_stats.blocks = 0;
+	m_stats.underflows = 0;
+	m_stats.lateBlocks = 0;
+	m_stats.writeTimeMin = 0.;
+	m_stats.writeTimeMean = 0.;
+	m_stats.writeTimeMax = 0.;
+	m_stats.fillHigh = 0;
+	m_stats.fillLow = -1;
+	m_writeTimeSum = 0.;
+}
+
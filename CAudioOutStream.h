@@ -1,6 +1,41 @@
 #ifndef SRC_CAUDIOOUTSTREAM_H_
 #define SRC_CAUDIOOUTSTREAM_H_
 #include "portaudio.h"
+#include "CSampleConverter.h"
+
+/**
+ * \brief receiver of the timestamps of an output stream (e.g. for latency measurements)
+ *
+ * all times are seconds of chrono::steady_clock
+ */
+class CAudioOutSink {
+public:
+	CAudioOutSink(){};
+	virtual ~CAudioOutSink(){};
+
+	/**
+	 * \brief called by play() after a block has been written to the device
+	 *
+	 * \param pBuffer [in] samples of the block
+	 * \param noFrames [in] number of frames of the block
+	 * \param tWritten [in] time at which the write returned
+	 * \param tDac [in] estimated time at which the first frame of the block reaches the DAC
+	 * (from the device buffer fill level after the write)
+	 */
+	virtual void blockWritten(const float *pBuffer, int noFrames, double tWritten,
+			double tDac)=0;
+
+	/**
+	 * \brief called after the stream has been started or stopped
+	 *
+	 * stop() returns after the buffered samples have been played, so a stop
+	 * marks the beginning of silence
+	 *
+	 * \param running [in] true: started, false: stopped (also if stopping has failed)
+	 * \param t [in] time of the state change
+	 */
+	virtual void streamStateChanged(bool running, double t)=0;
+};
 
 class CAudioOutStream {
 public:
@@ -8,9 +43,80 @@ public:
 	{
 		NOTREADY,READY,PLAYING
 	};
+	/**
+	 * \brief sample formats of the device stream
+	 *
+	 * play() always takes float samples. For the integer formats the samples are
+	 * converted (with saturation and optional dither) before they are written.
+	 */
+	enum SAMPLEFORMATS
+	{
+		FMT_FLOAT32, FMT_INT16, FMT_INT24
+	};
+	/**
+	 * \brief health statistics of the output stream
+	 *
+	 * collected by play() and cleared by resetStatistics() (e.g. at the start of each track)
+	 */
+	struct STATISTICS
+	{
+		/**
+		 * number of blocks written to the device
+		 */
+		unsigned long blocks;
+		/**
+		 * number of output underflows reported by the device (paOutputUnderflowed)
+		 */
+		unsigned long underflows;
+		/**
+		 * number of blocks that arrived after the device buffer had run empty
+		 */
+		unsigned long lateBlocks;
+		/**
+		 * minimum, mean and maximum duration of a block write [s]
+		 */
+		double writeTimeMin;
+		double writeTimeMean;
+		double writeTimeMax;
+		/**
+		 * high and low watermark of the device buffer fill level [frames]
+		 * (fillLow is -1 as long as it has not been measured)
+		 */
+		long fillHigh;
+		long fillLow;
+	};
 private:
 	PaStream* m_stream;
 	STATES m_state;
+	/**
+	 * statistics since the last reset and sum of all write durations (for the mean value)
+	 */
+	STATISTICS m_stats;
+	double m_writeTimeSum;
+	/**
+	 * size of the device buffer in frames (estimated from the output latency)
+	 */
+	long m_bufferFrames;
+	/**
+	 * set by start(): the buffer of a freshly started stream is empty, so the first block is not late
+	 */
+	bool m_firstBlock;
+	/**
+	 * sample format of the device stream and converter for the integer formats
+	 */
+	SAMPLEFORMATS m_format;
+	CSampleConverter m_converter;
+	/**
+	 * buffer for the converted samples and its size in samples
+	 */
+	uint8_t *m_convBuf;
+	long m_convBufSize;
+	int m_numChan;
+	double m_fs;
+	/**
+	 * receiver of the timestamps (NULL: none)
+	 */
+	CAudioOutSink *m_pSink;
 public:
 	CAudioOutStream();
 	~CAudioOutStream();
@@ -21,6 +127,32 @@ public:
 	void stop();
 	void resume();
 	void close();
+
+	/**
+	 * \brief sets the sample format of the device stream
+	 *
+	 * takes effect when the stream is opened next time
+	 *
+	 * \param format [in] sample format
+	 * \param dither [in] add TPDF dither when converting to an integer format
+	 */
+	void setSampleFormat(SAMPLEFORMATS format, bool dither = false);
+	SAMPLEFORMATS getSampleFormat();
+
+	/**
+	 * \brief attaches a receiver of block and state change timestamps
+	 * \param pSink [in] receiver or NULL to detach
+	 */
+	void setSink(CAudioOutSink *pSink);
+
+	/**
+	 * \brief returns the statistics collected since the last reset
+	 */
+	STATISTICS getStatistics();
+	/**
+	 * \brief clears all counters and watermarks
+	 */
+	void resetStatistics();
 };
 
 #endif /* SRC_CAUDIOOUTSTREAM_H_ */
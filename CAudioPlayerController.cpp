@@ -12,10 +12,17 @@ using namespace std;
 #include "CFilter.h"
 #include "CUserInterface.h"
 #include "CAudioPlayerController.h"
+#include "CTrace.h"
 
-CAudioPlayerController::CAudioPlayerController() {
+CAudioPlayerController::CAudioPlayerController(CBlockPool *pPool) :
+		m_pPool(pPool), m_pipeline(&m_audioStream, &m_ui, pPool) {
 	m_pSFile = NULL;		// association with 1 or 0 CSoundFile-objects
 	m_pFilter = NULL;		// association with 1 or 0 CFilter-objects
+	m_deviceFs = 0;			// output at the sample rate of the sound file
+	m_srcQuality = CResampler::QUALITY_MEDIUM;
+	m_normalize = false;	// sound files are played at their own level
+	m_loudnessTarget = LOUD_TARGET;
+	m_audioStream.setSink(&m_library);
 }
 
 CAudioPlayerController::~CAudioPlayerController() {
@@ -30,6 +37,14 @@ void CAudioPlayerController::run() {
 	// therefore it is handled by main (unrecoverable error)
 	init();
 
+	// new and changed sound files are analyzed on the idle cores, so their
+	// loudness is known when they are played
+	try {
+		m_library.start(".\\files\\sounds\\", ".wav");
+	} catch (CException &e) {
+		m_ui.printMessage("library analysis: " + e.getErrorText() + "\n");
+	}
+
 	/***************************************************************
 	 * main menue of the player
 	 *
@@ -37,7 +52,10 @@ void CAudioPlayerController::run() {
 	 *
 	 ***************************************************************/
 	string mainMenue[] = { "select sound", "select filter", "play",
-			"choose amplitude scale", "terminate player", "" };
+			"choose amplitude scale", "choose output sample rate",
+			"choose output format", "choose latency target", "edit play queue",
+			"play queue", "mix sounds", "choose loudness normalization",
+			"library analysis", "render cache", "terminate player", "" };
 	while (1) {
 		// if an exception will be thrown by one of the methods, the main menu will be shown
 		// after an error message has been displayed. The user may decide, what to do (recoverable error)
@@ -62,6 +80,33 @@ void CAudioPlayerController::run() {
 				chooseAmplitudeScale();
 				break;
 			case 4:
+				chooseOutputRate();
+				break;
+			case 5:
+				chooseOutputFormat();
+				break;
+			case 6:
+				chooseLatencyTarget();
+				break;
+			case 7:
+				editPlayQueue();
+				break;
+			case 8:
+				playQueue();
+				break;
+			case 9:
+				mixSounds();
+				break;
+			case 10:
+				chooseNormalization();
+				break;
+			case 11:
+				analyzeLibrary();
+				break;
+			case 12:
+				manageRenderCache();
+				break;
+			case 13:
 				return;
 			default:
 				m_ui.printMessage("invalid selection. \n");
@@ -151,7 +196,6 @@ void CAudioPlayerController::chooseFilter() {
 }
 
 void CAudioPlayerController::play() {
-	// delete next line and implement play() here
 	if(!m_pSFile)
 		{
 			m_ui.printMessage("Error from play: Select sound file before playing!");
@@ -160,145 +204,350 @@ void CAudioPlayerController::play() {
 		if(!m_pFilter)
 		{
 			m_ui.printMessage("Message from play: Filter has not been selected! Playing unfiltered sound.");
-	//		delete m_pFilter;
-	//		m_pFilter=NULL;
 		}
 
+		CResampler *pResampler = NULL;
+		CSoundFile *pCached = NULL;		// rendered file from the cache
+		CSoundFile *pRecord = NULL;		// new rendering for the cache
+		string cacheKey;
+
 		try{
 
 			m_pSFile -> open();
-
-			float dur_block = 0.125; //Block Duration in seconds
-
-			long framesPerBlock = (m_pSFile -> getSampleRate()) * dur_block;
-
-			int buffsize = (m_pSFile -> getNumChannels()) * framesPerBlock;
-
-
-			float *buffblock = new float[buffsize];
-			float *buffblock_f = new float[buffsize];
-
-
-			m_audioStream.open(m_pSFile -> getNumChannels(), m_pSFile -> getSampleRate(), framesPerBlock);
-			m_ui.keyPressed(true);
-			m_audioStream.start();
-			bool key = true;
-			int readsize = 0;
-
-			do {
-				/**
-				 * sndfile.read() needs the total buffer size to be played
-				 */
-				if(key){
-					if(!m_pFilter){
-						readsize = m_pSFile -> read(buffblock, buffsize);
-						m_audioStream.play(buffblock, readsize / m_pSFile -> getNumChannels());
-						m_ui.visualizeAmplitude(buffblock, buffsize);
-					}else{
-						readsize = m_pSFile -> read(buffblock, buffsize);
-						m_pFilter ->filter(buffblock, buffblock_f, framesPerBlock);
-						m_audioStream.play(buffblock_f, readsize / m_pSFile -> getNumChannels());
-						m_ui.visualizeAmplitude(buffblock_f, buffsize);
-					}
+			float gain = _getNormalizationGain(m_pSFile->getPath());
+			int numChan = m_pSFile -> getNumChannels();
+			int fsOut = _getProcessingRate(m_pSFile);
+
+			// the output of resampler and filter only depends on the sound file and the
+			// filter: a combination played completely before is played from the cache
+			CSoundFile *pSFile = m_pSFile;
+			CFilterBase *pFilter = m_pFilter;
+			if (m_pFilter && (typeid(*m_pFilter) == typeid(CFilter))) {
+				try {
+					cacheKey = m_renderCache.getKey(*m_pSFile, *(CFilter*) m_pFilter,
+							fsOut, m_srcQuality);
+					if (cacheKey.empty())	// no hash yet: played without cache
+						m_library.prioritize(m_pSFile->getPath());
+					else
+						pCached = m_renderCache.open(cacheKey);
+				} catch (CException &e) {
+					cacheKey = "";		// played without cache
 				}
+				if (pCached) {
+					m_ui.printMessage("Message from play: playing the filtered sound from the render cache.\n");
+					pSFile = pCached;
+					pFilter = NULL;
+				} else if (!cacheKey.empty())
+					pRecord = m_renderCache.create(cacheKey, numChan, fsOut);
+			}
 
-				// repeat as long as there is a complete block
-				if(m_ui.keyPressed(false)){
-					if(key){
-						m_audioStream.stop();
-						key = false;
-					}else
-					{
-						m_audioStream.resume();
-						key = true;
-					}
-				}
-			} while ( buffsize == readsize);
-
+			// block size from the measured cost of reading and filtering, the pipeline
+			// adapts it during playback up to twice the initial size
+			int fsIn = pSFile->getSampleRate();
+			m_blockSizer.calibrate(pSFile, pFilter);
+			long framesPerBlock = 2 * m_blockSizer.getFramesPerBlock(fsIn);
+			if (framesPerBlock > m_blockSizer.getMaxFramesPerBlock(fsIn))
+				framesPerBlock = m_blockSizer.getMaxFramesPerBlock(fsIn);
+
+			int outCapacity = framesPerBlock;
+			if (fsOut != fsIn) {
+				pResampler = new CResampler(fsIn, fsOut, numChan, m_srcQuality);
+				// the last block contains the resampler's delayed frames, too
+				outCapacity = pResampler->getMaxOutFrames(framesPerBlock)
+						+ pResampler->getMaxOutFrames(64);
+			}
 
-			m_audioStream.stop();
+			// decoding, filtering, output and metering run in separate threads
+			m_ui.printMessage("press ENTER to start. While playing: ENTER pause/resume, "
+					"s stop, <seconds> seek, f filter off/on\n");
+			TRACE_CLEAR();
+			m_pipeline.setRecordFile(pRecord);
+			m_pipeline.play(pSFile, pResampler, pFilter, fsOut, framesPerBlock,
+					outCapacity, &m_blockSizer, gain);
+			m_pipeline.setRecordFile(NULL);
+			TRACE_DUMP("play_trace.json");
+			if (pRecord)
+				m_renderCache.finish(cacheKey, pRecord, m_pipeline.isRecordComplete());
+			if (pCached)
+				delete pCached;
+
+			m_ui.printMessage(m_pipeline.getTimingStr());
+			m_ui.printMessage(m_blockSizer.getStateStr(fsIn));
+			_printStreamStatistics();
 			m_pSFile -> rewind();
 			m_audioStream.close();
-			delete[] buffblock, 					//Destroy Original Signal Buffer
-			delete[] buffblock_f;
+			if (pResampler)
+				delete pResampler;
 			m_pSFile -> close();
 		}
 		catch(CException &err)
 		{
+			m_pipeline.setRecordFile(NULL);
+			if (pRecord)
+				m_renderCache.finish(cacheKey, pRecord, false);
+			if (pCached)
+				delete pCached;
+			if (pResampler)
+				delete pResampler;
+			m_audioStream.close();
+			m_pSFile -> close();
 			err.print();
 		}
 }
 
 void CAudioPlayerController::chooseSound() {
+	string chosenFile;
+	int sid = _chooseSoundFile(chosenFile);
 
-	// delete next line and implement chooseSound() here
+	if (sid != CUI_UNKNOWN){
 
-	string soundlist[25];
-	string filePath = ".\\files\\sounds\\", fileExt = ".wav";
-	uint16_t numsndfiles = _getFiles(filePath, fileExt, soundlist, 25);
+		CSoundFile *pSF = new CSoundFile(chosenFile, CSoundFile::FILE_READ);
 
-	// list the files and their information
-	int sid = CUI_UNKNOWN;
+		try{
 
-	if(numsndfiles){
+			pSF -> open();
 
-		// prepare a string array for the user interface, that will contain  a menu with the selection of sound files
-		// there is place for an additional entry for an empty string
+			if(m_pSFile)
+				delete m_pSFile;
 
-		string *pSNDMenue = new string[numsndfiles + 2];
-		for(int i = 0; i < numsndfiles; i++){
+			m_pSFile = pSF;
+			_printWaveform(*m_pSFile);
 
-			// create a sound file object
-			CSoundFile sndfile(filePath + soundlist[i], CSoundFile::FILE_READ);
+		}catch(CException &e){
+			delete pSF;
+			m_ui.printMessage("Error From" + e.getSrcAsString() + ": " + e.getErrorText());
+		}
+	}
+	else{
+		m_ui.printMessage("Directory Does not Contain any Sound File");
+	}
 
-			try{
-				sndfile.open();
-				pSNDMenue[i] = soundlist[i] + "[" + to_string(sndfile.getSampleRate()) + "Hz, " + to_string(sndfile.getNumChannels()) + "]";
-				sndfile.close();
-			}catch(CException &e){
+	_adaptFilter();
 
-				//file can not be read
-				if(e.getErrorCode() != CSoundFile::FILE_READ){
-					sndfile.close();
-				}
-			}
-		}
+}
 
-		// add the last menu entry for the choice of an no sound file
-		pSNDMenue[numsndfiles] = "-1 [no soundfile]";
+void CAudioPlayerController::editPlayQueue() {
+	string queueMenue[] = { "add sound", "remove last sound", "clear queue", "" };
+
+	// show the current content of the queue
+	m_ui.printMessage("play queue:\n");
+	for (unsigned int i = 0; i < m_playQueue.size(); i++)
+		m_ui.printMessage("  " + to_string(i) + ": " + m_playQueue[i] + "\n");
+
+	int idChoice = m_ui.getListSelection(queueMenue, "edit the play queue");
+	if (idChoice == 0) {
+		string chosenFile;
+		if (_chooseSoundFile(chosenFile) != CUI_UNKNOWN)
+			m_playQueue.push_back(chosenFile);
+		else
+			m_ui.printMessage("Error from editPlayQueue: No sound file chosen. \n");
+	} else if (idChoice == 1) {
+		if (!m_playQueue.empty())
+			m_playQueue.pop_back();
+	} else if (idChoice == 2) {
+		m_playQueue.clear();
+	} else
+		m_ui.printMessage("invalid selection. \n");
+}
 
-		// pass the arrays to the user interface and wait for the user's input
-		// if the user provides a soundID which is not in pSNDMenue, the method returns
-		// CUI_UNKNOWN
+void CAudioPlayerController::playQueue() {
+	if (m_playQueue.empty()) {
+		m_ui.printMessage("Error from playQueue: The play queue is empty! \n");
+		return;
+	}
 
-		sid = m_ui.getListSelection(pSNDMenue, "Choose a sound file");
-		//destroy the array
-		delete[] pSNDMenue;
+	float dur_block = 0.125; //Block Duration in seconds
 
-		if (sid != CUI_UNKNOWN){
+	// tracks that haven't been analyzed yet are moved to the front of the
+	// library analysis (in queue order), so the later ones may have their gain
+	// when they are prepared
+	for (unsigned int i = 0; m_normalize && (i < m_playQueue.size()); i++) {
+		try {
+			LOUDNESSINFO info;
+			if (!CLoudnessMeter::loadInfo(m_playQueue[i], info))
+				m_library.prioritize(m_playQueue[i]);
+		} catch (CException &e) {
+			// reported when the track is prepared
+		}
+	}
 
-			CSoundFile *pSF = new CSoundFile((filePath + soundlist[sid]), CSoundFile::FILE_READ);
+	TRACK cur = TRACK(), next = TRACK();
+	unsigned int nextIdx = 0;
 
-			try{
+	try {
+		// the first track that can be opened starts the queue
+		while ((cur.pSFile == NULL) && (nextIdx < m_playQueue.size()))
+			_prepareTrack(m_playQueue[nextIdx++], cur, dur_block);
+		if (cur.pSFile == NULL)
+			return;
 
-				pSF -> open();
+		int streamFs = _getProcessingRate(cur.pSFile);
+		int streamCh = cur.pSFile->getNumChannels();
+		m_audioStream.open(streamCh, streamFs, cur.framesPerBlockOut);
+		m_audioStream.resetStatistics();
+		m_ui.keyPressed(true);
+		m_audioStream.start();
+		bool key = true;
+		TRACE_CLEAR();
+
+		while (cur.pSFile) {
+			m_ui.printMessage("playing " + cur.path + "\n");
+			bool last = false;
+			while (!last) {
+				if (key) {
+					m_audioStream.play(cur.pBlock, cur.frames);
+					{
+						TRACE_SCOPE("visualize");
+						m_ui.visualizeAmplitude(cur.pBlock, cur.frames * streamCh, streamCh,
+								streamFs);
+					}
 
-				if(m_pSFile)
-					delete m_pSFile;
+					// open, decode and filter the first block of the next track long before the current one ends
+					while ((next.pSFile == NULL) && (nextIdx < m_playQueue.size())) {
+						TRACE_SCOPE("prepareTrack");
+						_prepareTrack(m_playQueue[nextIdx++], next, dur_block);
+					}
 
-				m_pSFile = pSF;
+					if (cur.readsize == cur.bufsize)
+						_decodeBlock(cur);
+					else
+						last = true;	// incomplete block: end of track
+				}
 
-			}catch(CException &e){
-				m_ui.printMessage("Error From" + e.getSrcAsString() + ": " + e.getErrorText());
+				bool pressed;
+				{
+					TRACE_SCOPE("keyPoll");
+					pressed = m_ui.keyPressed(false);
+				}
+				if (pressed) {
+					if (key) {
+						m_audioStream.stop();
+						key = false;
+					} else {
+						m_audioStream.resume();
+						key = true;
+					}
+				}
+			}
+
+			_releaseTrack(cur);
+			if (next.pSFile == NULL)
+				break;			// end of the queue
+
+			// the device stream is only reopened if the format changes (no fixed output sample rate)
+			if ((_getProcessingRate(next.pSFile) != streamFs)
+					|| (next.pSFile->getNumChannels() != streamCh)) {
+				m_audioStream.stop();
+				_printStreamStatistics();
+				m_audioStream.close();
+				streamFs = _getProcessingRate(next.pSFile);
+				streamCh = next.pSFile->getNumChannels();
+				m_audioStream.open(streamCh, streamFs, next.framesPerBlockOut);
+				m_audioStream.resetStatistics();
+				m_audioStream.start();
 			}
+			cur = next;
+			next = TRACK();
 		}
-		else{
-			m_ui.printMessage("Directory Does not Contain any Sound File");
+
+		m_audioStream.stop();
+		_printStreamStatistics();
+		m_audioStream.close();
+		TRACE_DUMP("playqueue_trace.json");
+	} catch (CException &err) {
+		_releaseTrack(cur);
+		_releaseTrack(next);
+		try {
+			m_audioStream.close();
+		} catch (CException &e) {
+			// the first error is reported
 		}
+		err.print();
 	}
+}
 
-	_adaptFilter();
+void CAudioPlayerController::mixSounds() {
+	string mixFiles[MIX_MAXSOURCES];
+	float mixGains[MIX_MAXSOURCES];
+	int numSources = 0;
+
+	// choose the sound files to be played simultaneously
+	while (numSources < MIX_MAXSOURCES) {
+		string chosenFile;
+		m_ui.printMessage("source " + to_string(numSources) + " (choose no sound file to start mixing)\n");
+		if (_chooseSoundFile(chosenFile) == CUI_UNKNOWN)
+			break;
+		mixFiles[numSources] = chosenFile;
+		mixGains[numSources] = m_ui.getUserInputFloat("gain (linear): ")
+				* _getNormalizationGain(chosenFile);
+		numSources++;
+	}
+	if (numSources == 0) {
+		m_ui.printMessage("Error from mixSounds: No sound file chosen. \n");
+		return;
+	}
 
+	float dur_block = 0.125; //Block Duration in seconds
+
+	// the first sound file determines the output format
+	CSoundFile first(mixFiles[0], CSoundFile::FILE_READ);
+	first.open();
+	int numChan = first.getNumChannels();
+	int fsOut = _getProcessingRate(&first);
+	first.close();
+	long framesPerBlock = fsOut * dur_block;
+
+	CMixer mixer(numChan, framesPerBlock);
+	for (int i = 0; i < numSources; i++) {
+		CSoundFileSource *pSrc = NULL;
+		try {
+			pSrc = new CSoundFileSource(mixFiles[i], _cloneFilter(fsOut, numChan),
+					fsOut, m_srcQuality, dur_block);
+			mixer.addSource(pSrc, mixGains[i]);
+		} catch (CException &e) {
+			if (pSrc)
+				delete pSrc;
+			m_ui.printMessage("Error from mixSounds: " + mixFiles[i] + ": "
+					+ e.getErrorText() + "\n");
+		}
+	}
+
+	float *mixblock = m_pPool->acquire(numChan * framesPerBlock);
+	try {
+		m_audioStream.open(numChan, fsOut, framesPerBlock);
+		m_audioStream.resetStatistics();
+		m_ui.keyPressed(true);
+		m_audioStream.start();
+		bool key = true;
+		bool active = true;
+
+		while (active) {
+			if (key) {
+				active = (mixer.process(mixblock, framesPerBlock) > 0);
+				m_audioStream.play(mixblock, framesPerBlock);
+				m_ui.visualizeAmplitude(mixblock, numChan * framesPerBlock, numChan, fsOut);
+				mixer.releaseRetired();		// sources that have ended
+			}
+
+			if (m_ui.keyPressed(false)) {
+				if (key) {
+					m_audioStream.stop();
+					key = false;
+				} else {
+					m_audioStream.resume();
+					key = true;
+				}
+			}
+		}
+
+		m_audioStream.stop();
+		_printStreamStatistics();
+		m_audioStream.close();
+	} catch (CException &err) {
+		m_audioStream.close();
+		err.print();
+	}
+	m_pPool->release(mixblock);
 }
 
 void CAudioPlayerController::chooseAmplitudeScale() {
@@ -308,16 +557,176 @@ void CAudioPlayerController::chooseAmplitudeScale() {
 	if(idChoice == 0){
 		m_ui.setAmplitudeScaling(CAmpMeter::SCALING_MODE_LIN);
 	}
-	if(idChoice == 1){
+	else if(idChoice == 1){
 		m_ui.setAmplitudeScaling(CAmpMeter::SCALING_MODE_LOG);
 	}
-	else
+	else {
 		m_ui.printMessage("Invalid Choice");
+		return;
+	}
+
+	string modeMenue[] = { "Peak", "RMS", "True Peak (4x oversampled)",
+			"Spectrum (16 bands)", "" };
+	CAmpMeter::METER_MODE modes[] = { CAmpMeter::METER_MODE_PEAK,
+			CAmpMeter::METER_MODE_RMS, CAmpMeter::METER_MODE_TRUEPEAK,
+			CAmpMeter::METER_MODE_SPECTRUM };
+	idChoice = m_ui.getListSelection(modeMenue, "choose the displayed value");
+	if ((idChoice >= 0) && (idChoice < 4))
+		m_ui.setAmplitudeMode(modes[idChoice]);
+	else {
+		m_ui.printMessage("Invalid Choice");
+		return;
+	}
+
+	string layoutMenue[] = { "one bar for all channels", "8+8 LEDs (stereo)",
+			"one channel after the other", "" };
+	CAmpMeter::LED_LAYOUT layouts[] = { CAmpMeter::LAYOUT_COMBINED,
+			CAmpMeter::LAYOUT_SPLIT, CAmpMeter::LAYOUT_CYCLE };
+	idChoice = m_ui.getListSelection(layoutMenue, "choose the LED layout");
+	if ((idChoice >= 0) && (idChoice < 3))
+		m_ui.setAmplitudeLayout(layouts[idChoice]);
+	else {
+		m_ui.printMessage("Invalid Choice");
+		return;
+	}
+
+	double rate = m_ui.getUserInputDouble("refresh rate of the LED bar [Hz] (1 ... 100, currently "
+			+ to_string((int) m_ui.getAmplitudeRefreshRate()) + "): ");
+	if ((rate >= 1.) && (rate <= 100.))
+		m_ui.setAmplitudeRefreshRate(rate);
+	else
+		m_ui.printMessage("invalid refresh rate. Did not change it. \n");
+}
+
+void CAudioPlayerController::chooseOutputRate() {
+	string fsMenue[] = { "sample rate of the sound file", "44100 Hz", "48000 Hz",
+			"96000 Hz", "" };
+	int fsValues[] = { 0, 44100, 48000, 96000 };
+	int idChoice = m_ui.getListSelection(fsMenue, "choose the output sample rate");
+	if (idChoice == CUI_UNKNOWN) {
+		m_ui.printMessage("invalid selection. Did not change output sample rate. \n");
+		return;
+	}
+	m_deviceFs = fsValues[idChoice];
+
+	if (m_deviceFs) {
+		string qMenue[] = { "low", "medium", "high", "" };
+		int idQuality = m_ui.getListSelection(qMenue, "choose the resampling quality");
+		if (idQuality == 0)
+			m_srcQuality = CResampler::QUALITY_LOW;
+		else if (idQuality == 2)
+			m_srcQuality = CResampler::QUALITY_HIGH;
+		else
+			m_srcQuality = CResampler::QUALITY_MEDIUM;
+	}
+
+	// filters are applied at the output sample rate
+	_adaptFilter();
+}
+
+void CAudioPlayerController::chooseLatencyTarget() {
+	m_ui.printMessage("current " + m_blockSizer.getStateStr(44100));
+	double target_ms = m_ui.getUserInputDouble("latency target [ms] (10 ... 1000): ");
+	if ((target_ms < 10.) || (target_ms > 1000.)) {
+		m_ui.printMessage("invalid latency target. Did not change it. \n");
+		return;
+	}
+	m_blockSizer.setLatencyTarget(target_ms / 1000.);
+}
+
+void CAudioPlayerController::chooseNormalization() {
+	string normMenue[] = { "off", "EBU R128 (-23 LUFS)", "other target loudness", "" };
+	int idChoice = m_ui.getListSelection(normMenue, "choose the loudness normalization");
+	if (idChoice == 0)
+		m_normalize = false;
+	else if (idChoice == 1) {
+		m_normalize = true;
+		m_loudnessTarget = LOUD_TARGET;
+	} else if (idChoice == 2) {
+		double target = m_ui.getUserInputDouble("target loudness [LUFS] (-40 ... -5): ");
+		if ((target < -40.) || (target > -5.)) {
+			m_ui.printMessage("invalid target loudness. Did not change it. \n");
+			return;
+		}
+		m_normalize = true;
+		m_loudnessTarget = target;
+	} else
+		m_ui.printMessage("invalid selection. Did not change the normalization. \n");
+}
+
+void CAudioPlayerController::manageRenderCache() {
+	m_ui.printMessage(m_renderCache.getStateStr());
+	string cacheMenue[] = { "back", "clear the render cache", "" };
+	if (m_ui.getListSelection(cacheMenue, "render cache") == 1)
+		m_renderCache.clear();
+}
+
+void CAudioPlayerController::analyzeLibrary() {
+	m_ui.printMessage(m_library.getStateStr());
+	if (m_library.isRunning())
+		return;
+	string libMenue[] = { "back", "rescan the sound files", "" };
+	if (m_ui.getListSelection(libMenue, "library analysis") == 1)
+		m_library.start(".\\files\\sounds\\", ".wav");
+}
+
+void CAudioPlayerController::chooseOutputFormat() {
+	string fmtMenue[] = { "32 bit float", "16 bit integer",
+			"16 bit integer, dithered", "24 bit integer",
+			"24 bit integer, dithered", "" };
+	int idChoice = m_ui.getListSelection(fmtMenue, "choose the output format");
+	switch (idChoice) {
+	case 0:
+		m_audioStream.setSampleFormat(CAudioOutStream::FMT_FLOAT32);
+		break;
+	case 1:
+	case 2:
+		m_audioStream.setSampleFormat(CAudioOutStream::FMT_INT16, idChoice == 2);
+		break;
+	case 3:
+	case 4:
+		m_audioStream.setSampleFormat(CAudioOutStream::FMT_INT24, idChoice == 4);
+		break;
+	default:
+		m_ui.printMessage("invalid selection. Did not change output format. \n");
+	}
 }
 
 /**
  * private helper methods
  */
+void CAudioPlayerController::_printStreamStatistics() {
+	CAudioOutStream::STATISTICS st = m_audioStream.getStatistics();
+	m_ui.printMessage("Output statistics: " + to_string(st.blocks) + " blocks, "
+			+ to_string(st.underflows) + " underflows, "
+			+ to_string(st.lateBlocks) + " late blocks\n");
+	m_ui.printMessage("write time [ms] min/mean/max: "
+			+ to_string(st.writeTimeMin * 1000.) + " / "
+			+ to_string(st.writeTimeMean * 1000.) + " / "
+			+ to_string(st.writeTimeMax * 1000.) + "\n");
+	m_ui.printMessage("device buffer fill [frames] low/high: "
+			+ to_string(st.fillLow) + " / " + to_string(st.fillHigh) + "\n");
+}
+
+void CAudioPlayerController::_printWaveform(CSoundFile &sfile) {
+	CWaveformFile wave(sfile.getPath() + WAVE_EXT);
+	if (!wave.open() || !wave.isCurrent(sfile) || (wave.getNumFrames() == 0))
+		return;		// not analyzed yet
+
+	// peak of each column in 8 steps
+	const char steps[] = " .:-=+*#";
+	WAVEPEAK peaks[CTRL_WAVECOLUMNS];
+	for (int c = 0; (c < wave.getNumChannels()) && (c < 2); c++) {
+		wave.getPeaks(c, 0, wave.getNumFrames(), peaks, CTRL_WAVECOLUMNS);
+		string line = "|";
+		for (int i = 0; i < CTRL_WAVECOLUMNS; i++) {
+			float peak = fmax(-peaks[i].min, peaks[i].max);
+			line += steps[(peak >= 1.f) ? 7 : (int) (peak * 8.f)];
+		}
+		m_ui.printMessage(line + "|\n");
+	}
+}
+
 bool CAudioPlayerController::_configDelayFilter(int &delay_ms, float &gFF,
 		float &gFB) {
 	m_ui.printMessage("Delay filter configuration\n------------\n");
@@ -341,6 +750,58 @@ void CAudioPlayerController::_createDelayFilter(int delay_ms, float gFF,
 //			m_pSFile->getNumChannels());
 }
 
+int CAudioPlayerController::_chooseSoundFile(string &chosenFile,
+		string filePath, string fileExt) {
+	string soundlist[25];
+	uint16_t numsndfiles = _getFiles(filePath, fileExt, soundlist, 25);
+
+	// list the files and their information
+	int sid = CUI_UNKNOWN;
+
+	if(numsndfiles){
+
+		// prepare a string array for the user interface, that will contain  a menu with the selection of sound files
+		// there is place for an additional entry for an empty string
+
+		string *pSNDMenue = new string[numsndfiles + 2];
+		for(int i = 0; i < numsndfiles; i++){
+
+			// create a sound file object
+			CSoundFile sndfile(filePath + soundlist[i], CSoundFile::FILE_READ);
+
+			try{
+				sndfile.open();
+				pSNDMenue[i] = soundlist[i] + "[" + to_string(sndfile.getSampleRate()) + "Hz, " + to_string(sndfile.getNumChannels()) + "]";
+				sndfile.close();
+			}catch(CException &e){
+
+				//file can not be read
+				if(e.getErrorCode() != CSoundFile::FILE_READ){
+					sndfile.close();
+				}
+			}
+		}
+
+		// add the last menu entry for the choice of an no sound file
+		pSNDMenue[numsndfiles] = "-1 [no soundfile]";
+
+		// pass the arrays to the user interface and wait for the user's input
+		// if the user provides a soundID which is not in pSNDMenue, the method returns
+		// CUI_UNKNOWN
+
+		sid = m_ui.getListSelection(pSNDMenue, "Choose a sound file");
+		//destroy the array
+		delete[] pSNDMenue;
+
+		// the last entry means "no sound file"
+		if (sid >= numsndfiles)
+			sid = CUI_UNKNOWN;
+		if (sid != CUI_UNKNOWN)
+			chosenFile = filePath + soundlist[sid];
+	}
+	return sid;
+}
+
 int CAudioPlayerController::_chooseFilterFile(string &chosenFile,
 		string filePath, string fileExt) {
 	string filterlist[25];
@@ -363,7 +824,7 @@ int CAudioPlayerController::_chooseFilterFile(string &chosenFile,
 			try {
 				fltfile.open();
 				// check if it has a filter with an appropriate sampling frequency
-				fltfile.read(m_pSFile->getSampleRate());
+				fltfile.read(_getProcessingRate(m_pSFile));
 				// insert the filter data into the string array
 				pFlt[i] = fltfile.getFilterType() + ", order="
 						+ to_string(fltfile.getOrder())
@@ -397,10 +858,11 @@ void CAudioPlayerController::_createFilter(string filterFile) {
 	// if there was a filter object from a preceding choice of the user that does not fit anymore, delete this
 	if (m_pFilter)
 		delete m_pFilter;
+	m_pFilter = NULL;
 
 	CFilterFile fltfile(filterFile, CFilterFile::FILE_READ);
 	fltfile.open();
-	fltfile.read(m_pSFile->getSampleRate());
+	fltfile.read(_getProcessingRate(m_pSFile));
 
 	// create filter
 	// get filter data
@@ -423,6 +885,7 @@ void CAudioPlayerController::_adaptFilter() {
 					"Delay filters are not yet implemented. Filter will be deleted. \n");
 			if (m_pFilter)
 				delete m_pFilter;
+			m_pFilter = NULL;
 
 			// todo: comment in, if CDelayFilter exists
 //			CDelayFilter *pdflt = (CDelayFilter*) m_pFilter;
@@ -432,6 +895,133 @@ void CAudioPlayerController::_adaptFilter() {
 	}
 }
 
+CFilterBase* CAudioPlayerController::_cloneFilter(int fs, int numChan) {
+	if (!m_pFilter)
+		return NULL;
+
+	// same sampling frequency and channels: the current filter fits
+	if (m_pSFile && (fs == _getProcessingRate(m_pSFile))
+			&& (numChan == m_pSFile->getNumChannels()))
+		return m_pFilter->clone();
+
+	if (typeid(*m_pFilter) != typeid(CFilter))
+		return NULL;
+
+	// read the coefficients of the filter file for the sampling frequency
+	CFilterFile fltfile(((CFilter*) m_pFilter)->getFilePath(), CFilterFile::FILE_READ);
+	fltfile.open();
+	if (fltfile.read(fs) == 0)
+		return NULL;
+	return new CFilter(((CFilter*) m_pFilter)->getFilePath(),
+			fltfile.getACoeffs(), fltfile.getBCoeffs(), fltfile.getOrder(),
+			numChan);
+}
+
+bool CAudioPlayerController::_prepareTrack(const string &path, TRACK &track,
+		float dur_block) {
+	track = TRACK();
+	track.path = path;
+	track.pSFile = new CSoundFile(path, CSoundFile::FILE_READ);
+	try {
+		track.pSFile->open();
+		track.gain = _getNormalizationGain(path);
+		track.pFilter = _cloneFilter(_getProcessingRate(track.pSFile),
+				track.pSFile->getNumChannels());
+		if (m_pFilter && !track.pFilter)
+			m_ui.printMessage("Message from playQueue: No filter for " + path
+					+ ". Playing unfiltered sound. \n");
+	} catch (CException &e) {
+		m_ui.printMessage("Error from playQueue: " + path + ": "
+				+ e.getErrorText() + "\n");
+		_releaseTrack(track);
+		return false;
+	}
+
+	_initTrack(track, dur_block);
+	return true;
+}
+
+void CAudioPlayerController::_initTrack(TRACK &track, float dur_block) {
+	int numChan = track.pSFile->getNumChannels();
+	int fsOut = _getProcessingRate(track.pSFile);
+	track.framesPerBlock = track.pSFile->getSampleRate() * dur_block;
+	track.framesPerBlockOut = fsOut * dur_block;
+	track.bufsize = numChan * track.framesPerBlock;
+	track.pIn = m_pPool->acquire(track.bufsize);
+
+	// sample rate conversion between CSoundFile::read and filter/output
+	track.outCapacity = track.framesPerBlock;
+	if (fsOut != track.pSFile->getSampleRate()) {
+		track.pResampler = new CResampler(track.pSFile->getSampleRate(), fsOut,
+				numChan, m_srcQuality);
+		// the last block contains the resampler's delayed frames, too
+		track.outCapacity = track.pResampler->getMaxOutFrames(track.framesPerBlock)
+				+ track.pResampler->getMaxOutFrames(64);
+		track.pRes = m_pPool->acquire(numChan * track.outCapacity);
+	}
+	if (track.pFilter)
+		track.pFlt = m_pPool->acquire(numChan * track.outCapacity);
+	_decodeBlock(track);
+}
+
+void CAudioPlayerController::_decodeBlock(TRACK &track) {
+	int numChan = track.pSFile->getNumChannels();
+	{
+		TRACE_SCOPE("read");
+		track.readsize = track.pSFile->read(track.pIn, track.bufsize);
+	}
+	track.pBlock = track.pIn;
+	track.frames = track.readsize / numChan;
+
+	if (track.pResampler) {
+		TRACE_SCOPE("resample");
+		int n = track.pResampler->process(track.pIn, track.frames, track.pRes,
+				track.outCapacity);
+		if (track.readsize < track.bufsize)	// end of the file
+			n += track.pResampler->flush(track.pRes + n * numChan,
+					track.outCapacity - n);
+		track.pBlock = track.pRes;
+		track.frames = n;
+	}
+	// the last block may be shorter than the order of the filter
+	TRACE_SCOPE("filter");
+	if (track.pFilter
+			&& track.pFilter->filterBlock(track.pBlock, track.pFlt, track.frames))
+		track.pBlock = track.pFlt;
+	if (track.gain != 1.f)
+		CLoudnessMeter::applyGain(track.pBlock, track.frames * numChan, track.gain);
+}
+
+void CAudioPlayerController::_releaseTrack(TRACK &track) {
+	m_pPool->release(track.pFlt);
+	m_pPool->release(track.pRes);
+	m_pPool->release(track.pIn);
+	if (track.pResampler)
+		delete track.pResampler;
+	if (track.pFilter)
+		delete track.pFilter;
+	if (track.pSFile)
+		delete track.pSFile;		// closes the file
+	track = TRACK();
+}
+
+float CAudioPlayerController::_getNormalizationGain(const string &path) {
+	if (!m_normalize)
+		return 1.f;
+	LOUDNESSINFO info;
+	if (!CLoudnessMeter::loadInfo(path, info)) {
+		// analyzing the whole file here would delay the playback
+		m_library.prioritize(path);
+		m_ui.printMessage(path + ": not analyzed yet, played without normalization\n");
+		return 1.f;
+	}
+	return CLoudnessMeter::getNormalizationGain(info, m_loudnessTarget);
+}
+
+int CAudioPlayerController::_getProcessingRate(CSoundFile *pSF) {
+	return m_deviceFs ? m_deviceFs : pSF->getSampleRate();
+}
+
 uint16_t CAudioPlayerController::_getFiles(string path, string ext,
 		string *filelist, uint16_t maxNumFiles) {
 	dirent *entry;
@@ -446,7 +1036,9 @@ uint16_t CAudioPlayerController::_getFiles(string path, string ext,
 	uint16_t i = 0;
 	while ((entry = readdir(dp))) {
 		file = entry->d_name;
-		if (file.rfind(ext) != string::npos) {
+		// the extension at the end (not the metadata files of the sound files)
+		if ((file.size() >= ext.size())
+				&& (file.compare(file.size() - ext.size(), ext.size(), ext) == 0)) {
 			if (i >= maxNumFiles) {
 				m_ui.printMessage("Incomplete file list!\n");
 				break;
@@ -4,17 +4,102 @@
 #include "CFilter.h"
 #include "CUserInterface.h"
 #include "CAudioOutStream.h"
+#include "CResampler.h"
+#include "CMixer.h"
+#include "CPlaybackPipeline.h"
+#include "CBlockSizer.h"
+#include "CLoudnessMeter.h"
+#include "CLibraryAnalyzer.h"
+#include "CWaveform.h"
+#include "CRenderCache.h"
+#include <deque>
+
+/**
+ * columns of the waveform overview of the selected sound file
+ */
+#define CTRL_WAVECOLUMNS 64
 
 class CAudioPlayerController {
 private:
+	/**
+	 * \brief a track that is ready for playing
+	 *
+	 * the sound file is open, the filter matches its channels and the output sample rate
+	 * and the current block has already been decoded, resampled and filtered
+	 */
+	struct TRACK {
+		string path;
+		CSoundFile *pSFile;
+		CFilterBase *pFilter;
+		CResampler *pResampler;	// NULL if the sound file has the output sample rate
+		float *pIn;			// decoded block (all block buffers are taken from m_pPool)
+		float *pRes;		// resampled block (NULL without resampler)
+		float *pFlt;		// filtered block (NULL without filter)
+		float *pBlock;		// block to be played (one of the above)
+		long framesPerBlock;	// input frames per block
+		long framesPerBlockOut;	// nominal output frames per block
+		int outCapacity;	// capacity of pRes and pFlt in frames
+		int bufsize;		// size of the input block buffer in samples
+		int readsize;		// number of samples read into the current block
+		int frames;			// number of frames in pBlock
+		float gain;			// loudness normalization gain
+	};
 
 	CUserInterface m_ui;
 	CFilterBase *m_pFilter;
 	CSoundFile *m_pSFile;
+	/**
+	 * background analysis of the sound files, throttled while the stream plays
+	 * (declared before the stream, which reports its state to it)
+	 */
+	CLibraryAnalyzer m_library;
 	CAudioOutStream m_audioStream;
+	/**
+	 * pool of the block buffers (shared with the tests of main)
+	 */
+	CBlockPool *m_pPool;
+	/**
+	 * multi-threaded playback of a single sound file by play()
+	 */
+	CPlaybackPipeline m_pipeline;
+	/**
+	 * paths of the sound files to be played by playQueue()
+	 */
+	deque<string> m_playQueue;
+	/**
+	 * fixed output sample rate of the device (0: sample rate of the sound file)
+	 *
+	 * sound files with another sample rate are resampled before filtering, so
+	 * filters are applied at this rate
+	 */
+	int m_deviceFs;
+	/**
+	 * quality of the resampler
+	 */
+	CResampler::QUALITY m_srcQuality;
+	/**
+	 * block size of play() from the measured processing cost and the latency target
+	 */
+	CBlockSizer m_blockSizer;
+	/**
+	 * loudness normalization of the played sound files and its target [LUFS]
+	 *
+	 * the loudness is analyzed once per sound file and stored in its metadata
+	 * file, the playback only applies the gain
+	 */
+	bool m_normalize;
+	double m_loudnessTarget;
+	/**
+	 * filtered sound files played completely by play() (played again without
+	 * filtering)
+	 */
+	CRenderCache m_renderCache;
 
 public:
-	CAudioPlayerController();
+	/**
+	 * \param pPool [in] pool of the block buffers used for playback
+	 */
+	CAudioPlayerController(CBlockPool *pPool);
 	~CAudioPlayerController();
 	void run();
 
@@ -24,6 +109,29 @@ private:
 	void play();
 	void chooseSound();
 
+	/**
+	 * \brief lets the user add sound files to the play queue, remove the last one or clear it
+	 */
+	void editPlayQueue();
+
+	/**
+	 * \brief plays all sound files of the play queue without gaps
+	 *
+	 * the device stream stays open between tracks of the same sampling frequency and
+	 * number of channels. While a track is playing, the next one is opened and its first
+	 * block is decoded and filtered by a clone of the current filter.
+	 */
+	void playQueue();
+
+	/**
+	 * \brief plays several sound files simultaneously
+	 *
+	 * lets the user choose the sound files and their gains. Each sound file is
+	 * resampled to the output sample rate of the first one and filtered by its own
+	 * copy of the current filter before it is mixed.
+	 */
+	void mixSounds();
+
 	/**
 	 * \brief Displays a menu with the options "linear scale" and "logarithmic scale" and
 	 * \brief lets the user choose an option and calls m_ui.setAmplitudeScaling() according to
@@ -34,12 +142,46 @@ private:
 	 */
 	void chooseAmplitudeScale();
 
+	/**
+	 * \brief lets the user choose a fixed output sample rate and the resampling quality
+	 *
+	 * the current filter is adapted to the new output sample rate
+	 */
+	void chooseOutputRate();
+
+	/**
+	 * \brief lets the user choose the sample format of the device stream (float, 16 or
+	 * 24 bit integer with or without dither)
+	 */
+	void chooseOutputFormat();
+
+	/**
+	 * \brief lets the user set the latency target of the block sizing
+	 */
+	void chooseLatencyTarget();
+
+	/**
+	 * \brief lets the user switch the loudness normalization on or off and set its target
+	 */
+	void chooseNormalization();
+
+	/**
+	 * \brief shows the progress of the library analysis and lets the user rescan
+	 * the sound files
+	 */
+	void analyzeLibrary();
+
+	/**
+	 * \brief shows the size of the render cache and lets the user clear it
+	 */
+	void manageRenderCache();
+
 private:
 	/**
 	 * \brief user choice of filter from filter files stored in filePath
 	 *
 	 * only filter files that are containing the sampling frequency of the
-	 * currently selected audio file
+	 * currently selected audio file (or the fixed output sample rate)
 	 *
 	 * \param fs[in] - appropriate sampling frequency
 	 * \param chosenFile[out] - filter file chosen by the user
@@ -50,6 +192,17 @@ private:
 	int _chooseFilterFile(string &chosenFile, string filePath =
 			".\\files\\filters\\", string fileExt = ".txt");
 
+	/**
+	 * \brief user choice of a sound file stored in filePath
+	 *
+	 * \param chosenFile[out] - sound file chosen by the user
+	 * \param filePath[in] - directory where the files are stored
+	 * \param fileExt[in] - extension of the files
+	 * \return id of the chosen sound file in the menue list or CUI_UNKNOWN
+	 */
+	int _chooseSoundFile(string &chosenFile, string filePath =
+			".\\files\\sounds\\", string fileExt = ".wav");
+
 	/**
 	 * \brief creates filter from given filter file for given sampling frequency
 	 * \param fs[in] - appropriate sampling frequency
@@ -85,6 +238,60 @@ private:
 	 */
 	void _adaptFilter();
 
+	/**
+	 * \brief creates a filter with the configuration of the current filter
+	 *
+	 * clones the current filter if the sampling frequency and channels match the
+	 * selected sound file, otherwise the filter file is read for the sampling frequency
+	 *
+	 * \param fs[in] - sampling frequency at which the filter is applied
+	 * \param numChan[in] - number of channels
+	 * \return new filter or NULL (no filter selected or no coefficients for this sampling frequency)
+	 */
+	CFilterBase* _cloneFilter(int fs, int numChan);
+
+	/**
+	 * \brief opens a sound file of the play queue, creates its filter and decodes its first block
+	 * \param path[in] - path of the sound file
+	 * \param track[out] - prepared track
+	 * \param dur_block[in] - block duration in seconds
+	 * \return true if the track is ready, false if the file could not be opened
+	 */
+	bool _prepareTrack(const string &path, TRACK &track, float dur_block);
+
+	/**
+	 * \brief creates the resampler and block buffers of a track and decodes its first block
+	 * \param track[in/out] - track with open sound file and filter
+	 * \param dur_block[in] - block duration in seconds
+	 */
+	void _initTrack(TRACK &track, float dur_block);
+
+	/**
+	 * \brief reads, resamples and filters the next block of a track
+	 */
+	void _decodeBlock(TRACK &track);
+
+	/**
+	 * \brief deletes the resampler, block buffers, sound file and filter of a track
+	 */
+	void _releaseTrack(TRACK &track);
+
+	/**
+	 * \brief normalization gain of a sound file from its metadata file
+	 *
+	 * a sound file whose loudness isn't stored yet is moved to the front of the
+	 * library analysis and played at its own level this time
+	 *
+	 * \param path[in] - path of the sound file
+	 * \return linear gain (1 if the normalization is off or the file isn't analyzed yet)
+	 */
+	float _getNormalizationGain(const string &path);
+
+	/**
+	 * \return sample rate at which the given sound file is filtered and played
+	 */
+	int _getProcessingRate(CSoundFile *pSF);
+
 	/**
 	 * \brief reads all filenames with the given extension from the given directory and writes them
 	 * into a string array
@@ -96,5 +303,19 @@ private:
 	 */
 	uint16_t _getFiles(string path, string ext, string *filelist,
 			uint16_t maxNumFiles);
+
+	/**
+	 * \brief prints the output stream statistics of the last played track
+	 * (underflows, late blocks, write durations, buffer fill watermarks)
+	 */
+	void _printStreamStatistics();
+
+	/**
+	 * \brief prints the waveform overview of a sound file (one line per channel,
+	 * at most two), if the library analysis has already stored it
+	 *
+	 * \param sfile [in] open sound file
+	 */
+	void _printWaveform(CSoundFile &sfile);
 };
 #endif /* SRC_CAUDIOPLAYERCONTROLLER_H_ */
@@ -0,0 +1,163 @@
+#include <chrono>
+#include <thread>
+#include <SKSLib.h>
+#include "CFile.h"
+#include "CFilter.h"
+#include "CBatchRenderer.h"
+
+CBatchRenderer::CBatchRenderer(CBlockPool *pPool, float blockDur) {
+	if ((pPool == NULL) || (blockDur <= 0.f))
+		throw CException(CException::SRC_File, BATCH_E_PARAMS,
+				"Invalid batch render parameters.");
+	m_pPool = pPool;
+	m_blockDur = blockDur;
+	m_next = 0;
+	m_wallTime = 0.;
+}
+
+void CBatchRenderer::addJob(string inPath, string fltPath, string outPath) {
+	JOB job = JOB();
+	job.inPath = inPath;
+	job.fltPath = fltPath;
+	job.outPath = outPath;
+	m_jobs.push_back(job);
+}
+
+int CBatchRenderer::getNumJobs() {
+	return m_jobs.size();
+}
+
+CBatchRenderer::JOB CBatchRenderer::getJob(int i) {
+	return m_jobs.at(i);
+}
+
+int CBatchRenderer::run(int numThreads) {
+	if (numThreads <= 0)
+		numThreads = thread::hardware_concurrency();
+	if (numThreads <= 0)			// unknown
+		numThreads = 1;
+	if (numThreads > BATCH_MAXTHREADS)
+		numThreads = BATCH_MAXTHREADS;
+	if (numThreads > (int) m_jobs.size())
+		numThreads = m_jobs.size();
+
+	for (unsigned int i = 0; i < m_jobs.size(); i++) {
+		m_jobs[i].ok = false;
+		m_jobs[i].error = "not rendered";
+	}
+	m_next = 0;
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	pthread_t threads[BATCH_MAXTHREADS];
+	int started = 0;
+	for (int t = 0; t < numThreads; t++)
+		if (pthread_create(&threads[started], NULL, workerThreadHandler, (void*) this) == 0)
+			started++;
+	// the started workers take all jobs, without any the jobs are rendered here
+	if (started == 0)
+		workerThreadHandler((void*) this);
+	for (int t = 0; t < started; t++)
+		pthread_join(threads[t], NULL);
+	m_wallTime = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	int failed = 0;
+	for (unsigned int i = 0; i < m_jobs.size(); i++)
+		if (!m_jobs[i].ok)
+			failed++;
+	return failed;
+}
+
+double CBatchRenderer::getAudioSeconds() {
+	double sec = 0.;
+	for (unsigned int i = 0; i < m_jobs.size(); i++)
+		if (m_jobs[i].ok)
+			sec += (double) m_jobs[i].frames / m_jobs[i].fs;
+	return sec;
+}
+
+double CBatchRenderer::getWallTime() {
+	return m_wallTime;
+}
+
+double CBatchRenderer::getRealtimeFactor() {
+	return (m_wallTime > 0.) ? getAudioSeconds() / m_wallTime : 0.;
+}
+
+void* CBatchRenderer::workerThreadHandler(void *Obj) {
+	CBatchRenderer *pR = (CBatchRenderer*) Obj;
+	unsigned int i;
+	// the deque is not modified during run(), so the jobs may be accessed concurrently
+	while ((i = pR->m_next.fetch_add(1)) < pR->m_jobs.size()) {
+		JOB &job = pR->m_jobs[i];
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		try {
+			pR->_render(job);
+			job.ok = true;
+			job.error = "";
+		} catch (CException &e) {
+			job.error = e.getErrorText();
+		} catch (exception &e) {
+			job.error = e.what();
+		}
+		job.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	}
+	return NULL;
+}
+
+void CBatchRenderer::_render(JOB &job) {
+	CSoundFile sndfile(job.inPath, CSoundFile::FILE_READ);
+	sndfile.open();
+	int numChan = sndfile.getNumChannels();
+	job.fs = sndfile.getSampleRate();
+	job.frames = 0;
+
+	CFilter *pFilter = NULL;
+	if (!job.fltPath.empty()) {
+		CFilterFile fltfile(job.fltPath, CFilterFile::FILE_READ);
+		fltfile.open();
+		fltfile.read(job.fs);
+		if ((fltfile.getACoeffs() == NULL) || (fltfile.getBCoeffs() == NULL))
+			throw CException(CException::SRC_File, BATCH_E_FILTER,
+					job.fltPath + ": no coefficients for " + to_string(job.fs) + " Hz.");
+		pFilter = new CFilter(job.fltPath, fltfile.getACoeffs(),
+				fltfile.getBCoeffs(), fltfile.getOrder(), numChan);
+	}
+
+	// the output file has the same characteristics as the input file
+	CSoundFile outfile(job.outPath, CSoundFile::FILE_WRITE);
+	outfile.setFormat(sndfile.getFormat());
+	outfile.setNumChannels(numChan);
+	outfile.setSampleRate(job.fs);
+
+	long framesPerBlock = job.fs * m_blockDur;
+	int bufsize = numChan * framesPerBlock;
+	float *pIn = NULL, *pOut = NULL;
+	try {
+		outfile.open();
+		pIn = m_pPool->acquire(bufsize);
+		pOut = m_pPool->acquire(bufsize);
+		int readsize;
+		do {
+			readsize = sndfile.read(pIn, bufsize);
+			int frames = readsize / numChan;
+			// the filter needs at least order frames (may fail for the last block)
+			if (pFilter && pFilter->filter(pIn, pOut, frames))
+				outfile.write(pOut, readsize);
+			else
+				outfile.write(pIn, readsize);
+			job.frames += frames;
+		} while (readsize == bufsize);
+	} catch (...) {				// CException or e.g. std::bad_alloc
+		m_pPool->release(pIn);
+		m_pPool->release(pOut);
+		if (pFilter)
+			delete pFilter;
+		throw;
+	}
+	m_pPool->release(pIn);
+	m_pPool->release(pOut);
+	if (pFilter)
+		delete pFilter;
+	outfile.close();
+	sndfile.close();
+}
@@ -0,0 +1,116 @@
+#ifndef CBATCHRENDERER_H_
+#define CBATCHRENDERER_H_
+
+#include <atomic>
+#include <exception>
+#include <string>
+#include <deque>
+#include <pthread.h>
+using namespace std;
+
+#include "CBlockPool.h"
+
+/**
+ * maximum number of worker threads of a batch render
+ */
+#define BATCH_MAXTHREADS 64
+
+/**
+ * \brief filters sound files without audio output (faster than real time)
+ *
+ * each job reads a sound file, filters it with the coefficients of a filter file
+ * (for the sample rate of the sound file) and writes the result in the format of
+ * the input file. The jobs are distributed over worker threads, each thread
+ * renders one file at a time as fast as possible.
+ */
+class CBatchRenderer {
+public:
+	enum BATCH_ERROR {
+		BATCH_E_PARAMS, BATCH_E_FILTER
+	};
+	/**
+	 * \brief a render job and its result
+	 */
+	struct JOB {
+		string inPath;
+		string fltPath;		// empty: the file is copied unfiltered
+		string outPath;
+		bool ok;			// rendered without error
+		string error;		// error text if not ok
+		long frames;		// number of frames rendered
+		int fs;				// sample rate of the file
+		double seconds;		// processing time [s]
+	};
+
+private:
+	deque<JOB> m_jobs;
+	CBlockPool *m_pPool;
+	/**
+	 * block duration in seconds
+	 */
+	float m_blockDur;
+	/**
+	 * index of the next job to be taken by a worker
+	 */
+	atomic<unsigned int> m_next;
+	/**
+	 * duration of the last run() [s]
+	 */
+	double m_wallTime;
+
+public:
+	/**
+	 * \param pPool [in] pool of the block buffers
+	 * \param blockDur [in] block duration in seconds
+	 */
+	CBatchRenderer(CBlockPool *pPool, float blockDur = 1.f);
+
+	/**
+	 * \brief appends a job
+	 * \param inPath [in] sound file to be filtered
+	 * \param fltPath [in] filter file (empty string: no filter)
+	 * \param outPath [in] sound file to be written
+	 */
+	void addJob(string inPath, string fltPath, string outPath);
+
+	/**
+	 * \brief renders all jobs (blocking until all jobs are finished)
+	 *
+	 * errors of a job are stored in the job, the other jobs are rendered anyway
+	 *
+	 * \param numThreads [in] number of worker threads (0: number of cores)
+	 * \return number of jobs that failed
+	 */
+	int run(int numThreads = 0);
+
+	int getNumJobs();
+	JOB getJob(int i);
+
+	/**
+	 * \return sum of the durations of the rendered files [s]
+	 */
+	double getAudioSeconds();
+	/**
+	 * \return duration of the last run() [s]
+	 */
+	double getWallTime();
+	/**
+	 * \return rendered audio duration per wall clock time of the last run()
+	 */
+	double getRealtimeFactor();
+
+private:
+	/**
+	 * \brief renders a single job (throws on errors)
+	 */
+	void _render(JOB &job);
+
+	/**
+	 * \brief thread function of the workers, takes jobs until all are taken
+	 *
+	 * \param Obj pointer on the instance
+	 */
+	static void* workerThreadHandler(void *Obj);
+};
+
+#endif /* CBATCHRENDERER_H_ */
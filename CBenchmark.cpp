@@ -0,0 +1,432 @@
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <SKSLib.h>
+#include "CFile.h"
+#include "CFilter.h"
+#include "CAmpMeter.h"
+#include "CSpectrumAnalyzer.h"
+#include "CVisualizer.h"
+#include "CLEDWriter.h"
+#include "CLoudnessMeter.h"
+#include "CWaveform.h"
+#include "CPlayerCVDevice.h"
+#include "CBenchmark.h"
+
+/*
+ * allocation counter: replaces the global operator new/delete of the program
+ * (new[] and the nothrow versions call these by default). The allocations are
+ * only counted while the benchmarks run, other code pays one relaxed load.
+ */
+static atomic<bool> s_countAllocs(false);
+static atomic<unsigned long> s_numAllocs(0);
+
+void* operator new(size_t size) {
+	if (s_countAllocs.load(memory_order_relaxed))
+		s_numAllocs.fetch_add(1, memory_order_relaxed);
+	void *p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
+#endif
+
+/**
+ * \brief visualization device that discards the LED patterns (amplitude meter benchmark)
+ */
+class CNullCVDevice: public CPlayerCVDevice {
+public:
+	uint16_t m_leds;
+	CNullCVDevice() {
+		m_leds = 0;
+	}
+	void open() {
+	}
+	void close() {
+	}
+	void writeLEDs(uint16_t data) {
+		m_leds = data;
+	}
+	bool keyPressed() {
+		return false;
+	}
+	string getStateStr() {
+		return "null device";
+	}
+	string getLastErrorStr() {
+		return "";
+	}
+};
+
+CBenchmark::CBenchmark(string tmpDir) {
+	m_tmpDir = tmpDir;
+}
+
+unsigned long CBenchmark::getNumAllocs() {
+	return s_numAllocs.load(memory_order_relaxed);
+}
+
+int CBenchmark::getNumResults() {
+	return m_results.size();
+}
+
+CBenchmark::RESULT CBenchmark::getResult(int i) {
+	return m_results.at(i);
+}
+
+void CBenchmark::run() {
+	m_results.clear();
+	s_countAllocs = true;
+	_benchFilter();
+	_benchAmpMeter();
+	_benchSpectrum();
+	_benchLoudness();
+	_benchWaveform();
+	_benchSoundFileRead();
+	_benchFilterFileRead();
+	s_countAllocs = false;
+}
+
+void CBenchmark::_synthesize(float *buf, int frames, int channels) {
+	unsigned int rnd = 12345;
+	for (int k = 0; k < frames; k++)
+		for (int c = 0; c < channels; c++) {
+			rnd = rnd * 1664525 + 1013904223;
+			buf[k * channels + c] = 0.5f * sin(2 * M_PI * (c + 1) * 441. * k / 44100.)
+					+ 0.01f * ((float) (rnd >> 8) / 16777216.f - 0.5f);
+		}
+}
+
+void CBenchmark::_measure(string name, string params, long samplesPerCall,
+		function<void()> func) {
+	func();						// warm up (caches, first allocations)
+
+	unsigned long calls = 0, batch = 1;
+	unsigned long allocs0 = getNumAllocs();
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	double dt = 0.;
+	// the clock is read once per batch, the batch grows until BENCH_MINTIME is reached
+	while (dt < BENCH_MINTIME) {
+		for (unsigned long i = 0; i < batch; i++)
+			func();
+		calls += batch;
+		batch *= 2;
+		dt = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	}
+	unsigned long allocs = getNumAllocs() - allocs0;
+
+	RESULT r;
+	r.name = name;
+	r.params = params;
+	r.samplesPerCall = samplesPerCall;
+	r.calls = calls;
+	r.nsPerSample = dt * 1e9 / ((double) calls * samplesPerCall);
+	r.samplesPerSec = (double) calls * samplesPerCall / dt;
+	r.allocsPerCall = (double) allocs / calls;
+	m_results.push_back(r);
+}
+
+void CBenchmark::_benchFilter() {
+	const int orders[] = { 2, 6, 12 }, channels[] = { 1, 2, 6 }, frames[] = { 64,
+			512, 4096 };
+	for (int o : orders)
+		for (int ch : channels)
+			for (int fr : frames) {
+				// stable test filter: moving average numerator, single pole at 0.5
+				float b[13], a[13];
+				for (int n = 0; n <= o; n++) {
+					b[n] = 1.f / (o + 1);
+					a[n] = 0.f;
+				}
+				a[0] = 1.f;
+				a[1] = -0.5f;
+				CFilter flt("benchmark", a, b, o, ch);
+				float *x = new float[fr * ch], *y = new float[fr * ch];
+				_synthesize(x, fr, ch);
+
+				_measure("CFilter::filter",
+						"order=" + to_string(o) + " ch=" + to_string(ch) + " frames="
+								+ to_string(fr), (long) fr * ch, [&]() {
+							flt.filter(x, y, fr);
+						});
+				delete[] x;
+				delete[] y;
+			}
+}
+
+void CBenchmark::_benchAmpMeter() {
+	const int sizes[] = { 256, 2048, 16384 };
+	CNullCVDevice dev;
+	CAmpMeter *pMeter = new CAmpMeter;	// large buffers, not on the stack
+	for (int mode = 0; mode < 2; mode++) {
+		CAmpMeter::SCALING_MODE scmode =
+				mode ? CAmpMeter::SCALING_MODE_LOG : CAmpMeter::SCALING_MODE_LIN;
+		pMeter->init(&dev, scmode, -1.f, 1.f, -60);
+		for (int n : sizes) {
+			float *x = new float[n];
+			_synthesize(x, n, 1);
+			string params = string(mode ? "scale=log" : "scale=lin") + " samples="
+					+ to_string(n);
+			_measure("CAmpMeter::write", params, n, [&]() {
+				pMeter->write(x, n);
+			});
+			delete[] x;
+		}
+	}
+
+	// kernels of the meter modes (independent of the scaling)
+	const char *modeNames[] = { "peak", "rms", "truepeak" };
+	const int channels[] = { 1, 2, 32 };
+	for (int m = 0; m < 3; m++) {
+		pMeter->setMeterMode((CAmpMeter::METER_MODE) m);
+		for (int ch : channels) {
+			int n = 16384;
+			float *x = new float[n];
+			_synthesize(x, n / ch, ch);
+			volatile float v;
+			_measure("CAmpMeter::_getValueFromBuffer",
+					string("mode=") + modeNames[m] + " channels=" + to_string(ch)
+							+ " samples=" + to_string(n), n, [&]() {
+						v = pMeter->_getValueFromBuffer(x, n, ch);
+					});
+			delete[] x;
+		}
+	}
+	pMeter->setMeterMode(CAmpMeter::METER_MODE_PEAK);
+
+	// LED writer in front of the device: unchanged patterns are skipped, a
+	// changed one wakes up the writer thread
+	CLEDWriter writer;
+	writer.start(&dev);
+	uint16_t pattern = 0x00ff;
+	_measure("CLEDWriter::writeLEDs", "pattern=unchanged", 1, [&]() {
+		writer.writeLEDs(pattern);
+	});
+	_measure("CLEDWriter::writeLEDs", "pattern=changed", 1, [&]() {
+		pattern ^= 0x0100;
+		writer.writeLEDs(pattern);
+	});
+	writer.stop();
+	delete pMeter;
+}
+
+void CBenchmark::_benchSpectrum() {
+	const int rates[] = { 44100, 96000 }, channels[] = { 2, 6 };
+	CSpectrumAnalyzer *pSpec = new CSpectrumAnalyzer;	// large ring, not on the stack
+	float bands[SPEC_NUMBANDS];
+
+	// audio path: downmix of a block into the ring
+	for (int ch : channels) {
+		int fr = 4096;
+		float *x = new float[fr * ch];
+		_synthesize(x, fr, ch);
+		_measure("CSpectrumAnalyzer::write", "ch=" + to_string(ch) + " frames="
+				+ to_string(fr), (long) fr * ch, [&]() {
+			pSpec->write(x, fr, ch);
+		});
+		delete[] x;
+	}
+
+	/*
+	 * visualizer: one analysis per refresh, counted per sample of a refresh
+	 * period, so the cost is comparable with CFilter::filter per sample
+	 */
+	float *x = new float[SPEC_RINGSIZE];
+	_synthesize(x, SPEC_RINGSIZE, 1);
+	unsigned long pos = pSpec->write(x, SPEC_RINGSIZE, 1);
+	for (int fs : rates) {
+		long samples = fs / VIS_REFRESHRATE;
+		_measure("CSpectrumAnalyzer::analyze", "fs=" + to_string(fs) + " fft="
+				+ to_string(CSpectrumAnalyzer::getFFTLength(fs)) + " refresh="
+				+ to_string((int) VIS_REFRESHRATE) + "Hz", samples, [&]() {
+			pSpec->analyze(pos, fs, bands);
+		});
+	}
+	delete[] x;
+	delete pSpec;
+}
+
+void CBenchmark::_benchLoudness() {
+	const int channels[] = { 1, 2, 6 };
+	CLoudnessMeter *pMeter = new CLoudnessMeter;	// true peak meter buffers, not on the stack
+	for (int ch : channels) {
+		int fr = 16384;
+		float *x = new float[fr * ch];
+		_synthesize(x, fr, ch);
+		pMeter->init(44100, ch);
+		_measure("CLoudnessMeter::analyze", "ch=" + to_string(ch) + " frames="
+				+ to_string(fr), (long) fr * ch, [&]() {
+			pMeter->analyze(x, fr);
+		});
+		_measure("CLoudnessMeter::applyGain", "ch=" + to_string(ch) + " frames="
+				+ to_string(fr), (long) fr * ch, [&]() {
+			CLoudnessMeter::applyGain(x, (long) fr * ch, 1.f);
+		});
+		delete[] x;
+	}
+	delete pMeter;
+}
+
+void CBenchmark::_benchWaveform() {
+	const int channels[] = { 1, 2, 6 };
+	CWaveformBuilder builder;
+	for (int ch : channels) {
+		int fr = 16384;
+		float *x = new float[fr * ch];
+		_synthesize(x, fr, ch);
+		_measure("CWaveformBuilder::analyze", "ch=" + to_string(ch) + " frames="
+				+ to_string(fr), (long) fr * ch, [&]() {
+			builder.init(ch);
+			builder.analyze(x, fr);
+			builder.finish();
+		});
+		delete[] x;
+	}
+
+	// pyramid of a synthetic 10 s stereo file, samples per call: parts of the query
+	const int fileFrames = 10 * 44100, parts = 1000;
+	string path = m_tmpDir + "benchmark_tmp.wav";
+	{
+		CSoundFile wfile(path, CSoundFile::FILE_WRITE);
+		wfile.setFormat(SF_FORMAT_WAV | SF_FORMAT_PCM_16);
+		wfile.setNumChannels(2);
+		wfile.setSampleRate(44100);
+		wfile.open();
+		float *sig = new float[fileFrames * 2];
+		_synthesize(sig, fileFrames, 2);
+		wfile.write(sig, fileFrames * 2);
+		wfile.close();
+		CSoundFile rfile(path, CSoundFile::FILE_READ);
+		rfile.open();
+		builder.init(2);
+		builder.analyze(sig, fileFrames);
+		builder.finish();
+		CWaveformFile(path + WAVE_EXT).write(builder, rfile);
+		delete[] sig;
+	}
+	CWaveformFile wave(path + WAVE_EXT);
+	if (!wave.open())
+		throw CException(CException::SRC_File, CFileBase::FILE_E_READ,
+				"Can't open the temporary waveform file " + path + WAVE_EXT);
+	const long ranges[] = { fileFrames, 44100, 4410 };
+	WAVEPEAK peaks[parts];
+	for (long range : ranges)
+		_measure("CWaveformFile::getPeaks", "parts=" + to_string(parts) + " range="
+				+ to_string(range), parts, [&]() {
+			wave.getPeaks(0, 0, range, peaks, parts);
+		});
+	wave.close();
+	remove((path + WAVE_EXT).c_str());
+	remove(path.c_str());
+}
+
+void CBenchmark::_benchSoundFileRead() {
+	const int channels[] = { 1, 2, 6 }, frames[] = { 256, 4096, 44100 };
+	const int fileFrames = 10 * 44100;
+	string path = m_tmpDir + "benchmark_tmp.wav";
+
+	for (int ch : channels) {
+		// synthetic 10 s 16 bit file
+		{
+			CSoundFile wfile(path, CSoundFile::FILE_WRITE);
+			wfile.setFormat(SF_FORMAT_WAV | SF_FORMAT_PCM_16);
+			wfile.setNumChannels(ch);
+			wfile.setSampleRate(44100);
+			wfile.open();
+			float *sig = new float[fileFrames * ch];
+			_synthesize(sig, fileFrames, ch);
+			wfile.write(sig, fileFrames * ch);
+			delete[] sig;
+			wfile.close();
+		}
+
+		CSoundFile rfile(path, CSoundFile::FILE_READ);
+		rfile.open();
+		for (int fr : frames) {
+			float *buf = new float[fr * ch];
+			_measure("CSoundFile::read", "ch=" + to_string(ch) + " frames=" + to_string(fr),
+					(long) fr * ch, [&]() {
+						if (rfile.read(buf, fr * ch) < fr * ch)
+							rfile.rewind();		// start again at the end of the file
+					});
+			delete[] buf;
+		}
+		rfile.close();
+	}
+	remove(path.c_str());
+}
+
+void CBenchmark::_benchFilterFileRead() {
+	const int orders[] = { 2, 6, 12 };
+	const int rates[] = { 8000, 16000, 22050, 32000, 44100, 48000, 96000 };
+	string path = m_tmpDir + "benchmark_tmp.txt";
+
+	for (int o : orders) {
+		// one coefficient set per sample rate, the last one is read (worst case)
+		FILE *pF = fopen(path.c_str(), "w");
+		if (pF == NULL)
+			throw CException(CException::SRC_File, CFileBase::FILE_E_CANTWRITE,
+					"Can't write the temporary filter file " + path);
+		fprintf(pF, "lowpass;%d;benchmark filter\n", o);
+		for (int fs : rates) {
+			fprintf(pF, "%d\n", fs);
+			for (int n = 0; n <= o; n++)
+				fprintf(pF, "%.9f%c", 1.f / (o + 1), (n < o) ? '\t' : '\n');
+			for (int n = 0; n <= o; n++)
+				fprintf(pF, "%.9f%c", (n == 0) ? 1.f : (n == 1) ? -0.5f : 0.f,
+						(n < o) ? '\t' : '\n');
+		}
+		fclose(pF);
+
+		// samples per call: number of coefficients read
+		_measure("CFilterFile::read", "order=" + to_string(o) + " rates="
+				+ to_string(sizeof(rates) / sizeof(rates[0])), 2 * (o + 1), [&]() {
+			CFilterFile fltfile(path, CFilterFile::FILE_READ);
+			fltfile.open();
+			fltfile.read(96000);
+		});
+	}
+	remove(path.c_str());
+}
+
+string CBenchmark::getResultStr() {
+	string str;
+	char buf[256];
+	for (unsigned int i = 0; i < m_results.size(); i++) {
+		RESULT &r = m_results[i];
+		snprintf(buf, sizeof(buf), "%-32s %-28s %10.3f ns/sample %12.0f samples/s",
+				r.name.c_str(), r.params.c_str(), r.nsPerSample, r.samplesPerSec);
+		str += buf;
+		snprintf(buf, sizeof(buf), " %6.2f allocs/call\n", r.allocsPerCall);
+		str += buf;
+	}
+	return str;
+}
+
+string CBenchmark::getJSON() {
+	string str = "{\n  \"benchmarks\": [\n";
+	char buf[512];
+	for (unsigned int i = 0; i < m_results.size(); i++) {
+		RESULT &r = m_results[i];
+		snprintf(buf, sizeof(buf),
+				"    {\"name\": \"%s\", \"params\": \"%s\", \"samples_per_call\": %ld, "
+						"\"calls\": %lu, \"ns_per_sample\": %.4f, \"samples_per_sec\": %.1f, "
+						"\"allocs_per_call\": %.3f}%s\n", r.name.c_str(), r.params.c_str(),
+				r.samplesPerCall, r.calls, r.nsPerSample, r.samplesPerSec,
+				r.allocsPerCall, (i + 1 < m_results.size()) ? "," : "");
+		str += buf;
+	}
+	return str + "  ]\n}\n";
+}
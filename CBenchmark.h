@@ -0,0 +1,103 @@
+#ifndef CBENCHMARK_H_
+#define CBENCHMARK_H_
+
+#include <string>
+#include <deque>
+#include <functional>
+using namespace std;
+
+/**
+ * minimum measuring time per benchmark case [s]
+ */
+#define BENCH_MINTIME 0.2
+
+/**
+ * \brief micro benchmarks of the processing hot paths
+ *
+ * measures CFilter::filter, CAmpMeter::write/_getValueFromBuffer, the LED
+ * writer, the spectrum analyzer, the loudness meter, CSoundFile::read and CFilterFile::read in isolation with synthetic
+ * signals and files, for several filter orders, block sizes and channel counts.
+ *
+ * each case is repeated until BENCH_MINTIME has elapsed (after one warm up call).
+ * Heap allocations are counted by a replaced global operator new while run()
+ * executes, so the allocations of C libraries (e.g. libsndfile's malloc) are
+ * not included.
+ */
+class CBenchmark {
+public:
+	/**
+	 * \brief result of a benchmark case
+	 */
+	struct RESULT {
+		string name;			// function measured
+		string params;			// parameters of the case (e.g. "order=6 ch=2 frames=512")
+		long samplesPerCall;	// samples processed per call
+		unsigned long calls;	// number of measured calls
+		double nsPerSample;
+		double samplesPerSec;
+		double allocsPerCall;	// operator new calls
+	};
+
+private:
+	deque<RESULT> m_results;
+	/**
+	 * directory for the temporary sound and filter files
+	 */
+	string m_tmpDir;
+
+public:
+	/**
+	 * \param tmpDir [in] directory for the temporary files (with trailing separator or empty)
+	 */
+	CBenchmark(string tmpDir = "");
+
+	/**
+	 * \brief runs all benchmark cases (previous results are cleared)
+	 */
+	void run();
+
+	int getNumResults();
+	RESULT getResult(int i);
+
+	/**
+	 * \return results as text table
+	 */
+	string getResultStr();
+
+	/**
+	 * \return results as JSON document (machine readable, for regression checks)
+	 */
+	string getJSON();
+
+	/**
+	 * \return number of heap allocations by operator new while benchmarks ran
+	 */
+	static unsigned long getNumAllocs();
+
+private:
+	void _benchFilter();
+	void _benchAmpMeter();
+	void _benchSpectrum();
+	void _benchLoudness();
+	void _benchWaveform();
+	void _benchSoundFileRead();
+	void _benchFilterFileRead();
+
+	/**
+	 * \brief measures a function and appends the result
+	 *
+	 * \param name [in] name of the measured function
+	 * \param params [in] parameters of the case
+	 * \param samplesPerCall [in] number of samples processed by one call of func
+	 * \param func [in] function to be measured
+	 */
+	void _measure(string name, string params, long samplesPerCall,
+			function<void()> func);
+
+	/**
+	 * \brief fills a buffer with an interleaved test signal (one sine per channel plus noise)
+	 */
+	static void _synthesize(float *buf, int frames, int channels);
+};
+
+#endif /* CBENCHMARK_H_ */
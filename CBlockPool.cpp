@@ -0,0 +1,132 @@
+#include <new>
+#include <stdint.h>
+#include <SKSLib.h>
+#include "CBlockPool.h"
+
+CBlockPool::CBlockPool() {
+	static_assert(sizeof(POOLBLOCK) <= POOL_ALIGN, "pool header too large");
+	for (int c = 0; c < POOL_NUMCLASSES; c++)
+		m_free[c] = NULL;
+	m_all = NULL;
+	m_numAllocs = 0;
+	m_numAcquires = 0;
+	pthread_mutex_init(&m_mut, 0);
+}
+
+CBlockPool::~CBlockPool() {
+	while (m_all) {
+		POOLBLOCK *pB = m_all;
+		m_all = pB->pAllNext;
+		char *pMem = pB->pMem;
+		pB->~POOLBLOCK();
+		delete[] pMem;
+	}
+	pthread_mutex_destroy(&m_mut);
+}
+
+int CBlockPool::_getSizeClass(int samples) {
+	if (samples <= 0)
+		throw CException(CException::SRC_Filter, POOL_E_SIZE, "Invalid buffer size.");
+	int c = 0;
+	while ((c < POOL_NUMCLASSES) && ((POOL_MINSIZE << c) < samples))
+		c++;
+	if (c == POOL_NUMCLASSES)
+		throw CException(CException::SRC_Filter, POOL_E_SIZE,
+				"Buffer size exceeds the largest size class of the pool.");
+	return c;
+}
+
+CBlockPool::POOLBLOCK* CBlockPool::_allocate(int sizeClass) {
+	size_t bytes = (size_t) (POOL_MINSIZE << sizeClass) * sizeof(float);
+	// header and samples follow the first aligned address
+	char *pMem = new (nothrow) char[2 * POOL_ALIGN + bytes];
+	if (pMem == NULL)
+		throw CException(CException::SRC_Filter, POOL_E_NOMEM,
+				"Not enough memory for the block pool.");
+	uintptr_t a = ((uintptr_t) pMem + POOL_ALIGN - 1) & ~(uintptr_t) (POOL_ALIGN - 1);
+	POOLBLOCK *pB = new ((void*) a) POOLBLOCK;
+	pB->refs = 0;
+	pB->sizeClass = sizeClass;
+	pB->pMem = pMem;
+	pB->pNext = NULL;
+	pB->pAllNext = m_all;
+	m_all = pB;
+	m_numAllocs++;
+	return pB;
+}
+
+CBlockPool::POOLBLOCK* CBlockPool::_getBlock(float *pBuf) {
+	if (pBuf == NULL)
+		throw CException(CException::SRC_Filter, POOL_E_NOBLOCK, "No buffer.");
+	return (POOLBLOCK*) ((char*) pBuf - POOL_ALIGN);
+}
+
+void CBlockPool::reserve(int samples, int count) {
+	int c = _getSizeClass(samples);
+	pthread_mutex_lock(&m_mut);
+	try {
+		int n = 0;
+		for (POOLBLOCK *pB = m_free[c]; pB; pB = pB->pNext)
+			n++;
+		for (; n < count; n++) {
+			POOLBLOCK *pB = _allocate(c);
+			pB->pNext = m_free[c];
+			m_free[c] = pB;
+		}
+	} catch (CException &e) {
+		pthread_mutex_unlock(&m_mut);
+		throw;
+	}
+	pthread_mutex_unlock(&m_mut);
+}
+
+float* CBlockPool::acquire(int samples) {
+	int c = _getSizeClass(samples);
+	pthread_mutex_lock(&m_mut);
+	POOLBLOCK *pB = m_free[c];
+	if (pB) {
+		m_free[c] = pB->pNext;
+	} else {
+		try {
+			pB = _allocate(c);
+		} catch (CException &e) {
+			pthread_mutex_unlock(&m_mut);
+			throw;
+		}
+	}
+	m_numAcquires++;
+	pthread_mutex_unlock(&m_mut);
+
+	pB->pNext = NULL;
+	pB->refs.store(1, memory_order_relaxed);
+	return (float*) ((char*) pB + POOL_ALIGN);
+}
+
+void CBlockPool::addRef(float *pBuf) {
+	_getBlock(pBuf)->refs.fetch_add(1, memory_order_relaxed);
+}
+
+void CBlockPool::release(float *pBuf) {
+	if (pBuf == NULL)
+		return;
+	POOLBLOCK *pB = _getBlock(pBuf);
+	// the last user returns the buffer (acq_rel: its writes happen before the reuse)
+	if (pB->refs.fetch_sub(1, memory_order_acq_rel) != 1)
+		return;
+	pthread_mutex_lock(&m_mut);
+	pB->pNext = m_free[pB->sizeClass];
+	m_free[pB->sizeClass] = pB;
+	pthread_mutex_unlock(&m_mut);
+}
+
+int CBlockPool::getCapacity(float *pBuf) {
+	return POOL_MINSIZE << _getBlock(pBuf)->sizeClass;
+}
+
+unsigned long CBlockPool::getNumAllocs() {
+	return m_numAllocs;
+}
+
+unsigned long CBlockPool::getNumAcquires() {
+	return m_numAcquires;
+}
@@ -0,0 +1,125 @@
+#ifndef CBLOCKPOOL_H_
+#define CBLOCKPOOL_H_
+
+#include <atomic>
+#include <pthread.h>
+using namespace std;
+
+/**
+ * alignment of the sample buffers in bytes (cache line, sufficient for SSE/AVX loads)
+ */
+#define POOL_ALIGN 64
+/**
+ * smallest size class in samples (size classes are powers of 2)
+ */
+#define POOL_MINSIZE 1024
+/**
+ * number of size classes (largest class: POOL_MINSIZE << (POOL_NUMCLASSES-1) samples)
+ */
+#define POOL_NUMCLASSES 12
+
+/**
+ * \brief pool of aligned, reference counted sample buffers
+ *
+ * buffers are grouped in power of 2 size classes. A released buffer goes back to the
+ * free list of its class and is handed out again by the next acquire() of that class,
+ * so after reserve() (or after the first playback) no heap allocation is needed while
+ * audio is processed.
+ *
+ * acquire() returns a plain float pointer (64 byte aligned), the management data is
+ * stored in front of the samples. A buffer can be shared by several users with
+ * addRef(), it returns to the pool when the last user calls release().
+ */
+class CBlockPool {
+public:
+	enum POOL_ERROR {
+		POOL_E_SIZE, POOL_E_NOMEM, POOL_E_NOBLOCK
+	};
+
+private:
+	/**
+	 * management data of a buffer, located in the POOL_ALIGN bytes before the samples
+	 */
+	struct POOLBLOCK {
+		atomic<int> refs;
+		int sizeClass;
+		char *pMem;			// start of the allocated memory
+		POOLBLOCK *pNext;	// next free block of the same class
+		POOLBLOCK *pAllNext;	// next allocated block (for the destructor)
+	};
+
+	POOLBLOCK *m_free[POOL_NUMCLASSES];
+	POOLBLOCK *m_all;
+	pthread_mutex_t m_mut;
+
+	/**
+	 * number of heap allocations and of buffers handed out
+	 */
+	unsigned long m_numAllocs;
+	unsigned long m_numAcquires;
+
+public:
+	CBlockPool();
+	~CBlockPool();
+
+	/**
+	 * \brief preallocates buffers (usually at startup)
+	 * \param samples [in] minimum size of the buffers in samples
+	 * \param count [in] number of free buffers of this size after the call
+	 */
+	void reserve(int samples, int count);
+
+	/**
+	 * \brief hands out a buffer with a reference count of 1
+	 *
+	 * a buffer is only allocated if the free list of the size class is empty
+	 *
+	 * \param samples [in] minimum size of the buffer in samples
+	 * \return buffer aligned to POOL_ALIGN bytes (uninitialized)
+	 */
+	float* acquire(int samples);
+
+	/**
+	 * \brief adds a user of a buffer
+	 */
+	void addRef(float *pBuf);
+
+	/**
+	 * \brief removes a user of a buffer, the last user returns it to the pool
+	 * \param pBuf [in] buffer from acquire() or NULL
+	 */
+	void release(float *pBuf);
+
+	/**
+	 * \return capacity of a buffer in samples
+	 */
+	int getCapacity(float *pBuf);
+
+	/**
+	 * \return number of heap allocations since the construction
+	 */
+	unsigned long getNumAllocs();
+
+	/**
+	 * \return number of buffers handed out since the construction
+	 */
+	unsigned long getNumAcquires();
+
+private:
+	/**
+	 * \return size class of the given number of samples
+	 */
+	int _getSizeClass(int samples);
+
+	/**
+	 * \brief allocates a buffer of the given size class (m_mut locked by the caller)
+	 */
+	POOLBLOCK* _allocate(int sizeClass);
+
+	/**
+	 * \return management data of a buffer
+	 */
+	POOLBLOCK* _getBlock(float *pBuf);
+};
+
+#endif /* CBLOCKPOOL_H_ */
@@ -0,0 +1,77 @@
+#include <time.h>
+#include <stddef.h>
+#include "CBlockQueue.h"
+
+CBlockQueue::CBlockQueue(unsigned int capacity) {
+	// the ring size is rounded up to a power of 2 (index masking)
+	m_size = 1;
+	while (m_size < capacity)
+		m_size <<= 1;
+	m_ring = new AUDIOBLOCK*[m_size];
+	m_head = 0;
+	m_tail = 0;
+	m_waiting = false;
+	pthread_mutex_init(&m_mut, 0);
+	pthread_cond_init(&m_cond, 0);
+}
+
+CBlockQueue::~CBlockQueue() {
+	pthread_mutex_destroy(&m_mut);
+	pthread_cond_destroy(&m_cond);
+	delete[] m_ring;
+}
+
+bool CBlockQueue::push(AUDIOBLOCK *pBlock) {
+	unsigned int tail = m_tail.load(memory_order_relaxed);
+	if (tail - m_head.load(memory_order_acquire) >= m_size)
+		return false;					// full
+	m_ring[tail & (m_size - 1)] = pBlock;
+	m_tail.store(tail + 1, memory_order_seq_cst);
+
+	// wake up the consumer only if it is sleeping
+	if (m_waiting.load(memory_order_seq_cst)) {
+		pthread_mutex_lock(&m_mut);
+		pthread_cond_signal(&m_cond);
+		pthread_mutex_unlock(&m_mut);
+	}
+	return true;
+}
+
+AUDIOBLOCK* CBlockQueue::pop() {
+	unsigned int head = m_head.load(memory_order_relaxed);
+	if (head == m_tail.load(memory_order_acquire))
+		return NULL;					// empty
+	AUDIOBLOCK *pBlock = m_ring[head & (m_size - 1)];
+	m_head.store(head + 1, memory_order_release);
+	return pBlock;
+}
+
+AUDIOBLOCK* CBlockQueue::waitPop(int timeout_ms) {
+	AUDIOBLOCK *pBlock = pop();
+	if (pBlock)
+		return pBlock;
+
+	pthread_mutex_lock(&m_mut);
+	m_waiting.store(true, memory_order_seq_cst);
+	// a block pushed before m_waiting was set is found here
+	pBlock = pop();
+	if (pBlock == NULL) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += timeout_ms / 1000;
+		ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&m_cond, &m_mut, &ts); // wait unlocks at entrance and re-locks at the end
+		pBlock = pop();
+	}
+	m_waiting.store(false, memory_order_relaxed);
+	pthread_mutex_unlock(&m_mut);
+	return pBlock;
+}
+
+unsigned int CBlockQueue::size() {
+	return m_tail.load(memory_order_acquire) - m_head.load(memory_order_acquire);
+}
@@ -0,0 +1,101 @@
+#ifndef CBLOCKQUEUE_H_
+#define CBLOCKQUEUE_H_
+
+#include <atomic>
+#include <pthread.h>
+using namespace std;
+
+/**
+ * \brief block of interleaved audio frames passed between the stages of the playback pipeline
+ */
+struct AUDIOBLOCK {
+	/**
+	 * samples of the block
+	 */
+	float *pData;
+	/**
+	 * second buffer for stages that can't work in place (swapped with pData)
+	 */
+	float *pWork;
+	/**
+	 * capacity of both buffers in frames
+	 */
+	int capacity;
+	/**
+	 * number of valid frames in pData
+	 */
+	int frames;
+	/**
+	 * true for the last block of a signal
+	 */
+	bool last;
+	/**
+	 * seek generation of the samples (the output discards blocks decoded before a seek)
+	 */
+	unsigned int epoch;
+	/**
+	 * number of frames read and processing time of the decode and DSP stages [s]
+	 */
+	long inFrames;
+	double cost;
+};
+
+/**
+ * \brief bounded lock-free queue of audio blocks for one producer and one consumer thread
+ *
+ * push() and pop() never block. waitPop() lets the consumer sleep on a condition
+ * while the queue is empty; the producer only takes the mutex to wake up a
+ * sleeping consumer.
+ */
+class CBlockQueue {
+private:
+	/**
+	 * ring buffer of m_size block pointers (m_size is a power of 2)
+	 */
+	AUDIOBLOCK **m_ring;
+	unsigned int m_size;
+	/**
+	 * read position (consumer) and write position (producer)
+	 */
+	atomic<unsigned int> m_head;
+	atomic<unsigned int> m_tail;
+	/**
+	 * wakeup of a waiting consumer
+	 */
+	pthread_mutex_t m_mut;
+	pthread_cond_t m_cond;
+	atomic<bool> m_waiting;
+
+public:
+	/**
+	 * \param capacity [in] maximum number of blocks in the queue
+	 */
+	CBlockQueue(unsigned int capacity);
+	~CBlockQueue();
+
+	/**
+	 * \brief appends a block (producer)
+	 * \return false if the queue is full
+	 */
+	bool push(AUDIOBLOCK *pBlock);
+
+	/**
+	 * \brief removes the oldest block (consumer)
+	 * \return block or NULL if the queue is empty
+	 */
+	AUDIOBLOCK* pop();
+
+	/**
+	 * \brief removes the oldest block, waits if the queue is empty (consumer)
+	 * \param timeout_ms [in] maximum waiting time in milliseconds
+	 * \return block or NULL if the queue is still empty after the timeout
+	 */
+	AUDIOBLOCK* waitPop(int timeout_ms);
+
+	/**
+	 * \return number of blocks in the queue
+	 */
+	unsigned int size();
+};
+
+#endif /* CBLOCKQUEUE_H_ */
@@ -0,0 +1,154 @@
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "CException.h"
+#include "CBlockSizer.h"
+
+/**
+ * frames of the two probe blocks and number of repetitions (the fastest one counts)
+ */
+#define SIZER_PROBE1 256
+#define SIZER_PROBE2 4096
+#define SIZER_PROBEREPS 3
+/**
+ * adaptation of the cost per frame to rising and falling measurements
+ */
+#define SIZER_ALPHA_UP 0.5
+#define SIZER_ALPHA_DOWN 0.05
+
+CBlockSizer::CBlockSizer(double latencyTarget, double margin, double minDur,
+		double maxDur) {
+	m_latencyTarget = latencyTarget;
+	m_margin = (margin < 1.) ? 1. : margin;
+	m_minDur = minDur;
+	m_maxDur = (maxDur < minDur) ? minDur : maxDur;
+	m_overhead = 0.;
+	m_costPerFrame = 0.;
+	m_numMeasurements = 0;
+}
+
+void CBlockSizer::setLatencyTarget(double latencyTarget) {
+	m_latencyTarget = latencyTarget;
+}
+
+double CBlockSizer::getLatencyTarget() {
+	return m_latencyTarget;
+}
+
+void CBlockSizer::calibrate(CSoundFile *pSFile, CFilterBase *pFilter) {
+	int numChan = pSFile ? pSFile->getNumChannels() : 1;
+	float *in = new float[numChan * SIZER_PROBE2];
+	float *out = new float[numChan * SIZER_PROBE2];
+	memset(in, 0, numChan * SIZER_PROBE2 * sizeof(float));
+
+	const long probes[2] = { SIZER_PROBE1, SIZER_PROBE2 };
+	double cost[2];
+	try {
+		for (int p = 0; p < 2; p++) {
+			cost[p] = -1.;
+			for (int r = 0; r < SIZER_PROBEREPS; r++) {
+				chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+				if (pSFile)
+					pSFile->read(out, numChan * probes[p]);
+				if (pFilter)
+					pFilter->filter(in, out, probes[p]);	// silence
+				double dt = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+				if (pSFile)
+					pSFile->rewind();
+				if ((cost[p] < 0.) || (dt < cost[p]))
+					cost[p] = dt;
+			}
+		}
+	} catch (CException &e) {
+		delete[] in;
+		delete[] out;
+		throw;
+	}
+	delete[] in;
+	delete[] out;
+
+	m_costPerFrame = (cost[1] - cost[0]) / (probes[1] - probes[0]);
+	if (m_costPerFrame < 0.)
+		m_costPerFrame = cost[1] / probes[1];
+	m_overhead = cost[0] - m_costPerFrame * probes[0];
+	if (m_overhead < 0.)
+		m_overhead = 0.;
+	m_numMeasurements = 0;
+}
+
+void CBlockSizer::addMeasurement(long frames, double cost) {
+	if (frames <= 0)
+		return;
+	double c = (cost - m_overhead) / frames;
+	if (c < 0.)
+		c = 0.;
+	// conservative: a slower block is taken into account at once, a faster one slowly
+	double alpha = (c > m_costPerFrame) ? SIZER_ALPHA_UP : SIZER_ALPHA_DOWN;
+	m_costPerFrame += alpha * (c - m_costPerFrame);
+	m_numMeasurements++;
+}
+
+void CBlockSizer::_getBounds(int fs, long &nRealtime, long &nLatency) {
+	double T = 1. / fs;
+	double o = m_margin * m_overhead;
+	double c = m_margin * m_costPerFrame;
+
+	// real time: o + c * N <= N * T
+	nRealtime = getMaxFramesPerBlock(fs);
+	if ((c < T) && (o / (T - c) < nRealtime))
+		nRealtime = ceil(o / (T - c));
+
+	// latency: N * T + o + c * N <= target
+	if (m_latencyTarget > o)
+		nLatency = floor((m_latencyTarget - o) / (T + c));
+	else
+		nLatency = 0;
+}
+
+long CBlockSizer::getFramesPerBlock(int fs) {
+	long nRealtime, nLatency;
+	_getBounds(fs, nRealtime, nLatency);
+	// the real time bound is rounded up, the latency bound down
+	nRealtime = ((nRealtime + SIZER_GRANULE - 1) / SIZER_GRANULE) * SIZER_GRANULE;
+	nLatency = (nLatency / SIZER_GRANULE) * SIZER_GRANULE;
+	long n = (nRealtime > nLatency) ? nRealtime : nLatency;
+
+	long nMin = ((long) (m_minDur * fs) + SIZER_GRANULE - 1) / SIZER_GRANULE * SIZER_GRANULE;
+	long nMax = getMaxFramesPerBlock(fs);
+	if (n < nMin)
+		n = nMin;
+	if (n > nMax)
+		n = nMax;
+	return n;
+}
+
+long CBlockSizer::getMaxFramesPerBlock(int fs) {
+	long nMax = (long) (m_maxDur * fs) / SIZER_GRANULE * SIZER_GRANULE;
+	return (nMax < SIZER_GRANULE) ? SIZER_GRANULE : nMax;
+}
+
+bool CBlockSizer::isTargetMet(int fs) {
+	long nRealtime, nLatency;
+	_getBounds(fs, nRealtime, nLatency);
+	return nRealtime <= nLatency;
+}
+
+double CBlockSizer::getOverhead() {
+	return m_overhead;
+}
+
+double CBlockSizer::getCostPerFrame() {
+	return m_costPerFrame;
+}
+
+string CBlockSizer::getStateStr(int fs) {
+	long n = getFramesPerBlock(fs);
+	char buf[256];
+	snprintf(buf, sizeof(buf),
+			"block size %ld frames (%.1f ms), cost %.3f us + %.4f us/frame, "
+					"latency target %.1f ms %s\n", n, n * 1e3 / fs, m_overhead * 1e6,
+			m_costPerFrame * 1e6, m_latencyTarget * 1e3,
+			isTargetMet(fs) ? "met" : "not met (real time needs larger blocks)");
+	return buf;
+}
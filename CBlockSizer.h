@@ -0,0 +1,118 @@
+#ifndef CBLOCKSIZER_H_
+#define CBLOCKSIZER_H_
+
+#include <string>
+using namespace std;
+
+#include "CFile.h"
+#include "CFilter.h"
+
+/**
+ * default latency target [s], safety margin (factor on the processing time) and
+ * bounds of the block duration [s]
+ */
+#define SIZER_LATENCY 0.125
+#define SIZER_MARGIN 2.0
+#define SIZER_MINDUR 0.01
+#define SIZER_MAXDUR 1.0
+/**
+ * block sizes are multiples of this number of frames
+ */
+#define SIZER_GRANULE 64
+
+/**
+ * \brief chooses the block size of a playback from the measured processing cost
+ *
+ * The processing time of a block (read, resample, filter) is modelled as
+ *
+ *     cost(N) = overhead + costPerFrame * N		(N frames per block)
+ *
+ * calibrate() measures both values at startup with two probe sizes, during
+ * playback addMeasurement() adapts the cost per frame (fast if it rises,
+ * slowly if it falls).
+ *
+ * The block size is the largest one whose latency (block duration plus
+ * processing time times the margin) stays within the latency target, but at
+ * least the smallest one that can be processed in real time with the margin.
+ * If the latter is larger, the target can't be met (heavy filter) and the
+ * real time constraint wins. Both are limited to the duration bounds.
+ */
+class CBlockSizer {
+private:
+	double m_latencyTarget;
+	double m_margin;
+	double m_minDur;
+	double m_maxDur;
+
+	/**
+	 * cost model [s] and [s/frame]
+	 */
+	double m_overhead;
+	double m_costPerFrame;
+	unsigned long m_numMeasurements;
+
+public:
+	/**
+	 * \param latencyTarget [in] maximum latency of a block [s]
+	 * \param margin [in] safety factor on the processing time (>= 1)
+	 * \param minDur [in] minimum block duration [s]
+	 * \param maxDur [in] maximum block duration [s]
+	 */
+	CBlockSizer(double latencyTarget = SIZER_LATENCY, double margin = SIZER_MARGIN,
+			double minDur = SIZER_MINDUR, double maxDur = SIZER_MAXDUR);
+
+	void setLatencyTarget(double latencyTarget);
+	double getLatencyTarget();
+
+	/**
+	 * \brief measures the cost model for a sound file and a filter
+	 *
+	 * reads probe blocks from the sound file (rewound afterwards) and filters
+	 * silence, so the state of a fresh filter isn't changed.
+	 *
+	 * \param pSFile [in] open sound file or NULL
+	 * \param pFilter [in] filter or NULL
+	 */
+	void calibrate(CSoundFile *pSFile, CFilterBase *pFilter);
+
+	/**
+	 * \brief adapts the cost model to the measured processing time of a block
+	 * \param frames [in] number of frames of the block
+	 * \param cost [in] processing time [s]
+	 */
+	void addMeasurement(long frames, double cost);
+
+	/**
+	 * \param fs [in] sample rate of the blocks
+	 * \return number of frames per block
+	 */
+	long getFramesPerBlock(int fs);
+
+	/**
+	 * \param fs [in] sample rate of the blocks
+	 * \return maximum number of frames per block
+	 */
+	long getMaxFramesPerBlock(int fs);
+
+	/**
+	 * \param fs [in] sample rate of the blocks
+	 * \return false if the real time constraint needs a block longer than the latency target
+	 */
+	bool isTargetMet(int fs);
+
+	double getOverhead();
+	double getCostPerFrame();
+
+	/**
+	 * \return block size and cost model as text
+	 */
+	string getStateStr(int fs);
+
+private:
+	/**
+	 * \brief smallest block that can be processed in real time and largest block within the latency target
+	 */
+	void _getBounds(int fs, long &nRealtime, long &nLatency);
+};
+
+#endif /* CBLOCKSIZER_H_ */
@@ -1,22 +1,55 @@
 #include <iostream>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
 using namespace std;
 
 #include "CConsoleThread.h"
 
+/**
+ * maximum time for a thread to start [ms]
+ */
+#define CONSOLE_STARTTIMEOUT_MS 5000
+/**
+ * flag of a LED pattern that hasn't been printed yet
+ */
+#define CONSOLE_LEDPENDING 0x10000
+
+/**
+ * \brief absolute time for pthread_cond_timedwait
+ */
+static void getDeadline(struct timespec &ts, int timeout_ms) {
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+}
+
 CConsoleThread::CConsoleThread() {
 	m_outThreadHandle = pthread_t { }; // initializes a struct with 0
 	m_outMut = PTHREAD_MUTEX_INITIALIZER;
 	m_outCond = PTHREAD_COND_INITIALIZER;
-	m_outTextChanged = false;
+	m_outWaiting = false;
+	m_outMsgs = NULL;
+	m_outLEDs = 0;
 
 	// keyboard monitoring thread
 	m_inThreadHandle = pthread_t { };
 	m_inMut = PTHREAD_MUTEX_INITIALIZER;
 	m_inCond = PTHREAD_COND_INITIALIZER;
 	m_inTextChanged = false;
+	m_pTransport = NULL;
+	m_pFilter = NULL;
+	m_filterOn = false;
 
 	m_lastError = E_OK;
 	m_state = S_NOTREADY;
+	m_stateMut = PTHREAD_MUTEX_INITIALIZER;
+	m_stateCond = PTHREAD_COND_INITIALIZER;
 }
 
 /*
@@ -40,7 +73,7 @@ void CConsoleThread::open() {
 		return;
 
 	// set device state to ready
-	m_state = S_STARTING;
+	_setState(S_STARTING);
 
 	// binary pattern output
 	pthread_mutex_init(&m_outMut, 0);
@@ -58,12 +91,19 @@ void CConsoleThread::open() {
 		throw(CException(CException::SRC_IOConsole, getLastError(),
 				getLastErrorStr()));
 	}
-	// busy waiting
-	while (m_state != S_READY)
-		;
+	// the thread signals that it is up
+	if (!_waitForState(S_READY, CONSOLE_STARTTIMEOUT_MS)) {
+		m_lastError = E_BPTHREADFAILED;
+		_setState(S_NOTREADY);				// terminates the thread when it comes up
+		pthread_mutex_lock(&m_outMut);
+		pthread_cond_signal(&m_outCond);
+		pthread_mutex_unlock(&m_outMut);
+		throw(CException(CException::SRC_IOConsole, getLastError(),
+				getLastErrorStr()));
+	}
 
 	// keyboard monitoring
-	m_state = S_STARTING;
+	_setState(S_STARTING);
 	pthread_mutex_init(&m_inMut, 0);
 	pthread_cond_init(&m_inCond, 0);
 	rc = pthread_create(&m_inThreadHandle, NULL, inThreadHandler, (void*) this);
@@ -81,9 +121,13 @@ void CConsoleThread::open() {
 				getLastErrorStr()));
 	}
 
-	// busy waiting
-	while (m_state != S_READY)
-		;
+	// the thread signals that it is up
+	if (!_waitForState(S_READY, CONSOLE_STARTTIMEOUT_MS)) {
+		m_lastError = E_KBTHREADFAILED;
+		close();
+		throw(CException(CException::SRC_IOConsole, getLastError(),
+				getLastErrorStr()));
+	}
 
 	// set error to ok
 	m_lastError = E_OK;
@@ -97,13 +141,14 @@ void CConsoleThread::close() {
 	// terminate both keyboard monitoring thread
 	pthread_kill(m_inThreadHandle, 0);// kills the kb thread while it is waiting for an user input (signal number always 0 for windows)
 
-	m_state = S_NOTREADY;			// will cause the thread to terminate
+	_setState(S_NOTREADY);			// will cause the thread to terminate
 
 	pthread_mutex_lock(&m_outMut);
 	pthread_cond_signal(&m_outCond);	// wake-up the bp thread to terminate
 	pthread_mutex_unlock(&m_outMut);
 
 	pthread_join(m_outThreadHandle, NULL); // waits for the bp thread to be terminated (no return value needed)
+	_takeOutput();						// releases texts written after the last batch
 	pthread_mutex_destroy(&m_outMut);
 	pthread_cond_destroy(&m_outCond);
 	pthread_mutex_destroy(&m_inMut);
@@ -118,14 +163,55 @@ bool CConsoleThread::enterPressed() {
 	}
 
 	// the attribute is set by the thread, a detected key press is cleared once it has been read
-	if (m_inTextChanged == true) {
-		pthread_mutex_lock(&m_inMut);
-		m_inTextChanged = false;
-		pthread_mutex_unlock(&m_inMut);
-		return true;
-	} else {
-		return false;
+	pthread_mutex_lock(&m_inMut);
+	bool pressed = m_inTextChanged;
+	m_inTextChanged = false;
+	pthread_mutex_unlock(&m_inMut);
+	return pressed;
+}
+
+bool CConsoleThread::waitEnterPressed(int timeout_ms) {
+	if (m_state != S_READY) {
+		m_lastError = E_KBTHREADNOTREADY;
+		throw(CException(CException::SRC_IOConsole, getLastError(),
+				getLastErrorStr()));
+	}
+
+	struct timespec ts;
+	getDeadline(ts, (timeout_ms < 0) ? 0 : timeout_ms);
+	pthread_mutex_lock(&m_inMut);
+	while ((m_state == S_READY) && (m_inTextChanged == false)) {
+		// wait unlocks at entrance and re-locks at the end
+		if (timeout_ms < 0)
+			pthread_cond_wait(&m_inCond, &m_inMut);
+		else if (pthread_cond_timedwait(&m_inCond, &m_inMut, &ts) != 0)
+			break;
+	}
+	bool pressed = m_inTextChanged;
+	m_inTextChanged = false;
+	pthread_mutex_unlock(&m_inMut);
+	return pressed;
+}
+
+void CConsoleThread::_setState(STATES state) {
+	pthread_mutex_lock(&m_stateMut);
+	m_state = state;
+	pthread_cond_broadcast(&m_stateCond);
+	pthread_mutex_unlock(&m_stateMut);
+}
+
+bool CConsoleThread::_waitForState(STATES state, int timeout_ms) {
+	struct timespec ts;
+	getDeadline(ts, timeout_ms);
+	pthread_mutex_lock(&m_stateMut);
+	while (m_state != state) {
+		// wait unlocks at entrance and re-locks at the end
+		if (pthread_cond_timedwait(&m_stateCond, &m_stateMut, &ts) != 0)
+			break;
 	}
+	bool reached = (m_state == state);
+	pthread_mutex_unlock(&m_stateMut);
+	return reached;
 }
 
 void CConsoleThread::writeConsole(const string text) {
@@ -136,20 +222,74 @@ void CConsoleThread::writeConsole(const string text) {
 				getLastErrorStr()));
 	}
 
-	// wait for thread to finish output
-	pthread_mutex_lock(&m_outMut);
-	while ((m_state == S_READY) && (m_outTextChanged == true)) {
-		pthread_cond_wait(&(m_outCond), &(m_outMut)); // wait unlocks at entrance and re-locks at the end
+	// push the text onto the stack (lock-free, any number of writing threads)
+	OUTMSG *pMsg = new OUTMSG;
+	pMsg->text = text;
+	pMsg->pNext = m_outMsgs.load();
+	while (!m_outMsgs.compare_exchange_weak(pMsg->pNext, pMsg))
+		;
+	_wakeOutput();
+	return;
+}
+
+void CConsoleThread::writeLEDs(uint16_t pattern) {
+	if (m_state != S_READY) {
+		m_lastError = E_BPTHREADNOTREADY;
+		throw(CException(CException::SRC_IOConsole, getLastError(),
+				getLastErrorStr()));
 	}
 
-	// set the new pattern to transfer to the thread
-	// critical region start
-	m_outText = text;
-	m_outTextChanged = true;				// binary output has been changed
-	pthread_cond_signal(&m_outCond);		// wake-up the thread
-	pthread_mutex_unlock(&m_outMut);
-	// end of critical region
-	return;
+	// a pattern that hasn't been printed yet is superseded
+	m_outLEDs.store(CONSOLE_LEDPENDING | pattern);
+	_wakeOutput();
+}
+
+void CConsoleThread::_wakeOutput() {
+	if (m_outWaiting.load()) {
+		pthread_mutex_lock(&m_outMut);
+		pthread_cond_signal(&m_outCond);
+		pthread_mutex_unlock(&m_outMut);
+	}
+}
+
+bool CConsoleThread::_outputPending() {
+	return (m_outMsgs.load() != NULL) || (m_outLEDs.load() & CONSOLE_LEDPENDING);
+}
+
+string CConsoleThread::_takeOutput() {
+	// the whole stack is taken at once and reversed into the order of writing
+	OUTMSG *pMsg = m_outMsgs.exchange(NULL);
+	OUTMSG *pFirst = NULL;
+	while (pMsg) {
+		OUTMSG *pNext = pMsg->pNext;
+		pMsg->pNext = pFirst;
+		pFirst = pMsg;
+		pMsg = pNext;
+	}
+	string batch;
+	while (pFirst) {
+		batch += pFirst->text;
+		OUTMSG *pNext = pFirst->pNext;
+		delete pFirst;
+		pFirst = pNext;
+	}
+
+	uint32_t leds = m_outLEDs.fetch_and(~CONSOLE_LEDPENDING);
+	if (leds & CONSOLE_LEDPENDING) {
+		for (int i = 15; i >= 0; i--)
+			batch += (leds & (1 << i)) ? '1' : '0';
+		/*
+		 * print only a carriage return (\r) and no line feed (\n) so
+		 * the bit pattern is always printed in the same line in the
+		 * external console window
+		 *
+		 * in the eclipse console view \r is always printed with an
+		 * additional line feed, so the patterns are printed in
+		 * subsequent lines
+		 */
+		batch += '\r';
+	}
+	return batch;
 }
 
 double CConsoleThread::readConsoleNumber() {
@@ -167,6 +307,15 @@ string CConsoleThread::readConsoleString() {
 	return m_inText;
 }
 
+void CConsoleThread::setTransport(CTransportQueue *pTransport,
+		CFilterBase *pFilter) {
+	pthread_mutex_lock(&m_inMut);
+	m_pTransport = pTransport;
+	m_pFilter = pFilter;
+	m_filterOn = (pFilter != NULL);
+	pthread_mutex_unlock(&m_inMut);
+}
+
 CConsoleThread::STATES CConsoleThread::getState() {
 	return m_state;
 }
@@ -219,28 +368,26 @@ void CConsoleThread::printState() {
 void* CConsoleThread::outThreadHandler(void *Obj) {
 	CConsoleThread *pPIOC = (CConsoleThread*) Obj;
 	cout << "output thread has been started" << endl;
-	pPIOC->m_state = S_READY;
+	pPIOC->_setState(S_READY);
 
 	while (1) {
 		pthread_mutex_lock(&(pPIOC->m_outMut));
 		// put thread to sleep while there is nothing to do
-		// if there is something to do, the main thread (in our case) wakes up the thread by setting a condition
-		while ((pPIOC->m_state == S_READY) && (pPIOC->m_outTextChanged == false)) {
+		// if there is something to do, the writing thread wakes up the thread by setting a condition
+		pPIOC->m_outWaiting.store(true);
+		while ((pPIOC->m_state != S_NOTREADY) && !pPIOC->_outputPending()) {
 			pthread_cond_wait(&(pPIOC->m_outCond), &(pPIOC->m_outMut)); // wait unlocks at entrance and re-locks at the end
 		}
+		pPIOC->m_outWaiting.store(false);
+		pthread_mutex_unlock(&pPIOC->m_outMut);
+
+		// everything written meanwhile is printed at once (without holding the mutex)
+		string batch = pPIOC->_takeOutput();
+		if (!batch.empty())
+			cout << batch << flush;
 
-		if (pPIOC->m_state == S_NOTREADY) {
-			pthread_mutex_unlock(&(pPIOC->m_outMut));
+		if (pPIOC->m_state == S_NOTREADY)
 			break;
-		} else {
-			if (pPIOC->m_outTextChanged == true) {
-				cout << pPIOC->m_outText;
-				pPIOC->m_outTextChanged = false;
-				// signals main thread that output is done
-				pthread_cond_signal(&pPIOC->m_outCond);
-			}
-			pthread_mutex_unlock(&pPIOC->m_outMut);
-		}
 	}
 	cout << "output thread terminates. " << endl;
 	return NULL;
@@ -250,14 +397,35 @@ void* CConsoleThread::inThreadHandler(void *Obj) {
 	CConsoleThread *pPIOC = (CConsoleThread*) Obj;
 	cout << "input thread has been started" << endl;
 	char line[256];
-	pPIOC->m_state = S_READY;
+	pPIOC->_setState(S_READY);
 	while (pPIOC->m_state == S_READY) {
 		cin.getline(line, 256);
 		pthread_mutex_lock(&(pPIOC->m_inMut));
-		pPIOC->m_inTextChanged = true;
-		pPIOC->m_inText = line;
-		// signals main thread that input is available
-		pthread_cond_signal(&pPIOC->m_inCond);
+		if (pPIOC->m_pTransport) {
+			// playback: the line is a transport command
+			string cmd = line;
+			if (cmd == "s")
+				pPIOC->m_pTransport->post(TRANSPORTCMD::CMD_STOP);
+			else if (cmd == "f") {
+				if (pPIOC->m_pFilter) {
+					pPIOC->m_filterOn = !pPIOC->m_filterOn;
+					pPIOC->m_pTransport->post(TRANSPORTCMD::CMD_FILTER, 0.,
+							pPIOC->m_filterOn ? pPIOC->m_pFilter : NULL);
+				}
+			} else if (!cmd.empty() && (isdigit(cmd[0]) || (cmd[0] == '.'))) {
+				// a position [s], lines that are not a valid number are ignored
+				char *end;
+				double pos = strtod(cmd.c_str(), &end);
+				if ((*end == '\0') && isfinite(pos))
+					pPIOC->m_pTransport->post(TRANSPORTCMD::CMD_SEEK, pos);
+			} else
+				pPIOC->m_pTransport->post(TRANSPORTCMD::CMD_TOGGLE);
+		} else {
+			pPIOC->m_inTextChanged = true;
+			pPIOC->m_inText = line;
+			// signals main thread that input is available
+			pthread_cond_signal(&pPIOC->m_inCond);
+		}
 		pthread_mutex_unlock(&pPIOC->m_inMut);
 	}
 	return NULL;
@@ -1,8 +1,11 @@
 #ifndef CCONSOLETHREAD_H_
 #define CCONSOLETHREAD_H_
 
+#include <atomic>
+#include <stdint.h>
 #include <pthread.h>
 #include "CException.h"
+#include "CTransportQueue.h"
 
 /**
  * \brief provides threads for console input and console output
@@ -12,6 +15,11 @@
  * The class is designed as a singleton (design pattern) to ensure that only one
  * object exists. This is necessary, because it has access to the shared
  * resources cin and cout.
+ *
+ * Writing never waits for the terminal: texts are pushed onto a lock-free
+ * stack by any number of threads, LED patterns overwrite the previous pattern
+ * that hasn't been printed yet. The output thread prints all texts written
+ * since its last write and the latest LED pattern in one batch.
  */
 class CConsoleThread {
 public:
@@ -70,15 +78,26 @@ protected:
 	 * condition of the boutput thread to wakeup an do its job
 	 */
 	pthread_cond_t m_outCond;
+	/**
+	 * the output thread sleeps on the condition (the writers only signal in that case)
+	 */
+	atomic<bool> m_outWaiting;
 
 	/**
-	 * variable for the output thread to get the text to show on the screen
+	 * \brief text written to the console
+	 */
+	struct OUTMSG {
+		string text;
+		OUTMSG *pNext;
+	};
+	/**
+	 * texts that haven't been printed yet (newest first)
 	 */
-	string m_outText;
+	atomic<OUTMSG*> m_outMsgs;
 	/**
-	 * variable signalizes that the output text has been changed
+	 * latest LED pattern (bit CONSOLE_LEDPENDING set if it hasn't been printed yet)
 	 */
-	bool m_outTextChanged;
+	atomic<uint32_t> m_outLEDs;
 
 	/**
 	 * handle of the input thread (NULL if no thread has been started at program start)
@@ -100,6 +119,15 @@ protected:
 	 * indicates that new text has been entered and terminated by ENTER
 	 */
 	bool m_inTextChanged;
+	/**
+	 * receives the entered lines as transport commands during a playback (NULL otherwise)
+	 */
+	CTransportQueue *m_pTransport;
+	/**
+	 * filter of the playback switched off and on by the line "f" (borrowed)
+	 */
+	CFilterBase *m_pFilter;
+	bool m_filterOn;
 
 	/**
 	 * saves the last error occurred (E_OK if no error occurred)
@@ -108,7 +136,12 @@ protected:
 	/**
 	 * saves the current state of the instance (S_READY if all threads are started)
 	 */
-	STATES m_state;
+	atomic<STATES> m_state;
+	/**
+	 * signals changes of m_state (start of a thread)
+	 */
+	pthread_mutex_t m_stateMut;
+	pthread_cond_t m_stateCond;
 
 private:
 	/**
@@ -157,6 +190,15 @@ public:
 	 */
 	void writeConsole(const string text);
 
+	/**
+	 * \brief shows a LED pattern as binary number in the current line
+	 *
+	 * a pattern that hasn't been printed yet is replaced by the new one
+	 *
+	 * \param pattern [in] LED pattern (bit 15 left)
+	 */
+	void writeLEDs(uint16_t pattern);
+
 	/**
 	 * \brief waits for the user to enter a number (blocking)
 	 *
@@ -186,6 +228,32 @@ public:
 	 */
 	bool enterPressed();
 
+	/**
+	 * input thread: waits for the ENTER key (blocking)
+	 *
+	 * \param timeout_ms [in] maximum waiting time in milliseconds (negative: no limit)
+	 * \return
+	 * - true: ENTER pressed
+	 * - false: ENTER not pressed within the timeout
+	 */
+	bool waitEnterPressed(int timeout_ms);
+
+	/**
+	 * \brief redirects the entered lines to a transport queue
+	 *
+	 * While a queue is set, the input thread posts each line as command
+	 * instead of passing it to enterPressed() / readConsoleString():
+	 * - "s": stop
+	 * - number: seek to the given time [s]
+	 * - "f": filter off/on (if the playback has a filter)
+	 * - any other line (e.g. ENTER only): pause/resume
+	 *
+	 * \param pTransport [in] queue or NULL to end the redirection
+	 * \param pFilter [in] filter of the playback (must live until the redirection
+	 * ends) or NULL
+	 */
+	void setTransport(CTransportQueue *pTransport, CFilterBase *pFilter = NULL);
+
 	/**
 	 * \brief Prints the current state of the player IO control.
 	 */
@@ -213,6 +281,35 @@ private:
 	 */
 	void close();
 
+	/**
+	 * \brief sets the state and wakes up the threads waiting for a state
+	 */
+	void _setState(STATES state);
+
+	/**
+	 * \brief waits until the instance is in the given state
+	 * \param state [in] expected state
+	 * \param timeout_ms [in] maximum waiting time in milliseconds
+	 * \return false if the state hasn't been reached within the timeout
+	 */
+	bool _waitForState(STATES state, int timeout_ms);
+
+	/**
+	 * \brief wakes up the output thread if it is sleeping
+	 */
+	void _wakeOutput();
+
+	/**
+	 * \return true if there are texts or a LED pattern to be printed
+	 */
+	bool _outputPending();
+
+	/**
+	 * \brief removes all pending texts and the pending LED pattern
+	 * \return texts in the order of writing followed by the LED pattern
+	 */
+	string _takeOutput();
+
 	/**
 	 * \brief controls the behavior of output thread
 	 *
@@ -1,6 +1,14 @@
 #include <iostream>
 #include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 using namespace std;
 
 #include <SKSLib.h>
@@ -28,6 +36,22 @@ void CFileBase::print(void) {
 	cout << "CFileBase[" << getModeTxt() << "]: " << m_path << endl;
 }
 
+bool CFileBase::replaceFile(string tmpPath, string path) {
+#ifdef _WIN32
+	// rename() doesn't replace an existing file on Windows
+	bool ok = MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+	if (!ok)
+		remove(tmpPath.c_str());
+	return ok;
+}
+
+string CFileBase::getPath() {
+	return m_path;
+}
+
 /**
  * utility methods to get the open mode
  */
@@ -100,11 +124,15 @@ CSoundFile::CSoundFile(string path, const FILEMODES mode) :
 		CFileBase(path, mode) {
 	memset(&m_sfinfo, 0, sizeof(m_sfinfo));
 	m_pSFile = NULL;
+	m_convBuf = NULL;
+	m_convBufSize = 0;
 	//cout << "CSoundFile constructor" << endl;
 }
 
 CSoundFile::~CSoundFile() {
 	close();
+	if (m_convBuf)
+		delete[] m_convBuf;
 	//cout << "CSoundFile destructor" << endl;
 }
 
@@ -173,6 +201,19 @@ void CSoundFile::rewind() {
 
 	sf_seek(m_pSFile, 0, SEEK_SET);
 }
+void CSoundFile::seek(long frame) {
+	if (m_pSFile == NULL)
+		throw CException(CException::SRC_File, FILE_E_FILENOTOPEN,
+				getErrorTxt(FILE_E_FILENOTOPEN));
+
+	if (frame < 0)
+		frame = 0;
+	if (frame > m_sfinfo.frames)
+		frame = m_sfinfo.frames;
+	if (sf_seek(m_pSFile, frame, SEEK_SET) < 0)
+		throw CException(CException::SRC_File, FILE_E_READ,
+				getErrorTxt(FILE_E_READ));
+}
 void CSoundFile::write(float *buf, int bufsize) {
 	if (m_pSFile == NULL)
 		throw CException(CException::SRC_File, FILE_E_FILENOTOPEN,
@@ -184,7 +225,25 @@ void CSoundFile::write(float *buf, int bufsize) {
 		throw CException(CException::SRC_File, FILE_E_CANTWRITE,
 				getErrorTxt(FILE_E_CANTWRITE));
 
-	int szwrite = sf_write_float(m_pSFile, buf, bufsize);
+	int szwrite;
+	int subformat = m_sfinfo.format & SF_FORMAT_SUBMASK;
+	if (m_converter.getDither()
+			&& ((subformat == SF_FORMAT_PCM_16) || (subformat == SF_FORMAT_PCM_24))) {
+		if (bufsize > m_convBufSize) {
+			if (m_convBuf)
+				delete[] m_convBuf;
+			m_convBuf = new int32_t[bufsize];
+			m_convBufSize = bufsize;
+		}
+		if (subformat == SF_FORMAT_PCM_16) {
+			m_converter.toInt16(buf, (int16_t*) m_convBuf, bufsize);
+			szwrite = sf_write_short(m_pSFile, (int16_t*) m_convBuf, bufsize);
+		} else {
+			m_converter.toInt24in32(buf, m_convBuf, bufsize);
+			szwrite = sf_write_int(m_pSFile, m_convBuf, bufsize);
+		}
+	} else
+		szwrite = sf_write_float(m_pSFile, buf, bufsize);
 	if (szwrite != bufsize) {
 		close();
 		throw CException(CException::SRC_File, FILE_E_WRITE,
@@ -192,6 +251,10 @@ void CSoundFile::write(float *buf, int bufsize) {
 	}
 }
 
+void CSoundFile::setDither(bool dither) {
+	m_converter.setDither(dither);
+}
+
 int CSoundFile::getNumFrames() {
 	return m_sfinfo.frames;
 }
@@ -257,10 +320,15 @@ void CFilterFile::open() {
 void CFilterFile::close() {
 	if (m_pFile != NULL)
 		fclose(m_pFile);
+	m_pFile = NULL;
 	if (m_b)
 		delete[] m_b;
+	m_b = NULL;
+	m_blen = 0;
 	if (m_a)
 		delete[] m_a;
+	m_a = NULL;
+	m_alen = 0;
 }
 
 int CFilterFile::read(int fs) {
@@ -414,3 +482,135 @@ int CFilterFile::getNumACoeffs() {
  }
  */
 // < ---------- SAMPLE-END ----------->
+
+CMetaFile::CMetaFile(string path, FILEMODES mode) :
+		CFileBase(path, mode) {
+}
+
+int CMetaFile::read() {
+	if (!isFileR())
+		throw CException(CException::SRC_File, FILE_E_CANTREAD,
+				getErrorTxt(FILE_E_CANTREAD));
+	m_values.clear();
+	FILE *pFile = fopen(m_path.c_str(), "r");
+	if (pFile == NULL)
+		return 0;				// no metadata yet
+
+	char buf[256];
+	while (NULL != fgets(buf, sizeof(buf), pFile)) {
+		string s = buf;
+		size_t sep = s.find(";");
+		if (sep == string::npos)
+			continue;			// not an entry
+		// entries without a finite number (e.g. "x;abc" or "x;1e999") are ignored
+		const char *pValue = buf + sep + 1;
+		char *end;
+		double value = strtod(pValue, &end);
+		if ((end == pValue) || !isfinite(value))
+			continue;
+		while ((*end != '\0') && isspace((unsigned char) *end))
+			end++;
+		if (*end == '\0')
+			m_values[s.substr(0, sep)] = value;
+	}
+	fclose(pFile);
+	return m_values.size();
+}
+
+/*
+ * serializes the read-merge-write of the metadata files (the library analyzer
+ * and the player write them from different threads)
+ */
+static pthread_mutex_t s_metaMut = PTHREAD_MUTEX_INITIALIZER;
+
+void CMetaFile::write() {
+	if (!isFileW() && !isFileWA())
+		throw CException(CException::SRC_File, FILE_E_CANTWRITE,
+				getErrorTxt(FILE_E_CANTWRITE));
+	pthread_mutex_lock(&s_metaMut);
+	bool ok = true;
+	try {
+		// entries stored meanwhile for the same version of the sound file
+		CMetaFile current(m_path, FILE_READ);
+		current.read();
+		if (_isSameVersion(current))
+			m_values.insert(current.m_values.begin(), current.m_values.end());
+
+		string tmpPath = m_path + ".tmp";
+		FILE *pFile = fopen(tmpPath.c_str(), "w");
+		if (pFile == NULL)
+			throw CException(CException::SRC_File, FILE_E_NOFILE,
+					getErrorTxt(FILE_E_NOFILE));
+		for (map<string, double>::iterator it = m_values.begin(); it != m_values.end(); it++)
+			if (fprintf(pFile, "%s;%.17g\n", it->first.c_str(), it->second) < 0)
+				ok = false;
+		if ((fclose(pFile) != 0) || !ok) {
+			remove(tmpPath.c_str());
+			ok = false;
+		} else
+			ok = replaceFile(tmpPath, m_path);
+	} catch (...) {				// the lock is released on every path
+		pthread_mutex_unlock(&s_metaMut);
+		throw;
+	}
+	pthread_mutex_unlock(&s_metaMut);
+	if (!ok)
+		throw CException(CException::SRC_File, FILE_E_WRITE,
+				getErrorTxt(FILE_E_WRITE));
+}
+
+bool CMetaFile::_isSameVersion(CMetaFile &other) {
+	const char *keys[] = { "frames", "fs", "channels", "size", "mtime" };
+	for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		if (!hasValue(keys[i]) || !other.hasValue(keys[i])
+				|| (getValue(keys[i]) != other.getValue(keys[i])))
+			return false;
+	return true;
+}
+
+void CMetaFile::print(void) {
+	CFileBase::print();
+	for (map<string, double>::iterator it = m_values.begin(); it != m_values.end(); it++)
+		cout << it->first << " = " << it->second << endl;
+}
+
+bool CMetaFile::hasValue(string key) {
+	return m_values.count(key) != 0;
+}
+
+double CMetaFile::getValue(string key, double defaultValue) {
+	map<string, double>::iterator it = m_values.find(key);
+	return (it == m_values.end()) ? defaultValue : it->second;
+}
+
+void CMetaFile::setValue(string key, double value) {
+	m_values[key] = value;
+}
+
+void CMetaFile::clear() {
+	m_values.clear();
+}
+
+bool CMetaFile::isCurrent(CSoundFile &sfile) {
+	struct stat st;
+	if (stat(sfile.getPath().c_str(), &st) != 0)
+		return false;
+	return (getValue("frames", -1.) == sfile.getNumFrames())
+			&& (getValue("fs", -1.) == sfile.getSampleRate())
+			&& (getValue("channels", -1.) == sfile.getNumChannels())
+			&& (getValue("size", -1.) == (double) st.st_size)
+			&& (getValue("mtime", -1.) == (double) st.st_mtime);
+}
+
+void CMetaFile::setVersion(CSoundFile &sfile) {
+	if (!isCurrent(sfile))
+		clear();
+	struct stat st;
+	if (stat(sfile.getPath().c_str(), &st) != 0)
+		st.st_size = st.st_mtime = 0;
+	setValue("frames", sfile.getNumFrames());
+	setValue("fs", sfile.getSampleRate());
+	setValue("channels", sfile.getNumChannels());
+	setValue("size", st.st_size);
+	setValue("mtime", st.st_mtime);
+}
@@ -4,8 +4,16 @@
 
 #include "sndfile.h"
 #include <string>
+#include <map>
+#include "CSampleConverter.h"
 using namespace std;
 
+/**
+ * the metadata of a sound file is stored in a file with the path of the sound
+ * file and this extension (see CMetaFile)
+ */
+#define META_EXT ".meta"
+
 /**
  * base class for files contains common properties and common behavior for
  * all files
@@ -46,6 +54,23 @@ public:
 	 */
 	virtual void print(void);
 
+	/**
+	 * \return complete file path
+	 */
+	string getPath();
+
+	/**
+	 * \brief replaces a file by a completely written temporary file
+	 *
+	 * readers of the file see either the old or the new contents, never a
+	 * partly written file
+	 *
+	 * \param tmpPath [in] temporary file (removed if it can't replace the file)
+	 * \param path [in] file to be replaced (or created)
+	 * \return false if the file couldn't be replaced
+	 */
+	static bool replaceFile(string tmpPath, string path);
+
 protected:
 	/**
 	 * Methods for the retrieval of file mode
@@ -73,6 +98,15 @@ private:
 	 * contains metadata of the soundfile
 	 */
 	SF_INFO m_sfinfo;
+	/**
+	 * converter for dithered writing of 16/24 bit files
+	 */
+	CSampleConverter m_converter;
+	/**
+	 * buffer for the converted samples and its size in samples
+	 */
+	int32_t *m_convBuf;
+	int m_convBufSize;
 
 public:
 	/**
@@ -105,10 +139,26 @@ public:
 	 * \return total number of samples (not frames!) written
 	 */
 	void write(float *buf, int bufsize);
+	/**
+	 * switches TPDF dither for writing 16 bit and 24 bit PCM files on or off
+	 *
+	 * with dither, the samples are quantized by CSampleConverter instead of libsndfile
+	 *
+	 * \param dither [in] dither on/off
+	 */
+	void setDither(bool dither);
 	/**
 	 * sets the file pointer of an open sound file back to the start
 	 */
 	void rewind();
+	/**
+	 * \brief sets the file pointer of an open sound file to a frame
+	 *
+	 * positions behind the end are limited to the end of the file
+	 *
+	 * \param frame [in] number of the frame read next (0: start of the file)
+	 */
+	void seek(long frame);
 	/**
 	 * prints the soundfile properties contained in m_sfinfo on the console
 	 */
@@ -224,4 +274,85 @@ public:
 	int getNumACoeffs();
 };
 
+/**
+ * class for the metadata file of a sound file (e.g. its loudness)
+ *
+ * text file with one entry per line:
+ *
+ *     key;value
+ *
+ * the whole file is read or written at once, a missing file is an empty one
+ * (the metadata is a cache of analysis results that can be recomputed)
+ *
+ * the metadata of a sound file contains the version of the sound file it has
+ * been computed from (number of frames, sample rate, channels, size and
+ * modification time), see setVersion() and isCurrent()
+ */
+class CMetaFile: public CFileBase {
+private:
+	map<string, double> m_values;
+
+public:
+	/**
+	 * initializes attributes
+	 */
+	CMetaFile(string path, FILEMODES mode = FILE_MODEUNKNOWN);
+	/**
+	 * reads all entries of the file (replaces the entries in memory)
+	 *
+	 * \return number of entries read (0 if the file doesn't exist)
+	 */
+	int read();
+	/**
+	 * writes all entries (replaces the file)
+	 *
+	 * the file is written to a temporary file that replaces it, so concurrent
+	 * readers never see a partly written file. Entries of the same version of
+	 * the sound file that another thread has written since read() and that are
+	 * not set in this object are kept.
+	 */
+	void write();
+	/**
+	 * prints the entries on console
+	 */
+	void print(void);
+	/**
+	 * \return true if there is an entry with the key
+	 */
+	bool hasValue(string key);
+	/**
+	 * \param key [in] key of the entry
+	 * \param defaultValue [in] returned if there is no entry with the key
+	 * \return value of the entry
+	 */
+	double getValue(string key, double defaultValue = 0.);
+	/**
+	 * adds an entry or changes its value
+	 */
+	void setValue(string key, double value);
+	/**
+	 * removes all entries
+	 */
+	void clear();
+	/**
+	 * \param sfile [in] open sound file
+	 * \return true if the entries belong to the current version of the sound file
+	 */
+	bool isCurrent(CSoundFile &sfile);
+	/**
+	 * \brief stores the version of a sound file
+	 *
+	 * the entries of another version of the sound file are removed
+	 *
+	 * \param sfile [in] open sound file
+	 */
+	void setVersion(CSoundFile &sfile);
+
+private:
+	/**
+	 * \return true if both objects have the entries of the same version of a sound file
+	 */
+	bool _isSameVersion(CMetaFile &other);
+};
+
 #endif /* FILE_H_ */
@@ -1,4 +1,5 @@
 #include <math.h>
+#include <string.h>
 #include <SKSLib.h>
 #include "CFilter.h"
 
@@ -11,6 +12,8 @@ CFilterBase::CFilterBase(int order, int channels) {
 		for (int i = 0; i < m_channels * (m_order + 1); i++) {
 			m_z[i] = 0.;
 		}
+		m_padX = new float[m_channels * m_order];
+		m_padY = new float[m_channels * m_order];
 	} else
 		throw CException(CException::SRC_Filter, -1,
 				"Filter order and channels must not be zero!");
@@ -19,6 +22,22 @@ CFilterBase::CFilterBase(int order, int channels) {
 CFilterBase::~CFilterBase() {
 	if (m_z != NULL)
 		delete[] m_z;
+	delete[] m_padX;
+	delete[] m_padY;
+}
+
+bool CFilterBase::filterBlock(float *x, float *y, int framesPerBuffer) {
+	if ((framesPerBuffer >= m_order) || (framesPerBuffer <= 0) || (x == NULL)
+			|| (y == NULL))
+		return filter(x, y, framesPerBuffer);
+	// short block: zero padded to the order (no allocation on the audio path)
+	int n = framesPerBuffer * m_channels;
+	memcpy(m_padX, x, n * sizeof(float));
+	memset(m_padX + n, 0, (m_order * m_channels - n) * sizeof(float));
+	if (!filter(m_padX, m_padY, m_order))
+		return false;
+	memcpy(y, m_padY, n * sizeof(float));
+	return true;
 }
 
 void CFilterBase::reset() {
@@ -85,7 +104,20 @@ bool CFilter::filter(float *x, float *y, int framesPerBuffer) {
 	return true;
 }
 
+CFilterBase* CFilter::clone() {
+	// the coefficients are already normalized (m_a[0] == 1)
+	return new CFilter(m_filePath, m_a, m_b, m_order, m_channels);
+}
+
 string CFilter::getFilePath() {
 	return m_filePath;
 }
 
+const float* CFilter::getACoeffs() {
+	return m_a;
+}
+
+const float* CFilter::getBCoeffs() {
+	return m_b;
+}
+
@@ -21,6 +21,11 @@ protected:
 	 * \brief number of channels of the signals to be filtered
 	 */
 	int m_channels;
+	/**
+	 * \brief input and output of a block shorter than the order (order frames each)
+	 */
+	float *m_padX;
+	float *m_padY;
 
 public:
 	/**
@@ -51,6 +56,30 @@ public:
 	 * \param framesPerBuffer no of frames in the block buffers (original & filtered)
 	 */
 	virtual bool filter(float *x, float *y, int framesPerBuffer)=0;
+	/**
+	 * \brief creates a new filter object of the same type and configuration
+	 *
+	 * the intermediate states of the new filter are cleared, so it can be used
+	 * for another signal with the same sampling frequency and number of channels
+	 * (e.g. the next track of a play queue)
+	 *
+	 * \return new filter object (to be deleted by the caller)
+	 */
+	virtual CFilterBase* clone()=0;
+	/**
+	 * \brief filters a block of any length
+	 *
+	 * a block shorter than the order of the filter (e.g. the last block of a
+	 * signal) is filtered zero padded to the order, so it is never passed on
+	 * unfiltered. The intermediate states then include the padding: only the
+	 * last block of a signal may be shorter.
+	 *
+	 * \param x pointer on block buffer of original signal
+	 * \param y pointer on block buffer of filtered signal
+	 * \param framesPerBuffer no of frames in the block buffers (original & filtered)
+	 * \return false if the block couldn't be filtered
+	 */
+	bool filterBlock(float *x, float *y, int framesPerBuffer);
 	/**
 	 * \brief resets filter
 	 *
@@ -117,10 +146,22 @@ public:
 	 */
 	bool filter(float *x, float *y, int framesPerBuffer); // straight forward difference equation
 
+	/**
+	 * \brief creates a filter with the same coefficients and cleared states
+	 */
+	CFilterBase* clone();
+
 	/**
 	 * \return path of filter file
 	 */
 	string getFilePath();
+
+	/**
+	 * \return normalized coefficients of the denominator and of the numerator
+	 * (order + 1 each, a[0] = 1)
+	 */
+	const float* getACoeffs();
+	const float* getBCoeffs();
 };
 
 
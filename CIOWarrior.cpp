@@ -4,6 +4,7 @@ using namespace std;
 #include <typeinfo>
 #include <SKSLib.h>
 #include <cwchar>
+#include <chrono>
 #include "CIOWarrior.h"
 
 /* ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -187,6 +188,34 @@ bool CIOWarrior::keyPressed(){
 	return false;
 }
 
+/**
+ * \brief waits for the key without polling
+ *
+ * IowKitRead blocks in the driver until the pins change or its timeout expires
+ */
+bool CIOWarrior::waitKeyPressed(int timeout_ms){
+	if(m_state == S_NOTREADY){
+			m_lastError = E_DEVICENOTREADY;
+			throw CException(CException::SRC_IOWarrior, E_DEVICENOTREADY, "Open the Device First");
+	}
+	chrono::steady_clock::time_point tEnd = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+	while(true){
+		long remaining = 1000;						//without limit the read is repeated every second
+		if(timeout_ms != CVDEV_WAIT_INFINITE){
+			remaining = chrono::duration_cast<chrono::milliseconds>(tEnd - chrono::steady_clock::now()).count();
+			if(remaining <= 0)
+				return false;
+		}
+		IowKitSetTimeout(m_handle, remaining);
+		if(sizeof(IOWKIT40_IO_REPORT) == IowKitRead(m_handle, IOW_PIPE_IO_PINS, (char *) &m_reportIn, sizeof(IOWKIT40_IO_REPORT))){
+			if((m_reportIn.Bytes[0] & 0x01) == 0){
+				m_reportIn.Bytes[0] = 0xff;
+				return true;
+			}
+		}
+	}
+}
+
 
 /**
  * \brief Prints the current state of IOWarrior instance.
@@ -37,6 +37,7 @@ public:
 	void close();									//Closes the IOW Device
 	void writeLEDs(uint8_t data);					//Writes the data to the LEDs
 	bool keyPressed();								//Checks if the key is pressed or not and return true if it is pressed
+	bool waitKeyPressed(int timeout_ms);			//Blocks in the driver until the key is pressed or the timeout expires
 	void printState();								//Prints the current state of the device
 	STATES getState();								//Used to get the current state of the device
 	string getStateStr();							//Used to get the current state in string format
@@ -0,0 +1,185 @@
+#include <time.h>
+#include "CLEDWriter.h"
+#include "CAmpMeter.h"
+#include "CTrace.h"
+
+CLEDWriter::CLEDWriter() {
+	m_pDev = NULL;
+	m_maxRate = LEDW_MAXRATE;
+	m_requested = LEDW_NONE;
+	m_written = 0;
+	m_writtenValid = false;
+	m_thread = pthread_t { };
+	m_running = false;
+	m_stop = false;
+	pthread_mutex_init(&m_mut, 0);
+	pthread_cond_init(&m_cond, 0);
+	m_numRequests = 0;
+	m_numSkipped = 0;
+	m_numWrites = 0;
+	m_pError = NULL;
+	m_failed = false;
+}
+
+CLEDWriter::~CLEDWriter() {
+	stop();
+	pthread_mutex_destroy(&m_mut);
+	pthread_cond_destroy(&m_cond);
+	delete m_pError;
+}
+
+void CLEDWriter::start(CPlayerCVDevice *pDev, double maxRate) {
+	stop();
+	m_pDev = pDev;
+	m_maxRate = (maxRate > 0.) ? maxRate : LEDW_MAXRATE;
+	m_stop = false;
+	// the state of the LEDs is unknown, the first pattern is written in any case
+	m_requested = LEDW_NONE;
+	m_writtenValid = false;
+	m_numRequests = 0;
+	m_numSkipped = 0;
+	m_numWrites = 0;
+	delete m_pError;
+	m_pError = NULL;
+	m_failed = false;
+	if (pthread_create(&m_thread, NULL, writerThreadHandler, (void*) this) != 0)
+		throw CException(CException::SRC_AmpMeter, CAmpMeter::AMP_E_NOVISUALIZER,
+				"Can't start the LED writer thread.");
+	m_running = true;
+}
+
+void CLEDWriter::stop() {
+	if (!m_running)
+		return;
+	pthread_mutex_lock(&m_mut);
+	m_stop = true;
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mut);
+	pthread_join(m_thread, NULL);
+	m_running = false;
+}
+
+double CLEDWriter::getMaxRate() {
+	return m_maxRate;
+}
+
+unsigned long CLEDWriter::getNumRequests() {
+	return m_numRequests;
+}
+
+unsigned long CLEDWriter::getNumSkipped() {
+	return m_numSkipped;
+}
+
+unsigned long CLEDWriter::getNumWrites() {
+	return m_numWrites;
+}
+
+/**
+ * INTERFACE of CPlayerCVDevice: passed to the device
+ */
+void CLEDWriter::open() {
+	m_pDev->open();
+}
+
+void CLEDWriter::close() {
+	stop();
+	m_pDev->close();
+}
+
+void CLEDWriter::writeLEDs(uint16_t data) {
+	if (m_failed.load(memory_order_acquire))
+		throw *m_pError;
+	if (!m_running) {
+		// not started: no combining
+		if (m_pDev)
+			m_pDev->writeLEDs(data);
+		return;
+	}
+
+	m_numRequests.fetch_add(1, memory_order_relaxed);
+	if ((m_requested.load(memory_order_relaxed) & ~LEDW_PENDING) == data) {
+		m_numSkipped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	// a pattern that hasn't been written yet is superseded
+	m_requested.store(LEDW_PENDING | data, memory_order_release);
+	pthread_mutex_lock(&m_mut);
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mut);
+}
+
+bool CLEDWriter::keyPressed() {
+	return m_pDev->keyPressed();
+}
+
+bool CLEDWriter::waitKeyPressed(int timeout_ms) {
+	return m_pDev->waitKeyPressed(timeout_ms);
+}
+
+string CLEDWriter::getStateStr() {
+	return m_pDev->getStateStr();
+}
+
+string CLEDWriter::getLastErrorStr() {
+	return m_pDev->getLastErrorStr();
+}
+
+void CLEDWriter::_flush() {
+	unsigned req = m_requested.fetch_and(~LEDW_PENDING, memory_order_acquire);
+	if (!(req & LEDW_PENDING))
+		return;
+	uint16_t data = req & 0xffff;
+	// a pattern may have been requested and reverted between two writes
+	if (m_writtenValid && (data == m_written))
+		return;
+	TRACE_SCOPE("writeLEDs");
+	m_pDev->writeLEDs(data);
+	m_written = data;
+	m_writtenValid = true;
+	m_numWrites.fetch_add(1, memory_order_relaxed);
+}
+
+void* CLEDWriter::writerThreadHandler(void *Obj) {
+	CLEDWriter *pW = (CLEDWriter*) Obj;
+	TRACE_THREAD("LED writer");
+	long period_ns = 1e9 / pW->m_maxRate;
+
+	try {
+		pthread_mutex_lock(&pW->m_mut);
+		while (!pW->m_stop) {
+			// sleep until a pattern is requested
+			while (!pW->m_stop
+					&& !(pW->m_requested.load(memory_order_acquire) & LEDW_PENDING))
+				pthread_cond_wait(&pW->m_cond, &pW->m_mut);
+			if (pW->m_stop)
+				break;
+			pthread_mutex_unlock(&pW->m_mut);
+
+			pW->_flush();
+
+			// rate limit: the patterns requested until the end of the period
+			// are combined into one write
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += period_ns;
+			while (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_mutex_lock(&pW->m_mut);
+			// wait unlocks at entrance and re-locks at the end
+			while (!pW->m_stop
+					&& (pthread_cond_timedwait(&pW->m_cond, &pW->m_mut, &ts) == 0))
+				;
+		}
+		pthread_mutex_unlock(&pW->m_mut);
+		// the LEDs show the pattern last requested
+		pW->_flush();
+	} catch (CException &e) {
+		// reported to the meter by the next writeLEDs()
+		pW->m_pError = new CException(e);
+		pW->m_failed.store(true, memory_order_release);
+	}
+	return NULL;
+}
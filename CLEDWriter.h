@@ -0,0 +1,142 @@
+#ifndef CLEDWRITER_H_
+#define CLEDWRITER_H_
+
+#include <atomic>
+#include <pthread.h>
+using namespace std;
+
+#include "CPlayerCVDevice.h"
+#include "CException.h"
+
+/**
+ * default maximum number of LED writes to the device per second
+ */
+#define LEDW_MAXRATE 60.
+/**
+ * flag of a requested pattern that hasn't been written yet (above the 16 LED bits)
+ */
+#define LEDW_PENDING 0x10000u
+/**
+ * requested pattern before the first request (equal to no pattern)
+ */
+#define LEDW_NONE 0x20000u
+
+/**
+ * \brief write-combining layer in front of the LEDs of a control device
+ *
+ * Decorator of a CPlayerCVDevice: the amplitude meter writes its patterns to
+ * the LED writer, which passes them to the device from a thread of its own.
+ *
+ * - a pattern equal to the last one requested is skipped without any I/O (no
+ *   USB transfer of the IOWarrior, no string of the console)
+ * - the device is written at most at the maximum rate, patterns requested in
+ *   between supersede each other and only the latest one is written
+ * - the latest pattern is always written (at the latest 1 / maximum rate
+ *   after the request), so the LEDs end up in the state last requested
+ *
+ * writeLEDs() is a single atomic load for an unchanged pattern, a changed
+ * one additionally wakes up the writer thread. All other methods are passed
+ * to the device. The device is borrowed and neither opened nor closed by
+ * start() and stop().
+ */
+class CLEDWriter: public CPlayerCVDevice {
+private:
+	CPlayerCVDevice *m_pDev;
+	double m_maxRate;
+
+	/**
+	 * latest requested pattern (16 bits) | LEDW_PENDING if not written yet,
+	 * LEDW_NONE before the first request
+	 */
+	atomic<unsigned> m_requested;
+	/**
+	 * pattern on the device (writer thread)
+	 */
+	uint16_t m_written;
+	bool m_writtenValid;
+
+	pthread_t m_thread;
+	bool m_running;
+	bool m_stop;
+	pthread_mutex_t m_mut;
+	pthread_cond_t m_cond;
+
+	/**
+	 * number of requested patterns, of those skipped as unchanged and of device writes
+	 */
+	atomic<unsigned long> m_numRequests;
+	atomic<unsigned long> m_numSkipped;
+	atomic<unsigned long> m_numWrites;
+	/**
+	 * error of the device thrown in the writer thread (ends the thread)
+	 */
+	CException *m_pError;
+	atomic<bool> m_failed;
+
+public:
+	CLEDWriter();
+	/**
+	 * stops the thread
+	 */
+	~CLEDWriter();
+
+	/**
+	 * \brief starts the writer thread
+	 * \param pDev [in] open device (borrowed)
+	 * \param maxRate [in] maximum number of device writes per second
+	 */
+	void start(CPlayerCVDevice *pDev, double maxRate = LEDW_MAXRATE);
+
+	/**
+	 * \brief writes the pending pattern and stops the writer thread
+	 */
+	void stop();
+
+	double getMaxRate();
+
+	/**
+	 * \return number of patterns requested since the start
+	 */
+	unsigned long getNumRequests();
+
+	/**
+	 * \return number of requested patterns skipped because they were unchanged
+	 */
+	unsigned long getNumSkipped();
+
+	/**
+	 * \return number of device writes since the start
+	 */
+	unsigned long getNumWrites();
+
+	/**
+	 * INTERFACE of CPlayerCVDevice
+	 */
+	void open();
+	void close();
+	/**
+	 * \brief requests a pattern (never waits for the device)
+	 *
+	 * throws the error of the device if the writer thread has failed
+	 */
+	void writeLEDs(uint16_t data);
+	bool keyPressed();
+	bool waitKeyPressed(int timeout_ms);
+	string getStateStr();
+	string getLastErrorStr();
+
+private:
+	/**
+	 * \brief writes the latest requested pattern if it differs from the device's (writer thread)
+	 */
+	void _flush();
+
+	/**
+	 * \brief writes the requested patterns at most at the maximum rate
+	 *
+	 * \param Obj pointer on the instance
+	 */
+	static void* writerThreadHandler(void *Obj);
+};
+
+#endif /* CLEDWRITER_H_ */
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <stdio.h>
+#include <math.h>
+#include <SKSLib.h>
+#include "CFile.h"
+#include "CUserInterface.h"
+#include "CPlaybackPipeline.h"
+#include "CScriptedCVDevice.h"
+#include "CLatencyHarness.h"
+
+/**
+ * duration of the test signal [s], block duration [s] and pause duration [s]
+ */
+#define LAT_SIGNALDUR 2.0
+#define LAT_BLOCKDUR 0.125
+#define LAT_PAUSEDUR 0.3
+
+CLatencyHarness::CLatencyHarness(CBlockPool *pPool, string tmpDir) {
+	m_pPool = pPool;
+	m_tmpDir = tmpDir;
+	m_fs = 44100.;
+}
+
+void CLatencyHarness::blockWritten(const float*, int noFrames,
+		double tWritten, double tDac) {
+	BLOCKSTAMP b;
+	b.tWritten = tWritten;
+	b.tDac = tDac;
+	b.duration = noFrames / m_fs;
+	m_blocks.push_back(b);
+}
+
+void CLatencyHarness::streamStateChanged(bool running, double t) {
+	STATESTAMP s;
+	s.running = running;
+	s.t = t;
+	m_states.push_back(s);
+}
+
+void CLatencyHarness::run(int numTrials) {
+	for (int m = 0; m < LAT_NUM; m++)
+		m_values[m].clear();
+
+	// synthetic stereo test signal (440 Hz sine)
+	string path = m_tmpDir + "latency_tmp.wav";
+	int frames = LAT_SIGNALDUR * m_fs;
+	{
+		CSoundFile wfile(path, CSoundFile::FILE_WRITE);
+		wfile.setFormat(SF_FORMAT_WAV | SF_FORMAT_PCM_16);
+		wfile.setNumChannels(2);
+		wfile.setSampleRate(m_fs);
+		wfile.open();
+		float *sig = new float[2 * frames];
+		for (int k = 0; k < frames; k++)
+			sig[2 * k] = sig[2 * k + 1] = 0.25f * sin(2 * M_PI * 440. * k / m_fs);
+		wfile.write(sig, 2 * frames);
+		delete[] sig;
+		wfile.close();
+	}
+
+	CScriptedCVDevice dev;
+	CUserInterface *pUI = new CUserInterface;	// amplitude meter buffers, not on the stack
+	pUI->init(&dev);
+	CAudioOutStream stream;
+	stream.setSink(this);
+	CPlaybackPipeline pipeline(&stream, pUI, m_pPool);
+
+	try {
+		for (int trial = 0; trial < numTrials; trial++) {
+			CSoundFile sfile(path, CSoundFile::FILE_READ);
+			sfile.open();
+			m_blocks.clear();
+			m_states.clear();
+
+			// start, pause (varied against the block grid) and resume
+			double tPause = 0.4 + 0.4 * ((trial * 7) % numTrials) / numTrials;
+			double script[] = { 0., tPause, tPause + LAT_PAUSEDUR };
+			dev.setScript(script, 3);
+
+			long framesPerBlock = m_fs * LAT_BLOCKDUR;
+			double tPlay = CScriptedCVDevice::now();
+			pipeline.play(&sfile, NULL, NULL, m_fs, framesPerBlock, framesPerBlock);
+			stream.close();
+			sfile.close();
+
+			_evaluateTrial(tPlay, &dev);
+		}
+	} catch (CException &e) {
+		stream.setSink(NULL);
+		delete pUI;
+		remove(path.c_str());
+		throw;
+	}
+	stream.setSink(NULL);
+	delete pUI;
+	remove(path.c_str());
+}
+
+void CLatencyHarness::_evaluateTrial(double tPlay, CScriptedCVDevice *pDev) {
+	if (m_blocks.empty())
+		return;
+	m_values[LAT_PLAY_TO_SOUND].push_back(m_blocks[0].tDac - tPlay);
+
+	for (int i = 0; i < pDev->getNumEvents(); i++) {
+		CScriptedCVDevice::KEYEVENT ev = pDev->getEvent(i);
+		if (ev.tDetected > 0.)
+			m_values[LAT_KEY_DETECT].push_back(ev.tDetected - ev.tScheduled);
+	}
+
+	// pause: first stop after the key press
+	double tPauseKey = pDev->getEvent(1).tScheduled;
+	for (unsigned int i = 0; i < m_states.size(); i++)
+		if (!m_states[i].running && (m_states[i].t >= tPauseKey)) {
+			m_values[LAT_PAUSE_TO_SILENCE].push_back(m_states[i].t - tPauseKey);
+			break;
+		}
+
+	// resume: first block written after the restart that follows the key press
+	double tResumeKey = pDev->getEvent(2).tScheduled;
+	for (unsigned int i = 0; i < m_states.size(); i++)
+		if (m_states[i].running && (m_states[i].t >= tResumeKey)) {
+			for (unsigned int b = 0; b < m_blocks.size(); b++)
+				if (m_blocks[b].tWritten >= m_states[i].t) {
+					m_values[LAT_RESUME_TO_SOUND].push_back(m_blocks[b].tDac - tResumeKey);
+					break;
+				}
+			break;
+		}
+
+	// jitter of consecutive blocks without a stop in between (a blocking write
+	// returns when the device has consumed as many frames as the block contains)
+	for (unsigned int b = 1; b < m_blocks.size(); b++) {
+		bool stopped = false;
+		for (unsigned int i = 0; i < m_states.size(); i++)
+			if ((m_states[i].t > m_blocks[b - 1].tWritten)
+					&& (m_states[i].t < m_blocks[b].tWritten))
+				stopped = true;
+		if (!stopped)
+			m_values[LAT_BLOCK_JITTER].push_back(
+					fabs(m_blocks[b].tWritten - m_blocks[b - 1].tWritten
+							- m_blocks[b].duration));
+	}
+}
+
+CLatencyHarness::PERCENTILES CLatencyHarness::getPercentiles(METRICS metric) {
+	PERCENTILES p = PERCENTILES();
+	deque<double> v = m_values[metric];
+	p.count = v.size();
+	if (v.empty())
+		return p;
+	sort(v.begin(), v.end());
+	// nearest rank
+	p.p50 = v[(v.size() - 1) * 50 / 100];
+	p.p90 = v[(v.size() - 1) * 90 / 100];
+	p.p99 = v[(v.size() - 1) * 99 / 100];
+	p.max = v.back();
+	return p;
+}
+
+const char* CLatencyHarness::_getName(METRICS metric) {
+	const char *names[LAT_NUM] = { "play_to_sound", "key_detect", "pause_to_silence",
+			"resume_to_sound", "block_jitter" };
+	return names[metric];
+}
+
+string CLatencyHarness::getResultStr() {
+	string str = "latency [ms]            count      p50      p90      p99      max\n";
+	char buf[128];
+	for (int m = 0; m < LAT_NUM; m++) {
+		PERCENTILES p = getPercentiles((METRICS) m);
+		snprintf(buf, sizeof(buf), "%-20s %8lu %8.2f %8.2f %8.2f %8.2f\n",
+				_getName((METRICS) m), p.count, p.p50 * 1e3, p.p90 * 1e3, p.p99 * 1e3,
+				p.max * 1e3);
+		str += buf;
+	}
+	return str;
+}
+
+string CLatencyHarness::getJSON() {
+	string str = "{\n  \"unit\": \"ms\",\n  \"latencies\": {\n";
+	char buf[256];
+	for (int m = 0; m < LAT_NUM; m++) {
+		PERCENTILES p = getPercentiles((METRICS) m);
+		snprintf(buf, sizeof(buf),
+				"    \"%s\": {\"count\": %lu, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+						"\"max\": %.3f}%s\n", _getName((METRICS) m), p.count, p.p50 * 1e3,
+				p.p90 * 1e3, p.p99 * 1e3, p.max * 1e3, (m + 1 < LAT_NUM) ? "," : "");
+		str += buf;
+	}
+	return str + "  }\n}\n";
+}
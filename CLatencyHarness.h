@@ -0,0 +1,119 @@
+#ifndef CLATENCYHARNESS_H_
+#define CLATENCYHARNESS_H_
+
+#include <string>
+#include <deque>
+using namespace std;
+
+#include "CAudioOutStream.h"
+#include "CBlockPool.h"
+
+class CScriptedCVDevice;
+
+/**
+ * \brief measures the control and audio latencies of the player end to end
+ *
+ * plays a synthetic sound file repeatedly through the playback pipeline with
+ * the real device stream. The key presses come from a scripted control device
+ * (start immediately, pause after 0.4 ... 0.8 s, resume 0.3 s later), the
+ * harness receives the timestamps of the output stream as its sink.
+ *
+ * measured per trial:
+ * - play to sound: call of play until the first sample reaches the DAC
+ * - key detection: scripted key press until the player has seen it
+ * - pause to silence: key press until the stream has stopped
+ * - resume to sound: key press until the next sample reaches the DAC
+ * - block jitter: deviation of the block write intervals from the block duration
+ */
+class CLatencyHarness: public CAudioOutSink {
+public:
+	enum METRICS {
+		LAT_PLAY_TO_SOUND,
+		LAT_KEY_DETECT,
+		LAT_PAUSE_TO_SILENCE,
+		LAT_RESUME_TO_SOUND,
+		LAT_BLOCK_JITTER,
+		LAT_NUM
+	};
+	/**
+	 * \brief distribution of a metric [s]
+	 */
+	struct PERCENTILES {
+		unsigned long count;
+		double p50;
+		double p90;
+		double p99;
+		double max;
+	};
+
+private:
+	/**
+	 * timestamps of the output stream during a trial
+	 */
+	struct BLOCKSTAMP {
+		double tWritten;
+		double tDac;
+		double duration;
+	};
+	struct STATESTAMP {
+		bool running;
+		double t;
+	};
+	deque<BLOCKSTAMP> m_blocks;
+	deque<STATESTAMP> m_states;
+	double m_fs;
+
+	/**
+	 * measured values of all trials per metric [s]
+	 */
+	deque<double> m_values[LAT_NUM];
+	CBlockPool *m_pPool;
+	string m_tmpDir;
+
+public:
+	/**
+	 * \param pPool [in] pool of the block buffers
+	 * \param tmpDir [in] directory for the temporary sound file (with trailing separator or empty)
+	 */
+	CLatencyHarness(CBlockPool *pPool, string tmpDir = "");
+
+	/**
+	 * \brief runs the trials (needs an audio output device)
+	 * \param numTrials [in] number of playbacks
+	 */
+	void run(int numTrials);
+
+	PERCENTILES getPercentiles(METRICS metric);
+
+	/**
+	 * \return percentiles of all metrics as text [ms]
+	 */
+	string getResultStr();
+
+	/**
+	 * \return percentiles of all metrics as JSON document [ms]
+	 */
+	string getJSON();
+
+	/**
+	 * INTERFACE of CAudioOutSink
+	 */
+	void blockWritten(const float *pBuffer, int noFrames, double tWritten,
+			double tDac);
+	void streamStateChanged(bool running, double t);
+
+private:
+	/**
+	 * \brief evaluates the timestamps of a trial
+	 * \param tPlay [in] time at which play was called
+	 * \param pDev [in] scripted control device of the trial
+	 */
+	void _evaluateTrial(double tPlay, CScriptedCVDevice *pDev);
+
+	/**
+	 * \return name of a metric
+	 */
+	static const char* _getName(METRICS metric);
+};
+
+#endif /* CLATENCYHARNESS_H_ */
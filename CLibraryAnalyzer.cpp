@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <dirent.h>
+#include <SKSLib.h>
+#include "CFile.h"
+#include "CLibraryAnalyzer.h"
+#include "CRenderCache.h"
+#include "CTrace.h"
+
+/*
+ * lets the calling thread run only on otherwise idle cores (as far as the
+ * scheduler supports it)
+ */
+static void lowerPriority() {
+	struct sched_param sp;
+#ifdef SCHED_IDLE
+	sp.sched_priority = 0;
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+#else
+	int policy;
+	pthread_getschedparam(pthread_self(), &policy, &sp);
+	sp.sched_priority = sched_get_priority_min(policy);
+	pthread_setschedparam(pthread_self(), policy, &sp);
+#endif
+}
+
+CLibraryAnalyzer::CLibraryAnalyzer() {
+	m_next = 0;
+	m_numAnalyzed = 0;
+	m_numCurrent = 0;
+	m_numFailed = 0;
+	m_numThreads = 0;
+	m_numRunning = 0;
+	m_nextWorker = 0;
+	m_stop = false;
+	m_streamActive = false;
+	pthread_mutex_init(&m_mut, 0);
+	pthread_cond_init(&m_cond, 0);
+}
+
+CLibraryAnalyzer::~CLibraryAnalyzer() {
+	stop();
+	pthread_mutex_destroy(&m_mut);
+	pthread_cond_destroy(&m_cond);
+}
+
+void CLibraryAnalyzer::start(string dir, string ext, int numThreads) {
+	stop();
+
+	DIR *dp = opendir(dir.c_str());
+	if (dp == NULL)
+		throw CException(CException::SRC_File, LIB_E_NODIR,
+				"Could not open folder." + dir);
+	m_files.clear();
+	dirent *entry;
+	while ((entry = readdir(dp))) {
+		string file = entry->d_name;
+		if ((file.size() >= ext.size())
+				&& (file.compare(file.size() - ext.size(), ext.size(), ext) == 0))
+			m_files.push_back(dir + file);
+	}
+	closedir(dp);
+
+	m_next = 0;
+	m_numAnalyzed = 0;
+	m_numCurrent = 0;
+	m_numFailed = 0;
+	m_nextWorker = 0;
+	m_stop = false;
+
+	// the idle cores: all but the one of the player
+	if (numThreads <= 0)
+		numThreads = thread::hardware_concurrency() - 1;
+	if (numThreads <= 0)
+		numThreads = 1;
+	if (numThreads > LIB_MAXTHREADS)
+		numThreads = LIB_MAXTHREADS;
+	if (numThreads > (int) (m_files.size() + m_priority.size()))
+		numThreads = m_files.size() + m_priority.size();
+	m_numThreads = 0;
+	m_numRunning = numThreads;
+	for (int t = 0; t < numThreads; t++) {
+		if (pthread_create(&m_threads[t], NULL, workerThreadHandler, (void*) this) != 0) {
+			m_numRunning -= numThreads - t;		// the others do the work
+			break;
+		}
+		m_numThreads++;
+	}
+}
+
+void CLibraryAnalyzer::stop() {
+	pthread_mutex_lock(&m_mut);
+	m_stop = true;
+	pthread_cond_broadcast(&m_cond);
+	pthread_mutex_unlock(&m_mut);
+	for (int t = 0; t < m_numThreads; t++)
+		pthread_join(m_threads[t], NULL);
+	m_numThreads = 0;
+	m_numRunning = 0;
+}
+
+void CLibraryAnalyzer::prioritize(string path) {
+	pthread_mutex_lock(&m_mut);
+	if (find(m_priority.begin(), m_priority.end(), path) == m_priority.end())
+		m_priority.push_back(path);
+	// all workers have finished (they count themselves under the mutex): one is
+	// started again, as worker 0 it goes on throttled during a playback
+	if ((m_numRunning.load() == 0) && !m_stop) {
+		for (int t = 0; t < m_numThreads; t++)
+			pthread_join(m_threads[t], NULL);
+		m_numThreads = 0;
+		m_nextWorker = 0;
+		m_numRunning = 1;
+		if (pthread_create(&m_threads[0], NULL, workerThreadHandler, (void*) this) == 0)
+			m_numThreads = 1;
+		else
+			m_numRunning = 0;		// analyzed at the next start()
+	}
+	pthread_mutex_unlock(&m_mut);
+}
+
+bool CLibraryAnalyzer::isRunning() {
+	return m_numRunning.load() > 0;
+}
+
+int CLibraryAnalyzer::getNumFiles() {
+	return m_files.size();
+}
+
+int CLibraryAnalyzer::getNumAnalyzed() {
+	return m_numAnalyzed;
+}
+
+int CLibraryAnalyzer::getNumCurrent() {
+	return m_numCurrent;
+}
+
+int CLibraryAnalyzer::getNumFailed() {
+	return m_numFailed;
+}
+
+string CLibraryAnalyzer::getStateStr() {
+	char buf[256];
+	snprintf(buf, sizeof(buf),
+			"library: %d sound files, %d analyzed, %d up to date, %d failed, %s\n",
+			getNumFiles(), getNumAnalyzed(), getNumCurrent(), getNumFailed(),
+			isRunning() ? "analyzing" : "finished");
+	return buf;
+}
+
+/**
+ * INTERFACE of CAudioOutSink
+ */
+void CLibraryAnalyzer::blockWritten(const float*, int, double, double) {
+	// the state of the stream is enough
+}
+
+void CLibraryAnalyzer::streamStateChanged(bool running, double) {
+	pthread_mutex_lock(&m_mut);
+	m_streamActive = running;
+	if (!running)
+		pthread_cond_broadcast(&m_cond);	// full speed again
+	pthread_mutex_unlock(&m_mut);
+}
+
+bool CLibraryAnalyzer::_analyzeFile(const string &path, int worker,
+		CLoudnessMeter *pLoudness, CAmpMeter *pPeak, CWaveformBuilder *pWaveform) {
+	CSoundFile sfile(path, CSoundFile::FILE_READ);
+	sfile.open();
+	CMetaFile meta(path + META_EXT);
+	CWaveformFile wave(path + WAVE_EXT);
+	if (meta.read() && meta.isCurrent(sfile) && meta.hasValue("duration")
+			&& meta.hasValue("peak") && meta.hasValue("loudness")
+			&& meta.hasValue("truepeak") && CRenderCache::hasContentHash(meta)
+			&& wave.open() && wave.isCurrent(sfile)) {
+		m_numCurrent++;
+		return true;
+	}
+
+	int numChan = sfile.getNumChannels();
+	pLoudness->init(sfile.getSampleRate(), numChan);
+	pWaveform->init(numChan);
+	float peak = 0.f;
+	uint64_t content = RCACHE_FNVBASIS;
+	float *buf = new float[numChan * LIB_BLOCKFRAMES];
+	bool stopped = false;
+	try {
+		int n;
+		do {
+			TRACE_SCOPE("analyze");
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			n = sfile.read(buf, numChan * LIB_BLOCKFRAMES);
+			if (n > 0) {
+				pLoudness->analyze(buf, n / numChan);
+				pWaveform->analyze(buf, n / numChan);
+				peak = fmax(peak, pPeak->getValue(buf, n, numChan));
+				content = CRenderCache::hashSamples(content, buf, n);
+			}
+			double dt = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+			stopped = !_throttle(worker, dt);
+		} while ((n == numChan * LIB_BLOCKFRAMES) && !stopped);
+	} catch (CException &e) {
+		delete[] buf;
+		throw;
+	}
+	delete[] buf;
+	if (stopped)
+		return false;	// incomplete, not stored
+
+	meta.setVersion(sfile);
+	meta.setValue("duration", (double) sfile.getNumFrames() / sfile.getSampleRate());
+	meta.setValue("peak", (peak > 1e-10f) ? 20. * log10(peak) : -200.);
+	meta.setValue("loudness", pLoudness->getIntegratedLoudness());
+	meta.setValue("truepeak", pLoudness->getTruePeak());
+	// key of the render cache: the player doesn't have to read the whole file for it
+	CRenderCache::setContentHash(meta, content);
+	meta.write();
+	pWaveform->finish();
+	wave.close();		// the old pyramid is not needed anymore
+	wave.write(*pWaveform, sfile);
+	m_numAnalyzed++;
+	return true;
+}
+
+bool CLibraryAnalyzer::_throttle(int worker, double dt) {
+	pthread_mutex_lock(&m_mut);
+	if (m_streamActive && (worker == 0)) {
+		// pause for a multiple of the processing time (or until the stream stops)
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		long pause_ns = LIB_THROTTLE * dt * 1e9;
+		ts.tv_sec += pause_ns / 1000000000L;
+		ts.tv_nsec += pause_ns % 1000000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		while (!m_stop && m_streamActive
+				&& (pthread_cond_timedwait(&m_cond, &m_mut, &ts) == 0))
+			;
+	}
+	// the other workers wait until the stream stops
+	while (!m_stop && m_streamActive && (worker != 0))
+		pthread_cond_wait(&m_cond, &m_mut);
+	bool go = !m_stop;
+	pthread_mutex_unlock(&m_mut);
+	return go;
+}
+
+bool CLibraryAnalyzer::_nextFile(string &path) {
+	pthread_mutex_lock(&m_mut);
+	bool found = true;
+	unsigned int i;
+	if (!m_priority.empty()) {
+		path = m_priority.front();
+		m_priority.pop_front();
+	} else if ((i = m_next.fetch_add(1)) < m_files.size())
+		path = m_files[i];
+	else {
+		found = false;
+		m_numRunning--;			// see prioritize()
+	}
+	pthread_mutex_unlock(&m_mut);
+	return found;
+}
+
+void* CLibraryAnalyzer::workerThreadHandler(void *Obj) {
+	CLibraryAnalyzer *pL = (CLibraryAnalyzer*) Obj;
+	TRACE_THREAD("library");
+	lowerPriority();
+	int worker = pL->m_nextWorker.fetch_add(1);
+	// the meters hold large buffers (not on the stack of the thread)
+	CLoudnessMeter *pLoudness = new CLoudnessMeter;
+	CAmpMeter *pPeak = new CAmpMeter;
+	CWaveformBuilder *pWaveform = new CWaveformBuilder;
+
+	string path;
+	bool go = pL->_throttle(worker, 0.), more = true;
+	while (go && (more = pL->_nextFile(path))) {
+		try {
+			go = pL->_analyzeFile(path, worker, pLoudness, pPeak, pWaveform)
+					&& pL->_throttle(worker, 0.);
+		} catch (CException &e) {
+			// e.g. not a sound file or too many channels: analyzed at playback
+			pL->m_numFailed++;
+		}
+	}
+	delete pLoudness;
+	delete pPeak;
+	delete pWaveform;
+	if (more)					// stopped (otherwise counted by _nextFile())
+		pL->m_numRunning--;
+	return NULL;
+}
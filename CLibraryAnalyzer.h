@@ -0,0 +1,193 @@
+#ifndef CLIBRARYANALYZER_H_
+#define CLIBRARYANALYZER_H_
+
+#include <atomic>
+#include <string>
+#include <deque>
+#include <pthread.h>
+using namespace std;
+
+#include "CAudioOutStream.h"
+#include "CLoudnessMeter.h"
+#include "CWaveform.h"
+
+/**
+ * maximum number of worker threads of the library analysis
+ */
+#define LIB_MAXTHREADS 16
+/**
+ * frames per block of the analysis
+ */
+#define LIB_BLOCKFRAMES 16384
+/**
+ * while a stream is playing, one worker goes on and pauses this multiple of
+ * the processing time of each block (i.e. uses 1 / (1 + LIB_THROTTLE) of a core)
+ */
+#define LIB_THROTTLE 9.
+
+/**
+ * \brief analyzes the sound files of a directory in the background
+ *
+ * start() lists the sound files of the directory and returns at once. Worker
+ * threads on the idle cores (at the lowest priority) take the files one after
+ * the other. A file whose metadata file belongs to its current version (see
+ * CMetaFile::isCurrent()) is skipped, all others are read once and their
+ *
+ * - duration [s]
+ * - sample peak [dBFS]
+ * - integrated loudness [LUFS] and true peak [dBTP] (CLoudnessMeter)
+ * - hash of the contents (key of the render cache, see CRenderCache)
+ *
+ * are stored in their metadata file, the waveform overview (min/max/rms
+ * pyramid, see CWaveformBuilder) in their waveform file. The player then finds
+ * the analysis results when the user selects or plays a sound file.
+ *
+ * Files the player needs before the analyzer has reached them (see prioritize())
+ * are taken first.
+ *
+ * The library analyzer is the sink of the output stream: while the stream is
+ * playing, all workers but one wait and the remaining one throttles itself
+ * (see LIB_THROTTLE), so the analysis doesn't compete with the playback.
+ */
+class CLibraryAnalyzer: public CAudioOutSink {
+public:
+	enum LIB_ERROR {
+		LIB_E_NODIR
+	};
+
+private:
+	/**
+	 * paths of the sound files (not changed while the workers run)
+	 */
+	deque<string> m_files;
+	/**
+	 * index of the next file to be taken by a worker
+	 */
+	atomic<unsigned int> m_next;
+	/**
+	 * files moved to the front by prioritize() (protected by the mutex)
+	 */
+	deque<string> m_priority;
+	/**
+	 * number of files analyzed, already up to date and failed
+	 */
+	atomic<int> m_numAnalyzed;
+	atomic<int> m_numCurrent;
+	atomic<int> m_numFailed;
+
+	pthread_t m_threads[LIB_MAXTHREADS];
+	int m_numThreads;
+	/**
+	 * number of workers that haven't finished yet, next worker id
+	 */
+	atomic<int> m_numRunning;
+	atomic<int> m_nextWorker;
+
+	/**
+	 * stop request and state of the output stream (protected by the mutex, the
+	 * workers wait on the condition while they are throttled)
+	 */
+	bool m_stop;
+	bool m_streamActive;
+	pthread_mutex_t m_mut;
+	pthread_cond_t m_cond;
+
+public:
+	CLibraryAnalyzer();
+	/**
+	 * stops the workers
+	 */
+	~CLibraryAnalyzer();
+
+	/**
+	 * \brief starts the analysis of a directory (returns at once)
+	 *
+	 * an analysis that is still running is stopped first
+	 *
+	 * \param dir [in] directory of the sound files (with trailing separator)
+	 * \param ext [in] extension of the sound files
+	 * \param numThreads [in] number of worker threads (0: all cores but one)
+	 */
+	void start(string dir, string ext, int numThreads = 0);
+
+	/**
+	 * \brief stops the workers (the file being analyzed is analyzed again next time)
+	 */
+	void stop();
+
+	/**
+	 * \brief lets the workers analyze a sound file next (returns at once)
+	 *
+	 * used by the player for a file without current metadata instead of
+	 * analyzing it before the playback. If all workers have finished, a worker
+	 * is started for the file (unless the analysis has been stopped).
+	 *
+	 * \param path [in] path of the sound file
+	 */
+	void prioritize(string path);
+
+	/**
+	 * \return true while files are being analyzed
+	 */
+	bool isRunning();
+
+	int getNumFiles();
+	int getNumAnalyzed();
+	int getNumCurrent();
+	int getNumFailed();
+
+	/**
+	 * \return progress of the analysis as text
+	 */
+	string getStateStr();
+
+	/**
+	 * INTERFACE of CAudioOutSink
+	 */
+	void blockWritten(const float *pBuffer, int noFrames, double tWritten,
+			double tDac);
+	/**
+	 * throttles the workers while the stream is running
+	 */
+	void streamStateChanged(bool running, double t);
+
+private:
+	/**
+	 * \brief analyzes a sound file unless its metadata is up to date
+	 *
+	 * \param path [in] path of the sound file
+	 * \param worker [in] id of the calling worker
+	 * \param pLoudness [in] loudness meter of the worker
+	 * \param pPeak [in] amplitude meter of the worker (peak mode)
+	 * \param pWaveform [in] waveform builder of the worker
+	 * \return false if the analysis has been stopped
+	 */
+	bool _analyzeFile(const string &path, int worker, CLoudnessMeter *pLoudness,
+			CAmpMeter *pPeak, CWaveformBuilder *pWaveform);
+
+	/**
+	 * \brief waits or pauses the worker while a stream is playing
+	 *
+	 * \param worker [in] id of the calling worker (worker 0 goes on throttled)
+	 * \param dt [in] processing time of the last block [s]
+	 * \return false if the analysis is to be stopped
+	 */
+	bool _throttle(int worker, double dt);
+
+	/**
+	 * \brief takes the next file of a worker, prioritized files first
+	 *
+	 * \param path [out] path of the sound file
+	 * \return false if there is no file left (the worker is counted as finished)
+	 */
+	bool _nextFile(string &path);
+
+	/**
+	 * \brief thread function of the workers, takes files until all are taken
+	 *
+	 * \param Obj pointer on the instance
+	 */
+	static void* workerThreadHandler(void *Obj);
+};
+
+#endif /* CLIBRARYANALYZER_H_ */
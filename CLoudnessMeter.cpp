@@ -0,0 +1,302 @@
+#include <math.h>
+#include <string.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <SKSLib.h>
+#include "CFile.h"
+#include "CLoudnessMeter.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * true peak reported for digital silence [dBTP]
+ */
+#define LOUD_MINDB -200.
+
+#ifdef __SSE__
+/*
+ * K-weighting of one sample of four channels (transposed direct form II),
+ * adds the square of the output to acc
+ */
+static inline void kWeightStep(__m128 x, const __m128 *c, __m128 &z1, __m128 &z2,
+		__m128 &w1, __m128 &w2, __m128 &acc) {
+	__m128 y = _mm_add_ps(_mm_mul_ps(c[0], x), z1);
+	z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c[1], x), _mm_mul_ps(c[3], y)), z2);
+	z2 = _mm_sub_ps(_mm_mul_ps(c[2], x), _mm_mul_ps(c[4], y));
+	__m128 v = _mm_add_ps(_mm_mul_ps(c[5], y), w1);
+	w1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c[6], y), _mm_mul_ps(c[8], v)), w2);
+	w2 = _mm_sub_ps(_mm_mul_ps(c[7], y), _mm_mul_ps(c[9], v));
+	acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+}
+#endif
+
+CLoudnessMeter::CLoudnessMeter() {
+	init(48000, 1);			// mono at 48 kHz until the first init()
+}
+
+void CLoudnessMeter::init(int fs, int numChan) {
+	if ((fs <= 0) || (numChan < 1) || (numChan > LOUD_MAXCHANNELS))
+		throw CException(CException::SRC_Filter, LOUD_E_PARAMS,
+				"Invalid sample rate or number of channels for the loudness measurement.");
+	m_fs = fs;
+	m_numChan = numChan;
+
+	/*
+	 * K-weighting (BS.1770-4, coefficients given for 48 kHz): the analog
+	 * prototypes of both stages are transformed for the sample rate
+	 */
+	double K = tan(M_PI * 1681.974450955533 / fs);
+	double Q = 0.7071752369554196;
+	double Vh = pow(10., 3.999843853973347 / 20.);
+	double Vb = pow(Vh, 0.4996667741545416);
+	double a0 = 1. + K / Q + K * K;
+	m_coeffs[0] = (Vh + Vb * K / Q + K * K) / a0;
+	m_coeffs[1] = 2. * (K * K - Vh) / a0;
+	m_coeffs[2] = (Vh - Vb * K / Q + K * K) / a0;
+	m_coeffs[3] = 2. * (K * K - 1.) / a0;
+	m_coeffs[4] = (1. - K / Q + K * K) / a0;
+	K = tan(M_PI * 38.13547087602444 / fs);
+	Q = 0.5003270373238773;
+	a0 = 1. + K / Q + K * K;
+	m_coeffs[5] = 1.f;
+	m_coeffs[6] = -2.f;
+	m_coeffs[7] = 1.f;
+	m_coeffs[8] = 2. * (K * K - 1.) / a0;
+	m_coeffs[9] = (1. - K / Q + K * K) / a0;
+
+	// channel weights: L R C (LFE) Ls Rs for 5 and 6 channels
+	for (int ch = 0; ch < LOUD_MAXCHANNELS; ch++)
+		m_weights[ch] = 1.f;
+	if (numChan == 5)
+		m_weights[3] = m_weights[4] = 1.41f;
+	if (numChan == 6) {
+		m_weights[3] = 0.f;
+		m_weights[4] = m_weights[5] = 1.41f;
+	}
+
+	memset(m_state, 0, sizeof(m_state));
+	memset(m_squares, 0, sizeof(m_squares));
+	m_stepFrames = lround(LOUD_STEP * fs);
+	m_stepPos = 0;
+	m_numSteps = 0;
+	m_blocks.clear();
+	m_momentary = LOUD_ABSGATE;
+	m_truePeak = 0.f;
+	m_tpMeter.setMeterMode(CAmpMeter::METER_MODE_TRUEPEAK);	// new history
+}
+
+void CLoudnessMeter::analyze(float *buf, long frames) {
+	if (NULL == buf)
+		throw CException(CException::SRC_Filter, LOUD_E_PARAMS, "Invalid data buffer.");
+	if (frames <= 0)
+		return;
+	m_truePeak = fmax(m_truePeak, m_tpMeter.getValue(buf, frames * m_numChan, m_numChan));
+
+	// the buffer is split at the ends of the steps
+	long done = 0;
+	while (done < frames) {
+		long n = m_stepFrames - m_stepPos;
+		if (n > frames - done)
+			n = frames - done;
+		_filter(buf + done * m_numChan, n);
+		m_stepPos += n;
+		done += n;
+		if (m_stepPos == m_stepFrames)
+			_endStep();
+	}
+}
+
+double CLoudnessMeter::getIntegratedLoudness() {
+	if (m_blocks.empty())
+		return LOUD_ABSGATE;
+	// relative gate from the blocks above the absolute gate
+	double sum = 0.;
+	for (unsigned int i = 0; i < m_blocks.size(); i++)
+		sum += m_blocks[i];
+	double gate = -0.691 + 10. * log10(sum / m_blocks.size()) + LOUD_RELGATE;
+	double zGate = pow(10., (gate + 0.691) / 10.);
+
+	sum = 0.;
+	unsigned long n = 0;
+	for (unsigned int i = 0; i < m_blocks.size(); i++)
+		if (m_blocks[i] > zGate) {
+			sum += m_blocks[i];
+			n++;
+		}
+	if (n == 0)
+		return LOUD_ABSGATE;
+	return -0.691 + 10. * log10(sum / n);
+}
+
+double CLoudnessMeter::getMomentaryLoudness() {
+	return m_momentary;
+}
+
+double CLoudnessMeter::getTruePeak() {
+	return (m_truePeak > 1e-10f) ? 20. * log10(m_truePeak) : LOUD_MINDB;
+}
+
+LOUDNESSINFO CLoudnessMeter::analyzeFile(string path) {
+	CSoundFile sfile(path, CSoundFile::FILE_READ);
+	sfile.open();
+	int numChan = sfile.getNumChannels();
+	CLoudnessMeter meter;
+	meter.init(sfile.getSampleRate(), numChan);
+
+	float *buf = new float[numChan * LOUD_READFRAMES];
+	try {
+		int n;
+		while ((n = sfile.read(buf, numChan * LOUD_READFRAMES)) > 0)
+			meter.analyze(buf, n / numChan);
+	} catch (CException &e) {
+		delete[] buf;
+		throw;
+	}
+	delete[] buf;
+
+	LOUDNESSINFO info;
+	info.loudness = meter.getIntegratedLoudness();
+	info.truePeak = meter.getTruePeak();
+	return info;
+}
+
+bool CLoudnessMeter::loadInfo(string path, LOUDNESSINFO &info) {
+	CSoundFile sfile(path, CSoundFile::FILE_READ);
+	sfile.open();
+	CMetaFile meta(path + META_EXT, CMetaFile::FILE_READ);
+	if ((meta.read() == 0) || !meta.isCurrent(sfile))
+		return false;
+	if (!meta.hasValue("loudness") || !meta.hasValue("truepeak"))
+		return false;
+	info.loudness = meta.getValue("loudness");
+	info.truePeak = meta.getValue("truepeak");
+	return true;
+}
+
+void CLoudnessMeter::storeInfo(string path, const LOUDNESSINFO &info) {
+	CSoundFile sfile(path, CSoundFile::FILE_READ);
+	sfile.open();
+	CMetaFile meta(path + META_EXT);
+	meta.read();
+	meta.setVersion(sfile);		// other metadata of the same version is kept
+	meta.setValue("loudness", info.loudness);
+	meta.setValue("truepeak", info.truePeak);
+	meta.write();
+}
+
+LOUDNESSINFO CLoudnessMeter::getFileInfo(string path, bool *pAnalyzed) {
+	LOUDNESSINFO info;
+	bool analyzed = !loadInfo(path, info);
+	if (analyzed) {
+		info = analyzeFile(path);
+		try {
+			storeInfo(path, info);
+		} catch (CException &e) {
+			// not stored (e.g. read-only directory): analyzed again next time
+		}
+	}
+	if (pAnalyzed)
+		*pAnalyzed = analyzed;
+	return info;
+}
+
+float CLoudnessMeter::getNormalizationGain(const LOUDNESSINFO &info, double target,
+		double ceiling) {
+	if (info.loudness <= LOUD_ABSGATE)
+		return 1.f;				// silence
+	double gain_dB = target - info.loudness;
+	if (info.truePeak + gain_dB > ceiling)
+		gain_dB = ceiling - info.truePeak;
+	return pow(10., gain_dB / 20.);
+}
+
+void CLoudnessMeter::applyGain(float *buf, long n, float gain) {
+	long i = 0;
+#ifdef __SSE__
+	__m128 g = _mm_set1_ps(gain);
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+		_mm_storeu_ps(buf + i + 4, _mm_mul_ps(_mm_loadu_ps(buf + i + 4), g));
+	}
+#endif
+	for (; i < n; i++)
+		buf[i] *= gain;
+}
+
+void CLoudnessMeter::_filter(const float *buf, long frames) {
+	const float *c = m_coeffs;
+	long n = frames * m_numChan;
+	int g = 0;
+#ifdef __SSE__
+	/*
+	 * four channels per vector: while a whole vector can be loaded, the lanes
+	 * behind the last channel are filtered, too (their results are ignored)
+	 */
+	__m128 cv[10];
+	for (int k = 0; k < 10; k++)
+		cv[k] = _mm_set1_ps(c[k]);
+	for (; g < m_numChan; g += 4) {
+		__m128 z1 = _mm_loadu_ps(&m_state[0][g]), z2 = _mm_loadu_ps(&m_state[1][g]);
+		__m128 w1 = _mm_loadu_ps(&m_state[2][g]), w2 = _mm_loadu_ps(&m_state[3][g]);
+		__m128 acc = _mm_setzero_ps();
+		long f = 0, i = g;
+		for (; (f < frames) && (i + 4 <= n); f++, i += m_numChan)
+			kWeightStep(_mm_loadu_ps(buf + i), cv, z1, z2, w1, w2, acc);
+		for (; f < frames; f++, i += m_numChan) {		// end of the buffer
+			float x[4] = { 0.f, 0.f, 0.f, 0.f };
+			for (int l = 0; (l < 4) && (i + l < n); l++)
+				x[l] = buf[i + l];
+			kWeightStep(_mm_loadu_ps(x), cv, z1, z2, w1, w2, acc);
+		}
+		_mm_storeu_ps(&m_state[0][g], z1);
+		_mm_storeu_ps(&m_state[1][g], z2);
+		_mm_storeu_ps(&m_state[2][g], w1);
+		_mm_storeu_ps(&m_state[3][g], w2);
+		_mm_storeu_ps(&m_squares[g], _mm_add_ps(_mm_loadu_ps(&m_squares[g]), acc));
+	}
+#endif
+	for (int ch = g; ch < m_numChan; ch++) {
+		float z1 = m_state[0][ch], z2 = m_state[1][ch];
+		float w1 = m_state[2][ch], w2 = m_state[3][ch];
+		float acc = 0.f;
+		for (long i = ch; i < n; i += m_numChan) {
+			float x = buf[i];
+			float y = c[0] * x + z1;
+			z1 = c[1] * x - c[3] * y + z2;
+			z2 = c[2] * x - c[4] * y;
+			float v = c[5] * y + w1;
+			w1 = c[6] * y - c[8] * v + w2;
+			w2 = c[7] * y - c[9] * v;
+			acc += v * v;
+		}
+		m_state[0][ch] = z1;
+		m_state[1][ch] = z2;
+		m_state[2][ch] = w1;
+		m_state[3][ch] = w2;
+		m_squares[ch] += acc;
+	}
+}
+
+void CLoudnessMeter::_endStep() {
+	double e = 0.;
+	for (int ch = 0; ch < m_numChan; ch++)
+		e += m_weights[ch] * m_squares[ch];
+	memset(m_squares, 0, sizeof(m_squares));
+	m_steps[m_numSteps % LOUD_STEPSPERBLOCK] = e;
+	m_numSteps++;
+	m_stepPos = 0;
+	if (m_numSteps < LOUD_STEPSPERBLOCK)
+		return;					// the first block isn't complete yet
+
+	double z = 0.;
+	for (int s = 0; s < LOUD_STEPSPERBLOCK; s++)
+		z += m_steps[s];
+	z /= LOUD_STEPSPERBLOCK * m_stepFrames;
+	m_momentary = (z > 0.) ? -0.691 + 10. * log10(z) : LOUD_MINDB;
+	if (m_momentary > LOUD_ABSGATE)
+		m_blocks.push_back(z);
+}
@@ -0,0 +1,201 @@
+#ifndef CLOUDNESSMETER_H_
+#define CLOUDNESSMETER_H_
+
+#include <string>
+#include <deque>
+using namespace std;
+
+#include "CAmpMeter.h"
+
+/**
+ * maximum number of channels of a loudness measurement
+ */
+#define LOUD_MAXCHANNELS CAMP_MAXCHANNELS
+/**
+ * gating blocks: step [s] and steps per block (400 ms blocks, 75% overlap)
+ */
+#define LOUD_STEP 0.1
+#define LOUD_STEPSPERBLOCK 4
+/**
+ * absolute gate [LUFS] and relative gate [LU] of the integrated loudness
+ * (the integrated loudness of a file without any block above the absolute
+ * gate is LOUD_ABSGATE)
+ */
+#define LOUD_ABSGATE -70.
+#define LOUD_RELGATE -10.
+/**
+ * default target loudness of the normalization [LUFS] (EBU R128) and maximum
+ * true peak after the normalization [dBTP]
+ */
+#define LOUD_TARGET -23.
+#define LOUD_PEAKCEILING -1.
+/**
+ * frames per block of the file analysis
+ */
+#define LOUD_READFRAMES 16384
+
+/**
+ * \brief loudness and true peak of a sound file
+ */
+struct LOUDNESSINFO {
+	double loudness;	// integrated loudness [LUFS]
+	double truePeak;	// maximum true peak of all channels [dBTP]
+};
+
+/**
+ * \brief streaming loudness measurement according to ITU-R BS.1770-4 / EBU R128
+ *
+ * - K-weighting of each channel (high shelf and high pass biquad, coefficients
+ *   for any sample rate)
+ * - mean square of each channel in gating blocks of 400 ms every 100 ms,
+ *   weighted sum of the channels (surround channels +1.5 dB, LFE ignored)
+ * - integrated loudness of the blocks above the absolute gate and above the
+ *   relative gate (10 LU below the loudness of the former)
+ * - true peak by the 4x oversampling interpolator of the amplitude meter
+ *
+ * With SSE, the biquads filter four channels at a time (one channel per lane).
+ *
+ * The analysis of a whole sound file is stored in its metadata file (see
+ * CMetaFile), so the playback only reads the normalization gain and doesn't
+ * analyze anything.
+ */
+class CLoudnessMeter {
+public:
+	enum LOUD_ERROR {
+		LOUD_E_PARAMS
+	};
+
+private:
+	int m_fs;
+	int m_numChan;
+	/**
+	 * K-weighting: b0, b1, b2, a1, a2 of the shelf and of the high pass
+	 */
+	float m_coeffs[10];
+	/**
+	 * filter states (z1, z2 of both biquads) and squared sums of the current
+	 * step per channel
+	 */
+	float m_state[4][LOUD_MAXCHANNELS];
+	float m_squares[LOUD_MAXCHANNELS];
+	/**
+	 * channel weights
+	 */
+	float m_weights[LOUD_MAXCHANNELS];
+
+	/**
+	 * frames per step, frames of the current step, weighted energy of the last
+	 * steps (ring) and number of steps
+	 */
+	long m_stepFrames;
+	long m_stepPos;
+	double m_steps[LOUD_STEPSPERBLOCK];
+	unsigned long m_numSteps;
+	/**
+	 * mean square of all gating blocks above the absolute gate
+	 */
+	deque<double> m_blocks;
+	double m_momentary;
+
+	/**
+	 * true peak (amplitude meter in true peak mode) and maximum so far
+	 */
+	CAmpMeter m_tpMeter;
+	float m_truePeak;
+
+public:
+	CLoudnessMeter();
+
+	/**
+	 * \brief prepares a new measurement
+	 * \param fs [in] sample rate
+	 * \param numChan [in] number of interleaved channels (up to LOUD_MAXCHANNELS)
+	 */
+	void init(int fs, int numChan);
+
+	/**
+	 * \brief adds a buffer to the measurement
+	 * \param buf [in] interleaved samples
+	 * \param frames [in] number of frames
+	 */
+	void analyze(float *buf, long frames);
+
+	/**
+	 * \return integrated loudness of all buffers so far [LUFS]
+	 */
+	double getIntegratedLoudness();
+
+	/**
+	 * \return loudness of the last gating block (momentary loudness) [LUFS]
+	 */
+	double getMomentaryLoudness();
+
+	/**
+	 * \return maximum true peak of all buffers so far [dBTP]
+	 */
+	double getTruePeak();
+
+	/**
+	 * \brief analyzes a whole sound file
+	 * \param path [in] path of the sound file
+	 * \return loudness and true peak
+	 */
+	static LOUDNESSINFO analyzeFile(string path);
+
+	/**
+	 * \brief reads the loudness of a sound file from its metadata file
+	 *
+	 * \param path [in] path of the sound file
+	 * \param info [out] loudness and true peak
+	 * \return false if there is no metadata or it belongs to another version
+	 * of the file (see CMetaFile::isCurrent())
+	 */
+	static bool loadInfo(string path, LOUDNESSINFO &info);
+
+	/**
+	 * \brief stores the loudness of a sound file in its metadata file
+	 */
+	static void storeInfo(string path, const LOUDNESSINFO &info);
+
+	/**
+	 * \brief reads the loudness of a sound file from its metadata file or
+	 * analyzes and stores it
+	 *
+	 * \param path [in] path of the sound file
+	 * \param pAnalyzed [out] true if the file had to be analyzed (optional)
+	 * \return loudness and true peak
+	 */
+	static LOUDNESSINFO getFileInfo(string path, bool *pAnalyzed = NULL);
+
+	/**
+	 * \brief gain that brings a sound file to the target loudness
+	 *
+	 * the gain is limited so the true peak stays below the ceiling, silent files
+	 * (below the absolute gate) are not amplified
+	 *
+	 * \param info [in] loudness and true peak of the file
+	 * \param target [in] target loudness [LUFS]
+	 * \param ceiling [in] maximum true peak after the gain [dBTP]
+	 * \return linear gain
+	 */
+	static float getNormalizationGain(const LOUDNESSINFO &info,
+			double target = LOUD_TARGET, double ceiling = LOUD_PEAKCEILING);
+
+	/**
+	 * \brief buf[i] *= gain for i = 0 ... n-1
+	 */
+	static void applyGain(float *buf, long n, float gain);
+
+private:
+	/**
+	 * \brief K-weights a part of a step and adds the squares per channel
+	 */
+	void _filter(const float *buf, long frames);
+
+	/**
+	 * \brief ends the current step and adds the gating block that ends with it
+	 */
+	void _endStep();
+};
+
+#endif /* CLOUDNESSMETER_H_ */
@@ -0,0 +1,33 @@
+#include <string.h>
+#include "CMeterBuffer.h"
+
+/**
+ * flag of m_middle: the middle slot holds a new snapshot
+ */
+#define METERBUF_FRESH 4
+#define METERBUF_INDEX 3
+
+CMeterBuffer::CMeterBuffer() {
+	memset(m_slots, 0, sizeof(m_slots));
+	m_write = 0;
+	m_middle = 1;
+	m_read = 2;
+	m_seq = 0;
+}
+
+void CMeterBuffer::publish(const METERSNAPSHOT &snap) {
+	m_slots[m_write] = snap;
+	m_slots[m_write].seq = ++m_seq;
+	// release: the consumer sees the snapshot together with the index
+	m_write = m_middle.exchange(m_write | METERBUF_FRESH, memory_order_acq_rel)
+			& METERBUF_INDEX;
+}
+
+bool CMeterBuffer::take(METERSNAPSHOT &snap) {
+	if ((m_middle.load(memory_order_relaxed) & METERBUF_FRESH) == 0)
+		return false;
+	// only the consumer clears the flag, so the exchange returns a fresh slot
+	m_read = m_middle.exchange(m_read, memory_order_acq_rel) & METERBUF_INDEX;
+	snap = m_slots[m_read];
+	return true;
+}
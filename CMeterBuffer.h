@@ -0,0 +1,99 @@
+#ifndef CMETERBUFFER_H_
+#define CMETERBUFFER_H_
+
+#include <atomic>
+using namespace std;
+
+/**
+ * maximum number of channels, of envelope points per channel and of envelope
+ * points of all channels of a snapshot
+ */
+#define METER_MAXCHANNELS 32
+#define METER_MAXPOINTS 64
+#define METER_MAXVALUES 512
+
+/**
+ * \brief meter values of a block, published by the audio path for the visualizer
+ */
+struct METERSNAPSHOT {
+	/**
+	 * number of the snapshot (counts the published snapshots)
+	 */
+	unsigned long seq;
+	/**
+	 * number of metered channels
+	 */
+	int numChannels;
+	/**
+	 * envelope per channel at the end of the block (see CAmpMeter::METER_MODE)
+	 */
+	float value[METER_MAXCHANNELS];
+	/**
+	 * peak hold value per channel at the end of the block
+	 */
+	float hold[METER_MAXCHANNELS];
+	/**
+	 * envelope over the block: maximum of each interval of pointDur seconds,
+	 * points[i * numChannels + ch] for point i of channel ch
+	 */
+	float points[METER_MAXVALUES];
+	int numPoints;
+	double pointDur;
+	/**
+	 * spectrum mode: no envelope, the block has been appended to the analyzer
+	 * of the meter up to position ringPos (see CSpectrumAnalyzer::write())
+	 */
+	bool spectrum;
+	unsigned long ringPos;
+	int fs;
+	/**
+	 * number of frames of the block
+	 */
+	long frames;
+};
+
+/**
+ * \brief wait-free triple buffer of meter snapshots for one producer and one consumer thread
+ *
+ * The producer (audio path) writes into its own slot and swaps it with the
+ * middle slot, the consumer (visualizer) swaps its slot with the middle slot if
+ * that holds a new snapshot. Neither side ever waits for the other: a snapshot
+ * that hasn't been taken yet is replaced by the next one, the consumer always
+ * gets the latest one.
+ */
+class CMeterBuffer {
+private:
+	METERSNAPSHOT m_slots[3];
+	/**
+	 * index of the middle slot, bit METERBUF_FRESH set if it holds a snapshot the consumer hasn't taken
+	 */
+	atomic<unsigned int> m_middle;
+	/**
+	 * slots owned by the producer and the consumer
+	 */
+	unsigned int m_write;
+	unsigned int m_read;
+	/**
+	 * number of published snapshots (producer)
+	 */
+	unsigned long m_seq;
+
+public:
+	CMeterBuffer();
+
+	/**
+	 * \brief publishes a snapshot (producer, wait-free)
+	 *
+	 * the sequence number of the snapshot is set by the buffer
+	 */
+	void publish(const METERSNAPSHOT &snap);
+
+	/**
+	 * \brief takes the latest snapshot (consumer, wait-free)
+	 * \param snap [out] snapshot
+	 * \return false if no snapshot has been published since the last call
+	 */
+	bool take(METERSNAPSHOT &snap);
+};
+
+#endif /* CMETERBUFFER_H_ */
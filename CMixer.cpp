@@ -0,0 +1,247 @@
+#include <string.h>
+#include <SKSLib.h>
+#include "CMixer.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/*
+ * out[k*ch + c] += x[k*ch + c] * (g0 + k*dg) for frame k = 0 ... frames-1 and
+ * channel c = 0 ... ch-1
+ *
+ * the gain ramp is linear per frame (all channels of a frame get the same gain).
+ * If the channels divide 4, a block can be processed four samples at a time.
+ */
+static void mixRamp(float *out, const float *x, int frames, int ch, float g0,
+		float dg) {
+	int n = frames * ch;
+	int i = 0;
+#ifdef __SSE__
+	if ((ch == 1) || (ch == 2) || (ch == 4)) {
+		// gains of the four samples: frames i/ch ... (i+3)/ch
+		__m128 g = _mm_setr_ps(g0, g0 + (1 / ch) * dg, g0 + (2 / ch) * dg,
+				g0 + (3 / ch) * dg);
+		__m128 step = _mm_set1_ps((4 / ch) * dg);
+		for (; i + 4 <= n; i += 4) {
+			__m128 o = _mm_loadu_ps(out + i);
+			o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(x + i), g));
+			_mm_storeu_ps(out + i, o);
+			g = _mm_add_ps(g, step);
+		}
+	}
+#endif
+	for (int k = i / ch; k < frames; k++) {
+		float g = g0 + k * dg;
+		for (int c = 0; c < ch; c++)
+			out[k * ch + c] += x[k * ch + c] * g;
+	}
+}
+
+CSoundFileSource::CSoundFileSource(const string path, CFilterBase *pFilter,
+		int fsOut, CResampler::QUALITY quality, float dur_block) :
+		m_sfile(path, CSoundFile::FILE_READ) {
+	m_pFilter = pFilter;
+	m_pResampler = NULL;
+	m_pIn = m_pRes = m_pFlt = m_pBlock = NULL;
+	m_blockFrames = m_blockPos = 0;
+	m_eof = false;
+
+	m_sfile.open();
+	m_channels = m_sfile.getNumChannels();
+	if (fsOut == 0)
+		fsOut = m_sfile.getSampleRate();
+
+	m_framesPerBlock = m_sfile.getSampleRate() * dur_block;
+	m_pIn = new float[m_channels * m_framesPerBlock];
+	m_outCapacity = m_framesPerBlock;
+	if (fsOut != m_sfile.getSampleRate()) {
+		m_pResampler = new CResampler(m_sfile.getSampleRate(), fsOut, m_channels,
+				quality);
+		m_outCapacity = m_pResampler->getMaxOutFrames(m_framesPerBlock)
+				+ m_pResampler->getMaxOutFrames(64);
+		m_pRes = new float[m_channels * m_outCapacity];
+	}
+	if (m_pFilter)
+		m_pFlt = new float[m_channels * m_outCapacity];
+}
+
+CSoundFileSource::~CSoundFileSource() {
+	if (m_pFlt)
+		delete[] m_pFlt;
+	if (m_pRes)
+		delete[] m_pRes;
+	if (m_pIn)
+		delete[] m_pIn;
+	if (m_pResampler)
+		delete m_pResampler;
+	if (m_pFilter)
+		delete m_pFilter;
+}
+
+int CSoundFileSource::getNumChannels() {
+	return m_channels;
+}
+
+int CSoundFileSource::getSampleRate() {
+	return m_sfile.getSampleRate();
+}
+
+void CSoundFileSource::_decodeBlock() {
+	int bufsize = m_channels * m_framesPerBlock;
+	int readsize = m_sfile.read(m_pIn, bufsize);
+	m_pBlock = m_pIn;
+	m_blockFrames = readsize / m_channels;
+	m_blockPos = 0;
+
+	if (m_pResampler) {
+		int n = m_pResampler->process(m_pIn, m_blockFrames, m_pRes, m_outCapacity);
+		if (readsize < bufsize)
+			n += m_pResampler->flush(m_pRes + n * m_channels, m_outCapacity - n);
+		m_pBlock = m_pRes;
+		m_blockFrames = n;
+	}
+	if (m_pFilter && m_pFilter->filter(m_pBlock, m_pFlt, m_blockFrames))
+		m_pBlock = m_pFlt;
+	if (readsize < bufsize)
+		m_eof = true;
+}
+
+int CSoundFileSource::read(float *buf, int frames) {
+	int done = 0;
+	while (done < frames) {
+		if (m_blockPos == m_blockFrames) {
+			if (m_eof)
+				break;
+			_decodeBlock();
+			continue;
+		}
+		int n = m_blockFrames - m_blockPos;
+		if (n > frames - done)
+			n = frames - done;
+		memcpy(buf + done * m_channels, m_pBlock + m_blockPos * m_channels,
+				n * m_channels * sizeof(float));
+		m_blockPos += n;
+		done += n;
+	}
+	return done;
+}
+
+CMixer::CMixer(int channels, int maxFrames) {
+	if ((channels <= 0) || (maxFrames <= 0))
+		throw CException(CException::SRC_Filter, MIX_E_PARAMS,
+				"Channels and block size of the mixer must be greater than 0!");
+	m_channels = channels;
+	m_maxFrames = maxFrames;
+	m_scratch = new float[channels * maxFrames];
+	for (int i = 0; i < MIX_MAXSOURCES; i++) {
+		m_slots[i].state = SLOT_FREE;
+		m_slots[i].pSource = NULL;
+		m_slots[i].targetGain = 0.f;
+		m_slots[i].gain = 0.f;
+	}
+}
+
+CMixer::~CMixer() {
+	for (int i = 0; i < MIX_MAXSOURCES; i++) {
+		if (m_slots[i].state.load() != SLOT_FREE)
+			delete m_slots[i].pSource;
+	}
+	delete[] m_scratch;
+}
+
+int CMixer::addSource(CMixerSource *pSource, float gain) {
+	if (pSource == NULL)
+		throw CException(CException::SRC_Filter, MIX_E_PARAMS, "No source.");
+	if (pSource->getNumChannels() != m_channels)
+		throw CException(CException::SRC_Filter, MIX_E_CHANNELS,
+				"The source must have " + to_string(m_channels) + " channels!");
+
+	releaseRetired();
+	for (int i = 0; i < MIX_MAXSOURCES; i++) {
+		if (m_slots[i].state.load(memory_order_acquire) == SLOT_FREE) {
+			m_slots[i].pSource = pSource;
+			m_slots[i].gain = 0.f;			// fade in
+			m_slots[i].targetGain.store(gain, memory_order_relaxed);
+			// publishes source and gain to the audio path
+			m_slots[i].state.store(SLOT_ACTIVE, memory_order_release);
+			return i;
+		}
+	}
+	throw CException(CException::SRC_Filter, MIX_E_FULL,
+			"The mixer can't play more than " + to_string(MIX_MAXSOURCES)
+					+ " sources!");
+}
+
+void CMixer::removeSource(int id) {
+	if ((id < 0) || (id >= MIX_MAXSOURCES))
+		throw CException(CException::SRC_Filter, MIX_E_INVALIDID,
+				"Invalid source id.");
+	int expected = SLOT_ACTIVE;
+	// the audio path may have retired the source in the meantime
+	m_slots[id].state.compare_exchange_strong(expected, SLOT_REMOVING,
+			memory_order_acq_rel);
+}
+
+void CMixer::setGain(int id, float gain) {
+	if ((id < 0) || (id >= MIX_MAXSOURCES))
+		throw CException(CException::SRC_Filter, MIX_E_INVALIDID,
+				"Invalid source id.");
+	m_slots[id].targetGain.store(gain, memory_order_relaxed);
+}
+
+void CMixer::releaseRetired() {
+	for (int i = 0; i < MIX_MAXSOURCES; i++) {
+		if (m_slots[i].state.load(memory_order_acquire) == SLOT_RETIRED) {
+			delete m_slots[i].pSource;
+			m_slots[i].pSource = NULL;
+			m_slots[i].state.store(SLOT_FREE, memory_order_release);
+		}
+	}
+}
+
+int CMixer::getNumActive() {
+	int n = 0;
+	for (int i = 0; i < MIX_MAXSOURCES; i++) {
+		int st = m_slots[i].state.load(memory_order_acquire);
+		if ((st == SLOT_ACTIVE) || (st == SLOT_REMOVING))
+			n++;
+	}
+	return n;
+}
+
+int CMixer::process(float *out, int frames) {
+	if (out == NULL)
+		throw CException(CException::SRC_Filter, MIX_E_NOBUFFER,
+				"Invalid data buffer.");
+	if (frames > m_maxFrames)
+		frames = m_maxFrames;
+
+	int numSamples = frames * m_channels;
+	memset(out, 0, numSamples * sizeof(float));
+
+	int numMixed = 0;
+	for (int i = 0; i < MIX_MAXSOURCES; i++) {
+		SLOT &slot = m_slots[i];
+		int st = slot.state.load(memory_order_acquire);
+		if ((st != SLOT_ACTIVE) && (st != SLOT_REMOVING))
+			continue;
+
+		int n = slot.pSource->read(m_scratch, frames);
+		if (n < frames)
+			memset(m_scratch + n * m_channels, 0,
+					(frames - n) * m_channels * sizeof(float));
+
+		// ramp from the gain of the last block to the target (or to 0 if removed)
+		float target = (st == SLOT_REMOVING) ?
+				0.f : slot.targetGain.load(memory_order_relaxed);
+		float dg = (target - slot.gain) / frames;
+		mixRamp(out, m_scratch, frames, m_channels, slot.gain, dg);
+		slot.gain = target;
+		numMixed++;
+
+		// faded out or end of source: the control thread deletes the source
+		if ((st == SLOT_REMOVING) || (n < frames))
+			slot.state.store(SLOT_RETIRED, memory_order_release);
+	}
+	return numMixed;
+}
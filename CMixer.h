@@ -0,0 +1,196 @@
+#ifndef CMIXER_H_
+#define CMIXER_H_
+
+#include <atomic>
+#include <string>
+using namespace std;
+
+#include "CFile.h"
+#include "CFilter.h"
+#include "CResampler.h"
+
+/**
+ * maximum number of sources played simultaneously by a mixer
+ */
+#define MIX_MAXSOURCES 16
+
+/**
+ * \brief interface of a source of interleaved audio frames for the mixer
+ */
+class CMixerSource {
+public:
+	CMixerSource(){};
+	virtual ~CMixerSource(){};
+
+	/**
+	 * \return number of interleaved channels delivered by read()
+	 */
+	virtual int getNumChannels()=0;
+
+	/**
+	 * \brief delivers the next frames of the source
+	 *
+	 * \param buf [out] buffer for frames*getNumChannels() samples
+	 * \param frames [in] number of frames requested
+	 * \return number of frames delivered (less than frames at the end of the source)
+	 */
+	virtual int read(float *buf, int frames)=0;
+};
+
+/**
+ * \brief source pipeline: sound file, resampler (optional) and filter (optional)
+ *
+ * delivers any number of frames per read() and decodes the sound file block by block
+ */
+class CSoundFileSource: public CMixerSource {
+private:
+	CSoundFile m_sfile;
+	CFilterBase *m_pFilter;
+	CResampler *m_pResampler;
+	int m_channels;
+	/**
+	 * decoded, resampled and filtered block and its read position [frames]
+	 */
+	float *m_pIn;
+	float *m_pRes;
+	float *m_pFlt;
+	float *m_pBlock;
+	int m_blockFrames;
+	int m_blockPos;
+	long m_framesPerBlock;
+	int m_outCapacity;
+	bool m_eof;
+
+public:
+	/**
+	 * \brief opens the sound file and creates the block buffers
+	 *
+	 * \param path [in] path of the sound file
+	 * \param pFilter [in] filter for the output sample rate (the source takes ownership, may be NULL)
+	 * \param fsOut [in] output sample rate (0: sample rate of the sound file)
+	 * \param quality [in] resampling quality
+	 * \param dur_block [in] duration of the decoded blocks in seconds
+	 */
+	CSoundFileSource(const string path, CFilterBase *pFilter = NULL, int fsOut = 0,
+			CResampler::QUALITY quality = CResampler::QUALITY_MEDIUM,
+			float dur_block = 0.125);
+	~CSoundFileSource();
+
+	int getNumChannels();
+	int read(float *buf, int frames);
+
+	/**
+	 * \return sample rate of the sound file
+	 */
+	int getSampleRate();
+
+private:
+	/**
+	 * \brief decodes, resamples and filters the next block
+	 */
+	void _decodeBlock();
+};
+
+/**
+ * \brief mixes up to MIX_MAXSOURCES sources into one output block
+ *
+ * The sources are stored in slots. Sources may be added, removed and their gains changed by
+ * a control thread while another thread (the audio path) calls process(). Both sides only
+ * communicate by atomic slot states, so process() never waits for the control thread.
+ *
+ * Gain changes are ramped linearly over one block. A removed source is faded out within one
+ * block; the audio path marks it as retired and the control thread deletes it later (in
+ * addSource(), releaseRetired() or the destructor).
+ */
+class CMixer {
+public:
+	enum MIX_ERROR {
+		MIX_E_PARAMS, MIX_E_NOBUFFER, MIX_E_FULL, MIX_E_CHANNELS, MIX_E_INVALIDID
+	};
+
+private:
+	/**
+	 * slot states (transitions: FREE -> ACTIVE by the control thread,
+	 * ACTIVE -> REMOVING by the control thread, ACTIVE/REMOVING -> RETIRED by
+	 * the audio path, RETIRED -> FREE by the control thread)
+	 */
+	enum SLOT_STATES {
+		SLOT_FREE, SLOT_ACTIVE, SLOT_REMOVING, SLOT_RETIRED
+	};
+	struct SLOT {
+		atomic<int> state;
+		CMixerSource *pSource;
+		/**
+		 * gain set by the control thread
+		 */
+		atomic<float> targetGain;
+		/**
+		 * gain at the end of the last block (audio path only)
+		 */
+		float gain;
+	};
+
+	SLOT m_slots[MIX_MAXSOURCES];
+	int m_channels;
+	int m_maxFrames;
+	/**
+	 * block buffer for the frames of one source
+	 */
+	float *m_scratch;
+
+public:
+	/**
+	 * \param channels [in] number of interleaved channels of all sources and the output
+	 * \param maxFrames [in] maximum number of frames per process() call
+	 */
+	CMixer(int channels, int maxFrames);
+	/**
+	 * deletes all sources
+	 */
+	~CMixer();
+
+	/**
+	 * \brief adds a source (control thread)
+	 *
+	 * the mixer takes ownership of the source. The source starts with gain 0 and is faded in to
+	 * the given gain during the next block.
+	 *
+	 * \param pSource [in] source with the number of channels of the mixer
+	 * \param gain [in] linear gain
+	 * \return id of the source (slot number)
+	 */
+	int addSource(CMixerSource *pSource, float gain = 1.f);
+
+	/**
+	 * \brief fades out and removes a source (control thread)
+	 */
+	void removeSource(int id);
+
+	/**
+	 * \brief sets the gain of a source (control thread), ramped within the next block
+	 */
+	void setGain(int id, float gain);
+
+	/**
+	 * \brief deletes the sources that have been retired by the audio path (control thread)
+	 */
+	void releaseRetired();
+
+	/**
+	 * \return number of sources that are still playing
+	 */
+	int getNumActive();
+
+	/**
+	 * \brief mixes the next frames of all sources into the output block (audio path)
+	 *
+	 * sources that reach their end are retired.
+	 *
+	 * \param out [out] output block with frames*channels samples
+	 * \param frames [in] number of frames (maxFrames at most)
+	 * \return number of sources that contributed to the block
+	 */
+	int process(float *out, int frames);
+};
+
+#endif /* CMIXER_H_ */
@@ -0,0 +1,514 @@
+#include <chrono>
+#include <stdio.h>
+#include <SKSLib.h>
+#include "CPlaybackPipeline.h"
+#include "CLoudnessMeter.h"
+#include "CTrace.h"
+
+/**
+ * maximum time a stage waits for a block before it checks for an abort [ms]
+ */
+#define PIPE_WAIT_MS 20
+/**
+ * maximum waiting time for the pause key before the end of playback is checked [ms]
+ */
+#define PIPE_KEYPOLL_MS 10
+/**
+ * device period: size of the writes to the stream and interval of the transport command checks [ms]
+ */
+#define PIPE_PERIOD_MS 10
+
+CPlaybackPipeline::CPlaybackPipeline(CAudioOutStream *pStream,
+		CUserInterface *pUI, CBlockPool *pPool) :
+		m_freeQ(PIPE_NUMBLOCKS), m_dspQ(PIPE_NUMBLOCKS), m_outQ(PIPE_NUMBLOCKS), m_meterQ(
+				PIPE_NUMBLOCKS) {
+	m_pStream = pStream;
+	m_pUI = pUI;
+	m_pPool = pPool;
+	m_pSFile = NULL;
+	m_pResampler = NULL;
+	m_pFilter = NULL;
+	m_pSizer = NULL;
+	m_numChan = 0;
+	m_fsOut = 0;
+	m_gain = 1.f;
+	m_framesPerBlock = 0;
+	m_periodFrames = 0;
+	for (int i = 0; i < PIPE_NUMBLOCKS; i++) {
+		m_blocks[i].pData = NULL;
+		m_blocks[i].pWork = NULL;
+		m_blocks[i].capacity = 0;
+	}
+	for (int s = 0; s < STAGE_NUM; s++) {
+		m_threads[s] = pthread_t { };
+		m_timing[s].blocks = 0;
+		m_timing[s].mean = m_timing[s].max = 0.;
+		m_timeSum[s] = 0.;
+	}
+	m_paused = false;
+	m_abort = false;
+	m_finished = false;
+	m_seekFrame = -1;
+	m_epoch = 0;
+	m_decodeDone = false;
+	m_pRecord = NULL;
+	m_recording = false;
+	m_recordComplete = false;
+	m_pNewFilter = NULL;
+	m_filterChanged = false;
+	m_pError = NULL;
+	pthread_mutex_init(&m_errMut, 0);
+}
+
+CPlaybackPipeline::~CPlaybackPipeline() {
+	_releaseBlocks();
+	if (m_pError)
+		delete m_pError;
+	pthread_mutex_destroy(&m_errMut);
+}
+
+void CPlaybackPipeline::_initBlocks(int outCapacity) {
+	_releaseBlocks();
+	// the empty queues are drained, all blocks start in the free queue
+	while (m_freeQ.pop() || m_dspQ.pop() || m_outQ.pop() || m_meterQ.pop())
+		;
+	for (int i = 0; i < PIPE_NUMBLOCKS; i++) {
+		m_blocks[i].capacity = outCapacity;
+		m_blocks[i].pData = m_pPool->acquire(outCapacity * m_numChan);
+		m_blocks[i].pWork = m_pPool->acquire(outCapacity * m_numChan);
+		m_blocks[i].frames = 0;
+		m_blocks[i].last = false;
+		m_blocks[i].epoch = 0;
+		m_blocks[i].inFrames = 0;
+		m_blocks[i].cost = 0.;
+		m_freeQ.push(&m_blocks[i]);
+	}
+}
+
+void CPlaybackPipeline::_releaseBlocks() {
+	for (int i = 0; i < PIPE_NUMBLOCKS; i++) {
+		m_pPool->release(m_blocks[i].pData);
+		m_pPool->release(m_blocks[i].pWork);
+		m_blocks[i].pData = m_blocks[i].pWork = NULL;
+	}
+}
+
+void CPlaybackPipeline::play(CSoundFile *pSFile, CResampler *pResampler,
+		CFilterBase *pFilter, int fsOut, long framesPerBlock, int outCapacity,
+		CBlockSizer *pSizer, float gain) {
+	m_pSFile = pSFile;
+	m_pResampler = pResampler;
+	m_pFilter = pFilter;
+	m_pSizer = pSizer;
+	// the states of an earlier (stopped or seeked) playback or of the block size
+	// calibration would be the start of this one (and of its recording)
+	if (m_pResampler)
+		m_pResampler->reset();
+	if (m_pFilter)
+		m_pFilter->reset();
+	m_numChan = pSFile->getNumChannels();
+	m_fsOut = fsOut;
+	m_gain = gain;
+	m_framesPerBlock = framesPerBlock;
+	for (int s = 0; s < STAGE_NUM; s++) {
+		m_timing[s].blocks = 0;
+		m_timing[s].mean = m_timing[s].max = 0.;
+		m_timeSum[s] = 0.;
+	}
+	m_paused = false;
+	m_abort = false;
+	m_finished = false;
+	m_seekFrame = -1;
+	m_epoch = 0;
+	m_decodeDone = false;
+	m_filterChanged = false;
+	m_recording = (m_pRecord != NULL);
+	m_recordComplete = false;
+	m_transport.clear();	// commands of an earlier playback
+	if (m_pError) {
+		delete m_pError;
+		m_pError = NULL;
+	}
+	_initBlocks(outCapacity);
+
+	// the stream is written in device periods (at most one block)
+	m_periodFrames = (fsOut * PIPE_PERIOD_MS) / 1000;
+	if (m_periodFrames > outCapacity)
+		m_periodFrames = outCapacity;
+	m_pStream->open(m_numChan, fsOut, m_periodFrames);
+	m_pStream->resetStatistics();	// statistics are collected per track
+
+	// decoding and filtering start while the user is asked to press the key
+	bool started[STAGE_NUM];
+	started[STAGE_DECODE] = _startStage(STAGE_DECODE, decodeThreadHandler);
+	started[STAGE_DSP] = started[STAGE_DECODE]
+			&& _startStage(STAGE_DSP, dspThreadHandler);
+
+	try {
+		if (!m_abort.load()) {
+			m_pUI->keyPressed(true);
+			m_pStream->start();
+		}
+	} catch (CException &e) {
+		_setError(e);
+	}
+
+	started[STAGE_OUTPUT] = started[STAGE_DSP]
+			&& _startStage(STAGE_OUTPUT, outputThreadHandler);
+	started[STAGE_METER] = started[STAGE_OUTPUT]
+			&& _startStage(STAGE_METER, meterThreadHandler);
+
+	// the console input thread posts its commands directly, devices that can
+	// only be polled (IOWarrior button) are polled by the calling thread
+	m_pUI->setTransport(&m_transport, pFilter);
+	TRACE_THREAD("control");
+	while (!m_finished.load() && !m_abort.load()) {
+		try {
+			TRACE_SCOPE("keyPoll");
+			if (m_pUI->waitKeyPressed(PIPE_KEYPOLL_MS))
+				m_transport.post(TRANSPORTCMD::CMD_TOGGLE);
+		} catch (CException &e) {
+			_setError(e);
+		}
+	}
+	m_pUI->setTransport(NULL);
+
+	// the stages that have been started end at the abort
+	for (int s = 0; s < STAGE_NUM; s++)
+		if (started[s])
+			pthread_join(m_threads[s], NULL);
+
+	m_pStream->stop();
+	_releaseBlocks();
+
+	if (m_pError) {
+		CException err = *m_pError;
+		delete m_pError;
+		m_pError = NULL;
+		throw err;
+	}
+}
+
+void CPlaybackPipeline::setRecordFile(CSoundFile *pFile) {
+	m_pRecord = pFile;
+}
+
+bool CPlaybackPipeline::isRecordComplete() {
+	return m_recordComplete;
+}
+
+CTransportQueue* CPlaybackPipeline::getTransport() {
+	return &m_transport;
+}
+
+CPlaybackPipeline::STAGETIMING CPlaybackPipeline::getTiming(STAGES stage) {
+	return m_timing[stage];
+}
+
+string CPlaybackPipeline::getTimingStr() {
+	const char *names[STAGE_NUM] = { "decode", "DSP", "output", "meter" };
+	string str = "stage timing [ms] mean/max:";
+	char buf[64];
+	for (int s = 0; s < STAGE_NUM; s++) {
+		snprintf(buf, sizeof(buf), " %s %.3f/%.3f", names[s],
+				m_timing[s].mean * 1000., m_timing[s].max * 1000.);
+		str += buf;
+	}
+	return str + "\n";
+}
+
+void CPlaybackPipeline::_addTiming(STAGES stage, double dt) {
+	STAGETIMING &t = m_timing[stage];
+	m_timeSum[stage] += dt;
+	t.blocks++;
+	t.mean = m_timeSum[stage] / t.blocks;
+	if (dt > t.max)
+		t.max = dt;
+}
+
+void CPlaybackPipeline::_setError(CException &e) {
+	pthread_mutex_lock(&m_errMut);
+	if (m_pError == NULL)
+		m_pError = new CException(e);
+	pthread_mutex_unlock(&m_errMut);
+	m_abort = true;
+}
+
+void CPlaybackPipeline::_setError(exception &e) {
+	CException err(CException::SRC_SimpleAudioDevice, PIPE_E_STAGE, e.what());
+	_setError(err);
+}
+
+bool CPlaybackPipeline::_startStage(STAGES stage, void* (*handler)(void*)) {
+	if (pthread_create(&m_threads[stage], NULL, handler, (void*) this) == 0)
+		return true;
+	CException err(CException::SRC_SimpleAudioDevice, PIPE_E_THREAD,
+			"Could not start the threads of the playback pipeline!");
+	_setError(err);
+	return false;
+}
+
+AUDIOBLOCK* CPlaybackPipeline::_waitBlock(CBlockQueue &queue) {
+	AUDIOBLOCK *pBlock = NULL;
+	while ((pBlock == NULL) && !m_abort.load())
+		pBlock = queue.waitPop(PIPE_WAIT_MS);
+	return pBlock;
+}
+
+void CPlaybackPipeline::_executeCommand(TRANSPORTCMD &cmd) {
+	switch (cmd.type) {
+	case TRANSPORTCMD::CMD_PLAY:
+		m_paused = false;
+		break;
+	case TRANSPORTCMD::CMD_PAUSE:
+		m_paused = true;
+		break;
+	case TRANSPORTCMD::CMD_TOGGLE:
+		m_paused = !m_paused;
+		break;
+	case TRANSPORTCMD::CMD_STOP:
+		m_abort = true;			// ends the playback without an error
+		break;
+	case TRANSPORTCMD::CMD_SEEK:
+		// a seek after the decoder has reached the end of the file is ignored
+		if (!m_decodeDone.load()) {
+			// positions outside of the file (e.g. 1e300 from the console) are
+			// clamped before the conversion to frames
+			double dur = (double) m_pSFile->getNumFrames() / m_pSFile->getSampleRate();
+			double pos = cmd.position;
+			if (!(pos > 0.))		// also NaN
+				pos = 0.;
+			if (pos > dur)
+				pos = dur;
+			// the new generation is visible before the request (see decode stage)
+			m_epoch.fetch_add(1);
+			m_seekFrame.store(pos * m_pSFile->getSampleRate());
+		}
+		break;
+	case TRANSPORTCMD::CMD_FILTER:
+		m_pNewFilter.store(cmd.pFilter);
+		m_filterChanged.store(true);
+		break;
+	}
+}
+
+void CPlaybackPipeline::_executeCommands() {
+	TRANSPORTCMD cmd;
+	while (m_transport.get(cmd))
+		_executeCommand(cmd);
+}
+
+int CPlaybackPipeline::_writeBlock(AUDIOBLOCK *pBlock, double &pausedTime) {
+	int pos = 0;
+	pausedTime = 0.;
+	while ((pos < pBlock->frames) && !m_abort.load()) {
+		_executeCommands();
+		if (pBlock->epoch != m_epoch.load())
+			break;				// decoded before a seek
+
+		// pause: the stream is stopped and restarted by the thread that writes to it
+		if (m_paused) {
+			TRACE_SCOPE("paused");
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			m_pStream->pause();
+			TRANSPORTCMD cmd;
+			while (m_paused && !m_abort.load())
+				if (m_transport.waitGet(cmd, PIPE_WAIT_MS))
+					_executeCommand(cmd);
+			m_pStream->resume();
+			pausedTime += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+			continue;			// a seek during the pause makes the block obsolete
+		}
+
+		int n = pBlock->frames - pos;
+		if (n > m_periodFrames)
+			n = m_periodFrames;
+		m_pStream->play(pBlock->pData + pos * m_numChan, n);
+		pos += n;
+	}
+	return pos;
+}
+
+void* CPlaybackPipeline::decodeThreadHandler(void *Obj) {
+	CPlaybackPipeline *pP = (CPlaybackPipeline*) Obj;
+	int fsIn = pP->m_pSFile->getSampleRate();
+	long framesPerBlock = pP->m_framesPerBlock;
+	unsigned int epoch = pP->m_epoch.load();
+	TRACE_THREAD("decode");
+	try {
+		if (pP->m_pSizer && (pP->m_pSizer->getFramesPerBlock(fsIn) < framesPerBlock))
+			framesPerBlock = pP->m_pSizer->getFramesPerBlock(fsIn);
+
+		AUDIOBLOCK *pBlock;
+		while ((pBlock = pP->_waitBlock(pP->m_freeQ)) != NULL) {
+			// a recycled block brings the processing time of its last round
+			if (pP->m_pSizer && (pBlock->inFrames > 0)) {
+				pP->m_pSizer->addMeasurement(pBlock->inFrames, pBlock->cost);
+				framesPerBlock = pP->m_pSizer->getFramesPerBlock(fsIn);
+				if (framesPerBlock > pP->m_framesPerBlock)
+					framesPerBlock = pP->m_framesPerBlock;	// capacity of the blocks
+			}
+			int bufsize = pP->m_numChan * framesPerBlock;
+
+			long seekFrame = pP->m_seekFrame.exchange(-1);
+			if (seekFrame >= 0) {
+				TRACE_SCOPE("seek");
+				pP->m_pSFile->seek(seekFrame);
+				if (pP->m_pResampler)
+					pP->m_pResampler->reset();
+				epoch = pP->m_epoch.load();
+			}
+			pBlock->epoch = epoch;
+
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			int readsize;
+			{
+				TRACE_SCOPE("read");
+				readsize = pP->m_pSFile->read(pBlock->pData, bufsize);
+			}
+			pBlock->frames = readsize / pP->m_numChan;
+			pBlock->last = (readsize < bufsize);
+
+			if (pP->m_pResampler) {
+				TRACE_SCOPE("resample");
+				int n = pP->m_pResampler->process(pBlock->pData, pBlock->frames,
+						pBlock->pWork, pBlock->capacity);
+				if (pBlock->last)	// the frames delayed by the resampler
+					n += pP->m_pResampler->flush(pBlock->pWork + n * pP->m_numChan,
+							pBlock->capacity - n);
+				float *tmp = pBlock->pData;
+				pBlock->pData = pBlock->pWork;
+				pBlock->pWork = tmp;
+				pBlock->frames = n;
+			}
+			pBlock->inFrames = framesPerBlock;
+			pBlock->cost = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+			pP->_addTiming(STAGE_DECODE, pBlock->cost);
+
+			// the block may be recycled as soon as it has been passed on
+			bool last = pBlock->last;
+			if (last)
+				pP->m_decodeDone = true;
+			pP->m_dspQ.push(pBlock);
+			if (last)
+				break;
+		}
+	} catch (CException &e) {
+		pP->_setError(e);
+	} catch (exception &e) {
+		pP->_setError(e);
+	}
+	return NULL;
+}
+
+void* CPlaybackPipeline::dspThreadHandler(void *Obj) {
+	CPlaybackPipeline *pP = (CPlaybackPipeline*) Obj;
+	TRACE_THREAD("DSP");
+	try {
+		AUDIOBLOCK *pBlock;
+		while ((pBlock = pP->_waitBlock(pP->m_dspQ)) != NULL) {
+			TRACE_SCOPE("filter");
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			if (pP->m_filterChanged.exchange(false)) {
+				// the new filter starts at rest, the old one stays with the controller
+				pP->m_pFilter = pP->m_pNewFilter.load();
+				if (pP->m_pFilter)
+					pP->m_pFilter->reset();
+				pP->m_recording = false;	// the recording has the old filter
+			}
+			// a short last block is filtered zero padded (see CFilterBase::filterBlock)
+			if (pP->m_pFilter) {
+				if (pP->m_pFilter->filterBlock(pBlock->pData, pBlock->pWork,
+						pBlock->frames)) {
+					float *tmp = pBlock->pData;
+					pBlock->pData = pBlock->pWork;
+					pBlock->pWork = tmp;
+				} else
+					pP->m_recording = false;	// unfiltered block: not a rendering
+			}
+			// only an uninterrupted recording of the whole file is of use
+			if (pP->m_recording && (pBlock->epoch != 0))
+				pP->m_recording = false;
+			if (pP->m_recording) {
+				TRACE_SCOPE("record");
+				try {
+					pP->m_pRecord->write(pBlock->pData, pBlock->frames * pP->m_numChan);
+					pP->m_recordComplete = pBlock->last;
+				} catch (CException &e) {
+					pP->m_recording = false;	// the playback goes on
+				}
+			}
+			if (pP->m_gain != 1.f)
+				CLoudnessMeter::applyGain(pBlock->pData, pBlock->frames * pP->m_numChan,
+						pP->m_gain);
+			double dt = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+			pBlock->cost += dt;
+			pP->_addTiming(STAGE_DSP, dt);
+
+			bool last = pBlock->last;
+			pP->m_outQ.push(pBlock);
+			if (last)
+				break;
+		}
+	} catch (CException &e) {
+		pP->_setError(e);
+	} catch (exception &e) {
+		pP->_setError(e);
+	}
+	return NULL;
+}
+
+void* CPlaybackPipeline::outputThreadHandler(void *Obj) {
+	CPlaybackPipeline *pP = (CPlaybackPipeline*) Obj;
+	TRACE_THREAD("output");
+	try {
+		AUDIOBLOCK *pBlock;
+		while ((pBlock = pP->_waitBlock(pP->m_outQ)) != NULL) {
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			// only the frames that have been played are metered
+			double pausedTime;
+			pBlock->frames = pP->_writeBlock(pBlock, pausedTime);
+			pP->_addTiming(STAGE_OUTPUT,
+					chrono::duration<double>(chrono::steady_clock::now() - t0).count()
+							- pausedTime);
+
+			bool last = pBlock->last;
+			pP->m_meterQ.push(pBlock);
+			if (last)
+				break;
+		}
+	} catch (CException &e) {
+		pP->_setError(e);
+	} catch (exception &e) {
+		pP->_setError(e);
+	}
+	return NULL;
+}
+
+void* CPlaybackPipeline::meterThreadHandler(void *Obj) {
+	CPlaybackPipeline *pP = (CPlaybackPipeline*) Obj;
+	TRACE_THREAD("meter");
+	try {
+		AUDIOBLOCK *pBlock;
+		while ((pBlock = pP->_waitBlock(pP->m_meterQ)) != NULL) {
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			TRACE_SCOPE("visualize");
+			if (pBlock->frames > 0)		// not discarded by a seek
+				pP->m_pUI->visualizeAmplitude(pBlock->pData, pBlock->frames * pP->m_numChan,
+						pP->m_numChan, pP->m_fsOut);
+			pP->_addTiming(STAGE_METER,
+					chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+
+			bool last = pBlock->last;
+			pP->m_freeQ.push(pBlock);	// recycle the block
+			if (last)
+				break;
+		}
+	} catch (CException &e) {
+		pP->_setError(e);
+	} catch (exception &e) {
+		pP->_setError(e);
+	}
+	pP->m_finished = true;
+	return NULL;
+}
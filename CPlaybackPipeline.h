@@ -0,0 +1,270 @@
+#ifndef CPLAYBACKPIPELINE_H_
+#define CPLAYBACKPIPELINE_H_
+
+#include <atomic>
+#include <exception>
+#include <string>
+#include <pthread.h>
+using namespace std;
+
+#include "CFile.h"
+#include "CFilter.h"
+#include "CResampler.h"
+#include "CAudioOutStream.h"
+#include "CUserInterface.h"
+#include "CBlockQueue.h"
+#include "CBlockPool.h"
+#include "CTransportQueue.h"
+#include "CBlockSizer.h"
+#include "CException.h"
+
+/**
+ * number of blocks circulating in the pipeline
+ */
+#define PIPE_NUMBLOCKS 8
+
+/**
+ * \brief plays a sound file with one thread per processing stage
+ *
+ * stages and queues:
+ *
+ *     free -> decode -> DSP -> output -> meter -> free
+ *
+ * - decode: CSoundFile::read and sample rate conversion
+ * - DSP: filter and normalization gain (the filter output may be recorded, see
+ *   setRecordFile())
+ * - output: blocking write to the device stream, transport commands
+ * - meter: measures the block that has just been written (the user interface
+ *   shows the value from its visualizer thread, see CVisualizer)
+ *
+ * The stages are connected by bounded lock-free queues. A fixed number of blocks
+ * is recycled through the free queue, so each stage only has to finish its work
+ * within one block period (instead of all stages together). The block buffers
+ * are taken from the block pool, so a playback doesn't allocate once the pool
+ * holds buffers of the needed size.
+ *
+ * Transport commands (pause, seek, ...) are posted into the transport queue by
+ * any thread. The output stage writes a block in device periods of
+ * PIPE_PERIOD_MS and handles the pending commands before each period, so a
+ * pause takes effect after one period instead of one block.
+ *
+ * With a block sizer, the decode stage adapts the block size to the processing
+ * time that each block has needed in the decode and DSP stages.
+ */
+class CPlaybackPipeline {
+public:
+	enum STAGES {
+		STAGE_DECODE, STAGE_DSP, STAGE_OUTPUT, STAGE_METER, STAGE_NUM
+	};
+	enum PIPE_ERROR {
+		PIPE_E_THREAD, PIPE_E_STAGE
+	};
+	/**
+	 * \brief processing time of a stage per block [s]
+	 */
+	struct STAGETIMING {
+		unsigned long blocks;
+		double mean;
+		double max;
+	};
+
+private:
+	CAudioOutStream *m_pStream;
+	CUserInterface *m_pUI;
+	CBlockPool *m_pPool;
+
+	/**
+	 * components of the current playback (borrowed)
+	 */
+	CSoundFile *m_pSFile;
+	CResampler *m_pResampler;
+	CFilterBase *m_pFilter;
+	CBlockSizer *m_pSizer;
+	int m_numChan;
+	int m_fsOut;
+	/**
+	 * gain of the playback (e.g. loudness normalization, precomputed)
+	 */
+	float m_gain;
+	long m_framesPerBlock;
+	long m_periodFrames;
+
+	AUDIOBLOCK m_blocks[PIPE_NUMBLOCKS];
+	CBlockQueue m_freeQ;
+	CBlockQueue m_dspQ;
+	CBlockQueue m_outQ;
+	CBlockQueue m_meterQ;
+
+	pthread_t m_threads[STAGE_NUM];
+	/**
+	 * abort after an error or a stop command and end of playback
+	 */
+	atomic<bool> m_abort;
+	atomic<bool> m_finished;
+
+	CTransportQueue m_transport;
+	/**
+	 * pause state (only used by the output stage)
+	 */
+	bool m_paused;
+	/**
+	 * seek request for the decode stage (frame or -1) and current seek generation
+	 */
+	atomic<long> m_seekFrame;
+	atomic<unsigned int> m_epoch;
+	atomic<bool> m_decodeDone;
+	/**
+	 * file that records the output of the filter (optional), recording state and
+	 * whether all blocks have been recorded (DSP stage only)
+	 */
+	CSoundFile *m_pRecord;
+	bool m_recording;
+	bool m_recordComplete;
+	/**
+	 * filter change request for the DSP stage
+	 */
+	atomic<CFilterBase*> m_pNewFilter;
+	atomic<bool> m_filterChanged;
+
+	/**
+	 * timing of the stages (each stage only writes its own entries)
+	 */
+	STAGETIMING m_timing[STAGE_NUM];
+	double m_timeSum[STAGE_NUM];
+
+	/**
+	 * first error thrown in a stage thread (rethrown by play())
+	 */
+	CException *m_pError;
+	pthread_mutex_t m_errMut;
+
+public:
+	/**
+	 * \param pStream [in] device stream (opened by play())
+	 * \param pUI [in] user interface for the amplitude meter and the pause key
+	 * \param pPool [in] pool of the block buffers
+	 */
+	CPlaybackPipeline(CAudioOutStream *pStream, CUserInterface *pUI,
+			CBlockPool *pPool);
+	~CPlaybackPipeline();
+
+	/**
+	 * \brief plays a sound file (blocking until the end of the file)
+	 *
+	 * - clears the states of resampler and filter (each playback starts like the first one)
+	 * - opens the device stream, prefills the pipeline and waits for the user to press the key
+	 * - toggles pause/resume if the user presses the key during playback
+	 * - executes the commands of the transport queue until the end of the file or a stop command
+	 * - rethrows the first exception of a stage thread
+	 *
+	 * \param pSFile [in] open sound file
+	 * \param pResampler [in] resampler to the output sample rate or NULL
+	 * \param pFilter [in] filter or NULL (owned by the caller, the console
+	 * input switches it off and on during the playback)
+	 * \param fsOut [in] output sample rate
+	 * \param framesPerBlock [in] number of frames read per block (maximum with a block sizer)
+	 * \param outCapacity [in] maximum number of frames per block after resampling
+	 * \param pSizer [in] block sizer that chooses the number of frames read per block or NULL
+	 * \param gain [in] linear gain applied after the filter (see CLoudnessMeter::getNormalizationGain)
+	 */
+	void play(CSoundFile *pSFile, CResampler *pResampler, CFilterBase *pFilter,
+			int fsOut, long framesPerBlock, int outCapacity, CBlockSizer *pSizer = NULL,
+			float gain = 1.f);
+
+	/**
+	 * \brief records the output of resampler and filter (before the gain) of the
+	 * following playbacks
+	 *
+	 * the recording stops at a seek or a filter change
+	 *
+	 * \param pFile [in] sound file open for writing or NULL (no recording)
+	 */
+	void setRecordFile(CSoundFile *pFile);
+
+	/**
+	 * \return true if the last playback has recorded the whole sound file in sequence
+	 */
+	bool isRecordComplete();
+
+	/**
+	 * \return queue for the transport commands of the playback (e.g. from other threads)
+	 */
+	CTransportQueue* getTransport();
+
+	/**
+	 * \return timing of the given stage during the last playback
+	 */
+	STAGETIMING getTiming(STAGES stage);
+
+	/**
+	 * \return timing of all stages as text
+	 */
+	string getTimingStr();
+
+private:
+	/**
+	 * \brief takes the block buffers from the pool and fills the free queue
+	 */
+	void _initBlocks(int outCapacity);
+	void _releaseBlocks();
+
+	/**
+	 * \brief adds the processing time of one block to the timing of a stage
+	 */
+	void _addTiming(STAGES stage, double dt);
+
+	/**
+	 * \brief stores the first error of a stage thread and aborts all stages
+	 */
+	void _setError(CException &e);
+
+	/**
+	 * \brief stores an error that is not a CException (e.g. std::bad_alloc) as
+	 * the first error of a stage thread and aborts all stages
+	 */
+	void _setError(exception &e);
+
+	/**
+	 * \brief starts the thread of a stage
+	 * \return false if the thread couldn't be created (the pipeline is aborted)
+	 */
+	bool _startStage(STAGES stage, void* (*handler)(void*));
+
+	/**
+	 * \brief waits for a block of the given queue unless the pipeline is aborted
+	 * \return block or NULL if aborted
+	 */
+	AUDIOBLOCK* _waitBlock(CBlockQueue &queue);
+
+	/**
+	 * \brief executes a transport command (output stage)
+	 *
+	 * seek and filter change are forwarded to the decode and the DSP stage
+	 */
+	void _executeCommand(TRANSPORTCMD &cmd);
+
+	/**
+	 * \brief executes all pending transport commands (output stage)
+	 */
+	void _executeCommands();
+
+	/**
+	 * \brief writes a block in device periods, handles the commands before each period
+	 * \param pBlock [in] block
+	 * \param pausedTime [out] time spent in pause [s]
+	 * \return number of frames written (less than the block if it has become obsolete by a seek)
+	 */
+	int _writeBlock(AUDIOBLOCK *pBlock, double &pausedTime);
+
+	/**
+	 * \brief thread functions of the stages
+	 *
+	 * \param Obj pointer on the instance
+	 */
+	static void* decodeThreadHandler(void *Obj);
+	static void* dspThreadHandler(void *Obj);
+	static void* outputThreadHandler(void *Obj);
+	static void* meterThreadHandler(void *Obj);
+};
+
+#endif /* CPLAYBACKPIPELINE_H_ */
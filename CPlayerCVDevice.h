@@ -2,8 +2,19 @@
 #define CPLAYERCVDEVICE_H_
 #include <cstdint>
 #include <string>
+#include <chrono>
+#include <thread>
 using namespace std;
 
+/**
+ * timeout of waitKeyPressed() for waiting without a limit
+ */
+#define CVDEV_WAIT_INFINITE -1
+/**
+ * polling interval of the default waitKeyPressed() [ms]
+ */
+#define CVDEV_POLL_MS 10
+
 /**
  * \brief Base class for audio player control devices
  *
@@ -39,6 +50,26 @@ public:
 	 */
 	virtual bool keyPressed()=0;
 
+	/**
+	 * \brief waits until the button is pressed
+	 *
+	 * The default implementation polls keyPressed() and sleeps in between,
+	 * devices that can block on a key event override it.
+	 *
+	 * \param timeout_ms [in] maximum waiting time in milliseconds (CVDEV_WAIT_INFINITE: no limit)
+	 * \return false if the button hasn't been pressed within the timeout
+	 */
+	virtual bool waitKeyPressed(int timeout_ms) {
+		chrono::steady_clock::time_point tEnd = chrono::steady_clock::now()
+				+ chrono::milliseconds(timeout_ms);
+		while (!keyPressed()) {
+			if ((timeout_ms != CVDEV_WAIT_INFINITE) && (chrono::steady_clock::now() >= tEnd))
+				return false;
+			this_thread::sleep_for(chrono::milliseconds(CVDEV_POLL_MS));
+		}
+		return true;
+	}
+
 	/**
 	 * \brief Queries the current state of the player controls as state name.
 	 */
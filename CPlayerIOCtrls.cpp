@@ -31,23 +31,9 @@ void CPlayerIOCtrls::close() {
 }
 
 void CPlayerIOCtrls::writeLEDs(uint16_t data) {
-	string binPattern;
-	for (int i = 0; i < 16; i++) {
-		data & 0x8000 ? binPattern += "1" : binPattern += "0";
-		data <<= 1;
-	}
-	/*
-	 * print only a carriage return (\r) and no line feed (\n) so
-	 * the bit pattern is always printed in the same line in the
-	 * external console window
-	 *
-	 * in the eclipse console view \r is always printed with an
-	 * additional line feed, so the patterns are printed in
-	 * subsequent lines
-	 */
-	binPattern += '\r';
-
-	m_thread->writeConsole(binPattern);
+	// the output thread prints the pattern as binary number (only the latest
+	// one if the console is slower than the amplitude meter)
+	m_thread->writeLEDs(data);
 	return;
 }
 
@@ -55,6 +41,10 @@ bool CPlayerIOCtrls::keyPressed() {
 	return m_thread->enterPressed();
 }
 
+bool CPlayerIOCtrls::waitKeyPressed(int timeout_ms) {
+	return m_thread->waitEnterPressed(timeout_ms);
+}
+
 string CPlayerIOCtrls::getStateStr() {
 	return m_thread->getStateStr();
 }
@@ -62,6 +62,14 @@ public:
 	 */
 	bool keyPressed();
 
+	/**
+	 * \brief waits for the return key (sleeps on the input thread's condition)
+	 *
+	 * \param timeout_ms [in] maximum waiting time in milliseconds (CVDEV_WAIT_INFINITE: no limit)
+	 * \return false if ENTER hasn't been pressed within the timeout
+	 */
+	bool waitKeyPressed(int timeout_ms);
+
 	/**
 	 * \return current state of the instance
 	 */
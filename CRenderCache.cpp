@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include <SKSLib.h>
+#include "CRenderCache.h"
+
+/**
+ * FNV-1a (64 bit) over bytes and over 64 bit words (basis: see CRenderCache.h)
+ */
+#define RCACHE_FNVPRIME 1099511628211ULL
+
+static uint64_t hashBytes(uint64_t h, const void *pData, size_t n) {
+	const unsigned char *p = (const unsigned char*) pData;
+	for (size_t i = 0; i < n; i++) {
+		h ^= p[i];
+		h *= RCACHE_FNVPRIME;
+	}
+	return h;
+}
+
+static uint64_t hashWords(uint64_t h, const unsigned char *p, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, 8);
+		h ^= w;
+		h *= RCACHE_FNVPRIME;
+	}
+	return hashBytes(h, p + i, n - i);
+}
+
+/*
+ * an entry of the cache directory
+ */
+struct CACHEENTRY {
+	string path;
+	time_t used;			// modification time: last use
+	long long size;
+};
+
+/*
+ * lists the entries of the cache directory
+ * \return size of all entries
+ */
+static long long listEntries(const string &dir, vector<CACHEENTRY> &entries) {
+	long long size = 0;
+	size_t extLen = strlen(RCACHE_EXT);
+	DIR *dp = opendir(dir.c_str());
+	if (dp == NULL)
+		return 0;				// no entry yet
+	dirent *entry;
+	while ((entry = readdir(dp))) {
+		string file = entry->d_name;
+		struct stat st;
+		if ((file.size() > extLen)
+				&& (file.compare(file.size() - extLen, extLen, RCACHE_EXT) == 0)
+				&& (stat((dir + file).c_str(), &st) == 0)) {
+			CACHEENTRY e = { dir + file, st.st_mtime, (long long) st.st_size };
+			entries.push_back(e);
+			size += e.size;
+		}
+	}
+	closedir(dp);
+	return size;
+}
+
+CRenderCache::CRenderCache(string dir, long long maxBytes) {
+	m_dir = dir;
+	m_maxBytes = maxBytes;
+}
+
+string CRenderCache::getKey(CSoundFile &sfile, CFilter &filter, int fsOut,
+		int srcQuality) {
+	uint64_t h = RCACHE_FNVBASIS;
+	uint64_t content;
+	if (!getContentHash(sfile, content))
+		return "";				// not analyzed yet
+	uint64_t filterHash = getFilterHash(filter);
+	int32_t layout[4] = { sfile.getNumChannels(), sfile.getSampleRate(), fsOut,
+			(fsOut != sfile.getSampleRate()) ? srcQuality : -1 };
+	h = hashBytes(h, &content, sizeof(content));
+	h = hashBytes(h, &filterHash, sizeof(filterHash));
+	h = hashBytes(h, layout, sizeof(layout));
+	char key[17];
+	snprintf(key, sizeof(key), "%016llx", (unsigned long long) h);
+	return key;
+}
+
+CSoundFile* CRenderCache::open(string key) {
+	string path = m_dir + key + RCACHE_EXT;
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return NULL;
+	CSoundFile *pFile = new CSoundFile(path, CSoundFile::FILE_READ);
+	try {
+		pFile->open();
+	} catch (CException &e) {
+		delete pFile;
+		remove(path.c_str());	// damaged entry
+		return NULL;
+	}
+	utime(path.c_str(), NULL);	// most recently used
+	return pFile;
+}
+
+CSoundFile* CRenderCache::create(string key, int numChan, int fs) {
+#ifdef _WIN32
+	_mkdir(m_dir.c_str());
+#else
+	mkdir(m_dir.c_str(), 0777);
+#endif
+	CSoundFile *pFile = new CSoundFile(m_dir + key + RCACHE_TMPEXT,
+			CSoundFile::FILE_WRITE);
+	pFile->setFormat(SF_FORMAT_WAV | SF_FORMAT_FLOAT);
+	pFile->setNumChannels(numChan);
+	pFile->setSampleRate(fs);
+	try {
+		pFile->open();
+	} catch (CException &e) {
+		delete pFile;
+		return NULL;			// played without cache
+	}
+	return pFile;
+}
+
+void CRenderCache::finish(string key, CSoundFile *pFile, bool complete) {
+	pFile->close();
+	delete pFile;
+	string tmpPath = m_dir + key + RCACHE_TMPEXT;
+	string path = m_dir + key + RCACHE_EXT;
+	if (!complete) {
+		remove(tmpPath.c_str());
+		return;
+	}
+	if (!CFileBase::replaceFile(tmpPath, path))
+		return;
+	_evict();
+}
+
+void CRenderCache::clear() {
+	vector<CACHEENTRY> entries;
+	listEntries(m_dir, entries);
+	for (unsigned int i = 0; i < entries.size(); i++)
+		remove(entries[i].path.c_str());
+}
+
+string CRenderCache::getStateStr() {
+	vector<CACHEENTRY> entries;
+	long long size = listEntries(m_dir, entries);
+	char buf[128];
+	snprintf(buf, sizeof(buf), "render cache: %d entries, %.1f of %.1f MB\n",
+			(int) entries.size(), size / 1048576., m_maxBytes / 1048576.);
+	return buf;
+}
+
+bool CRenderCache::getContentHash(CSoundFile &sfile, uint64_t &hash) {
+	CMetaFile meta(sfile.getPath() + META_EXT, CMetaFile::FILE_READ);
+	if (!meta.read() || !meta.isCurrent(sfile) || !hasContentHash(meta))
+		return false;
+	// 64 bit in two entries (exact in a double)
+	hash = ((uint64_t) meta.getValue("hashhi") << 32)
+			| (uint64_t) meta.getValue("hashlo");
+	return true;
+}
+
+uint64_t CRenderCache::hashSamples(uint64_t hash, const float *pBuf, long n) {
+	return hashWords(hash, (const unsigned char*) pBuf, n * sizeof(float));
+}
+
+void CRenderCache::setContentHash(CMetaFile &meta, uint64_t hash) {
+	meta.setValue("hashlo", (double) (hash & 0xffffffffu));
+	meta.setValue("hashhi", (double) (hash >> 32));
+}
+
+bool CRenderCache::hasContentHash(CMetaFile &meta) {
+	return meta.hasValue("hashlo") && meta.hasValue("hashhi");
+}
+
+uint64_t CRenderCache::getFilterHash(CFilter &filter) {
+	uint64_t h = RCACHE_FNVBASIS;
+	int32_t order = filter.getOrder();
+	h = hashBytes(h, &order, sizeof(order));
+	h = hashBytes(h, filter.getACoeffs(), (order + 1) * sizeof(float));
+	h = hashBytes(h, filter.getBCoeffs(), (order + 1) * sizeof(float));
+	return h;
+}
+
+void CRenderCache::_evict() {
+	vector<CACHEENTRY> entries;
+	long long size = listEntries(m_dir, entries);
+	// least recently used first
+	sort(entries.begin(), entries.end(), [](const CACHEENTRY &a, const CACHEENTRY &b) {
+		return a.used < b.used;
+	});
+	for (unsigned int i = 0; (i < entries.size()) && (size > m_maxBytes); i++) {
+		remove(entries[i].path.c_str());
+		size -= entries[i].size;
+	}
+}
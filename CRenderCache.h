@@ -0,0 +1,161 @@
+#ifndef CRENDERCACHE_H_
+#define CRENDERCACHE_H_
+
+#include <stdint.h>
+#include <string>
+using namespace std;
+
+#include "CFile.h"
+#include "CFilter.h"
+
+/**
+ * default directory and maximum size [bytes] of the render cache
+ */
+#define RCACHE_DIR ".\\files\\cache\\"
+#define RCACHE_MAXBYTES (1024LL * 1024 * 1024)
+/**
+ * extensions of the rendered files and of a rendering in progress
+ */
+#define RCACHE_EXT ".wav"
+#define RCACHE_TMPEXT ".tmp"
+/**
+ * start value of the hashes (FNV-1a offset basis)
+ */
+#define RCACHE_FNVBASIS 14695981039346656037ULL
+
+/**
+ * \brief disk cache of filtered sound files
+ *
+ * Filtering (and resampling) a sound file always gives the same output. A
+ * playback that has been rendered completely is stored as a 32 bit float file
+ * and later playbacks of the same combination read it instead of filtering
+ * again. The key of an entry is a hash of
+ *
+ * - the decoded samples of the sound file (stored in its metadata file, see CMetaFile)
+ * - the order and coefficients of the filter (for the output rate)
+ * - the channels, the sample rate of the sound file and the output sample rate
+ *   (and the resampler quality if the sound file is resampled)
+ *
+ * The size of the cache is limited: after a new entry has been added, the least
+ * recently used entries are removed (each use sets the modification time of the
+ * entry).
+ */
+class CRenderCache {
+private:
+	string m_dir;
+	long long m_maxBytes;
+
+public:
+	/**
+	 * \param dir [in] directory of the cache (with trailing separator, created
+	 * with the first entry)
+	 * \param maxBytes [in] maximum size of all entries
+	 */
+	CRenderCache(string dir = RCACHE_DIR, long long maxBytes = RCACHE_MAXBYTES);
+
+	/**
+	 * \brief key of a combination of sound file and filter
+	 *
+	 * \param sfile [in] open sound file
+	 * \param filter [in] filter of the playback
+	 * \param fsOut [in] output sample rate (rate of the filter coefficients)
+	 * \param srcQuality [in] quality of the resampler (if fsOut differs from the
+	 * sample rate of the sound file)
+	 * \return key (hexadecimal) or an empty string if the library analyzer
+	 * hasn't stored the hash of the sound file yet (see getContentHash())
+	 */
+	string getKey(CSoundFile &sfile, CFilter &filter, int fsOut, int srcQuality);
+
+	/**
+	 * \brief opens a rendered file
+	 * \param key [in] key of the combination
+	 * \return open sound file (to be deleted by the caller) or NULL if there is no entry
+	 */
+	CSoundFile* open(string key);
+
+	/**
+	 * \brief creates the file for a new rendering
+	 * \param key [in] key of the combination
+	 * \param numChan [in] number of channels
+	 * \param fs [in] sample rate
+	 * \return sound file open for writing or NULL if it can't be created
+	 */
+	CSoundFile* create(string key, int numChan, int fs);
+
+	/**
+	 * \brief closes and deletes a rendering created by create()
+	 *
+	 * a complete rendering becomes an entry (and older entries may be removed),
+	 * an incomplete one is removed
+	 *
+	 * \param key [in] key of the combination
+	 * \param pFile [in] rendered file
+	 * \param complete [in] true if the whole sound file has been rendered
+	 */
+	void finish(string key, CSoundFile *pFile, bool complete);
+
+	/**
+	 * \brief removes all entries
+	 */
+	void clear();
+
+	/**
+	 * \return state of the cache as text (entries and size)
+	 */
+	string getStateStr();
+
+	/**
+	 * \brief hash of the contents of a sound file
+	 *
+	 * the hash is taken from the metadata file of the sound file, where the
+	 * library analyzer stores it (see CLibraryAnalyzer). The file itself is not
+	 * read here: the player doesn't wait for the hash of a file the analyzer
+	 * hasn't reached yet.
+	 *
+	 * \param sfile [in] open sound file
+	 * \param hash [out] hash of the contents
+	 * \return false if the metadata doesn't contain the hash of the current version
+	 */
+	static bool getContentHash(CSoundFile &sfile, uint64_t &hash);
+
+	/**
+	 * \brief continues the hash of the contents with a block of decoded samples
+	 *
+	 * the library analyzer hashes the blocks it reads for its analysis (the file
+	 * is read only once)
+	 *
+	 * \param hash [in] hash of the blocks before (RCACHE_FNVBASIS for the first one)
+	 * \param pBuf [in] samples (interleaved)
+	 * \param n [in] number of samples
+	 * \return hash including this block
+	 */
+	static uint64_t hashSamples(uint64_t hash, const float *pBuf, long n);
+
+	/**
+	 * \brief stores the hash of the contents in the metadata of a sound file
+	 * \param meta [in] metadata (entries of the current version of the sound file)
+	 * \param hash [in] hash from hashSamples()
+	 */
+	static void setContentHash(CMetaFile &meta, uint64_t hash);
+
+	/**
+	 * \return true if the metadata contains the hash of the contents
+	 */
+	static bool hasContentHash(CMetaFile &meta);
+
+	/**
+	 * \brief hash of the order and the coefficients of a filter
+	 *
+	 * taken from the filter object that is played (the filter file may have
+	 * changed since it has been read)
+	 */
+	static uint64_t getFilterHash(CFilter &filter);
+
+private:
+	/**
+	 * \brief removes the least recently used entries until the cache fits its size
+	 */
+	void _evict();
+};
+
+#endif /* CRENDERCACHE_H_ */
@@ -0,0 +1,245 @@
+#include <math.h>
+#include <string.h>
+#include <SKSLib.h>
+#include "CResampler.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/**
+ * maximum number of phases of the polyphase bank (limits the memory for the coefficients)
+ */
+#define SRC_MAXPHASES 1024
+/**
+ * maximum number of taps per phase (limits the cost per output frame of strong
+ * decimation)
+ */
+#define SRC_MAXTAPS 2048
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * modified Bessel function of the first kind and order 0 (for the Kaiser window)
+ */
+static double besselI0(double x) {
+	double sum = 1., term = 1.;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2. * k)) * (x / (2. * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+/*
+ * dot product of n coefficients and n samples (n must be a multiple of 4)
+ */
+static inline float dotProduct(const float *h, const float *x, int n) {
+#ifdef __SSE__
+	__m128 acc = _mm_setzero_ps();
+	for (int i = 0; i < n; i += 4)
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(h + i), _mm_loadu_ps(x + i)));
+	// horizontal sum of the four partial sums
+	acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+	return _mm_cvtss_f32(acc);
+#else
+	float acc0 = 0.f, acc1 = 0.f, acc2 = 0.f, acc3 = 0.f;
+	for (int i = 0; i < n; i += 4) {
+		acc0 += h[i] * x[i];
+		acc1 += h[i + 1] * x[i + 1];
+		acc2 += h[i + 2] * x[i + 2];
+		acc3 += h[i + 3] * x[i + 3];
+	}
+	return (acc0 + acc1) + (acc2 + acc3);
+#endif
+}
+
+static int gcd(int a, int b) {
+	while (b) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+CResampler::CResampler(int fsIn, int fsOut, int channels, QUALITY quality) {
+	m_coeffs = NULL;
+	m_buf = NULL;
+	m_bufCap = 0;
+	m_frames = 0;
+	m_pos = 0;
+	m_phase = 0;
+
+	if ((fsIn <= 0) || (fsOut <= 0) || (channels <= 0))
+		throw CException(CException::SRC_Filter, SRC_E_PARAMS,
+				"Sampling frequencies and channels of a resampler must be greater than 0!");
+	m_channels = channels;
+	int d = gcd(fsIn, fsOut);
+	m_L = fsOut / d;
+	m_M = fsIn / d;
+	if (m_L > SRC_MAXPHASES)
+		throw CException(CException::SRC_Filter, SRC_E_RATIO,
+				"Resampling ratio " + to_string(fsOut) + "/" + to_string(fsIn)
+						+ " needs too many filter phases!");
+
+	// taps per phase, Kaiser window parameter and passband edge (relative to the lower Nyquist frequency)
+	double beta, rolloff;
+	switch (quality) {
+	case QUALITY_LOW:
+		m_taps = 8;
+		beta = 5.;
+		rolloff = 0.85;
+		break;
+	case QUALITY_HIGH:
+		m_taps = 32;
+		beta = 9.;
+		rolloff = 0.94;
+		break;
+	case QUALITY_MEDIUM:
+	default:
+		m_taps = 16;
+		beta = 7.;
+		rolloff = 0.90;
+		break;
+	}
+
+	/*
+	 * cutoff frequency relative to the input Nyquist frequency. For downsampling,
+	 * the output Nyquist frequency is the limit (anti-aliasing). The sinc is then
+	 * M/L times wider, so the taps grow by M/L to keep the number of zero
+	 * crossings (and the transition band relative to the output rate).
+	 */
+	double fc = rolloff * ((m_L < m_M) ? (double) m_L / m_M : 1.);
+	if (m_L < m_M) {
+		long long taps = ((long long) m_taps * m_M + m_L - 1) / m_L;
+		if (taps > SRC_MAXTAPS)
+			throw CException(CException::SRC_Filter, SRC_E_RATIO,
+					"Resampling ratio " + to_string(fsOut) + "/" + to_string(fsIn)
+							+ " needs too many filter taps!");
+		m_taps = (int) ((taps + 3) & ~3LL);	// multiple of 4
+	}
+
+	/*
+	 * phase p interpolates at the fractional position (m_taps/2 - 1 + p/L) of the
+	 * m_taps input frames, coefficient j weights input frame j:
+	 * c[p][j] = fc * sinc(fc * u) * kaiser(u), u = m_taps/2 - 1 + p/L - j
+	 */
+	m_coeffs = new float[m_L * m_taps];
+	double halfLen = m_taps / 2.;
+	double i0beta = besselI0(beta);
+	for (int p = 0; p < m_L; p++) {
+		float *h = m_coeffs + p * m_taps;
+		double sum = 0.;
+		for (int j = 0; j < m_taps; j++) {
+			double u = halfLen - 1. + (double) p / m_L - j;
+			double sinc = (fabs(u) < 1e-9) ? 1. : sin(M_PI * fc * u) / (M_PI * fc * u);
+			double r = u / halfLen;
+			double win = (fabs(r) < 1.) ? besselI0(beta * sqrt(1. - r * r)) / i0beta : 0.;
+			h[j] = fc * sinc * win;
+			sum += h[j];
+		}
+		// unity gain at DC for each phase
+		for (int j = 0; j < m_taps; j++)
+			h[j] /= sum;
+	}
+
+	reset();
+}
+
+CResampler::~CResampler() {
+	if (m_coeffs)
+		delete[] m_coeffs;
+	if (m_buf)
+		delete[] m_buf;
+}
+
+void CResampler::reset() {
+	/*
+	 * (m_taps/2 - 1) leading zeros center the first output frame on the first
+	 * input frame
+	 */
+	_reserve(m_taps);
+	m_frames = m_taps / 2 - 1;
+	for (int c = 0; c < m_channels; c++)
+		memset(m_buf + c * m_bufCap, 0, m_frames * sizeof(float));
+	m_pos = 0;
+	m_phase = 0;
+}
+
+int CResampler::getMaxOutFrames(int inFrames) {
+	return (int) (((long long) inFrames + m_taps) * m_L / m_M) + 2;
+}
+
+void CResampler::_reserve(int frames) {
+	if (frames <= m_bufCap)
+		return;
+	float *pNew = new float[m_channels * frames];
+	for (int c = 0; c < m_channels; c++)
+		memcpy(pNew + c * frames, m_buf + c * m_bufCap, m_frames * sizeof(float));
+	if (m_buf)
+		delete[] m_buf;
+	m_buf = pNew;
+	m_bufCap = frames;
+}
+
+int CResampler::process(float *x, int inFrames, float *y, int maxOutFrames) {
+	if ((x == NULL) || (y == NULL))
+		throw CException(CException::SRC_Filter, SRC_E_NOBUFFER,
+				"Invalid data buffer.");
+	if (maxOutFrames < getMaxOutFrames(inFrames))
+		throw CException(CException::SRC_Filter, SRC_E_NOBUFFER,
+				"Resampler output buffer is too small.");
+
+	// append the new frames de-interleaved to the history of each channel
+	_reserve(m_frames + inFrames);
+	for (int c = 0; c < m_channels; c++) {
+		float *pc = m_buf + c * m_bufCap + m_frames;
+		for (int k = 0; k < inFrames; k++)
+			pc[k] = x[k * m_channels + c];
+	}
+	m_frames += inFrames;
+
+	// calculate all output frames for which the complete filter support is available
+	int n = 0;
+	while (m_pos + m_taps <= m_frames) {
+		const float *h = m_coeffs + m_phase * m_taps;
+		for (int c = 0; c < m_channels; c++)
+			y[n * m_channels + c] = dotProduct(h, m_buf + c * m_bufCap + m_pos, m_taps);
+		n++;
+		// advance by M/L input frames
+		m_phase += m_M;
+		m_pos += m_phase / m_L;
+		m_phase %= m_L;
+	}
+
+	// drop the input frames that are not needed any longer
+	int drop = (m_pos < m_frames) ? m_pos : m_frames;
+	if (drop > 0) {
+		for (int c = 0; c < m_channels; c++)
+			memmove(m_buf + c * m_bufCap, m_buf + c * m_bufCap + drop,
+					(m_frames - drop) * sizeof(float));
+		m_frames -= drop;
+		m_pos -= drop;
+	}
+	return n;
+}
+
+int CResampler::flush(float *y, int maxOutFrames) {
+	// push the delayed frames out of the filter with zeros
+	int numZeros = m_taps / 2;
+	float *zeros = new float[numZeros * m_channels];
+	memset(zeros, 0, numZeros * m_channels * sizeof(float));
+	int n = 0;
+	try {
+		n = process(zeros, numZeros, y, maxOutFrames);
+	} catch (...) {
+		delete[] zeros;
+		throw;
+	}
+	delete[] zeros;
+	return n;
+}
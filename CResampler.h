@@ -0,0 +1,123 @@
+#ifndef CRESAMPLER_H_
+#define CRESAMPLER_H_
+
+/**
+ * \brief streaming sample rate converter
+ *
+ * converts interleaved multichannel blocks from fsIn to fsOut by a rational
+ * factor L/M (fsOut/fsIn reduced by the greatest common divisor) with a
+ * polyphase bank of L Kaiser windowed sinc filters. The dot products are
+ * vectorized (SSE) if available.
+ *
+ * the input history is kept between calls of process(), so consecutive blocks
+ * are converted without discontinuities.
+ */
+class CResampler {
+public:
+	/**
+	 * \brief quality presets (number of taps per phase, stopband attenuation and bandwidth)
+	 *
+	 * the taps are given for upsampling, for downsampling they are multiplied by M/L
+	 */
+	enum QUALITY {
+		/**
+		 * 8 taps, low cost
+		 */
+		QUALITY_LOW,
+		/**
+		 * 16 taps
+		 */
+		QUALITY_MEDIUM,
+		/**
+		 * 32 taps, wide passband and high stopband attenuation
+		 */
+		QUALITY_HIGH
+	};
+	enum SRC_ERROR {
+		SRC_E_PARAMS, SRC_E_RATIO, SRC_E_NOBUFFER
+	};
+
+private:
+	int m_channels;
+	/**
+	 * interpolation factor L and decimation factor M (fsOut/fsIn = L/M)
+	 */
+	int m_L;
+	int m_M;
+	/**
+	 * number of taps per phase (multiple of 4, scaled by M/L for downsampling)
+	 */
+	int m_taps;
+	/**
+	 * coefficients of the polyphase bank: m_L phases of m_taps coefficients each
+	 */
+	float *m_coeffs;
+	/**
+	 * input history, one linear buffer of m_bufCap frames per channel
+	 */
+	float *m_buf;
+	int m_bufCap;
+	/**
+	 * number of valid frames in m_buf
+	 */
+	int m_frames;
+	/**
+	 * first input frame used for the next output frame and current phase (0 ... L-1)
+	 */
+	int m_pos;
+	int m_phase;
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * - calculates the polyphase filter bank for the given quality
+	 * - throws an exception if the parameters are invalid or the ratio cannot be
+	 *   represented by a reasonable number of phases
+	 *
+	 * \param fsIn [in] sampling frequency of the input signal [Hz]
+	 * \param fsOut [in] sampling frequency of the output signal [Hz]
+	 * \param channels [in] number of interleaved channels
+	 * \param quality [in] quality preset
+	 */
+	CResampler(int fsIn, int fsOut, int channels, QUALITY quality = QUALITY_MEDIUM);
+	~CResampler();
+
+	/**
+	 * \brief converts a block of interleaved input frames
+	 *
+	 * \param x [in] input block
+	 * \param inFrames [in] number of frames in the input block
+	 * \param y [out] output block
+	 * \param maxOutFrames [in] capacity of the output block in frames, must be at least getMaxOutFrames(inFrames)
+	 * \return number of frames written to y
+	 */
+	int process(float *x, int inFrames, float *y, int maxOutFrames);
+
+	/**
+	 * \brief outputs the frames still delayed in the filter (at the end of a signal)
+	 *
+	 * \param y [out] output block
+	 * \param maxOutFrames [in] capacity of the output block in frames
+	 * \return number of frames written to y
+	 */
+	int flush(float *y, int maxOutFrames);
+
+	/**
+	 * \brief clears the input history (before converting a new signal)
+	 */
+	void reset();
+
+	/**
+	 * \return maximum number of output frames process() delivers for inFrames input frames
+	 */
+	int getMaxOutFrames(int inFrames);
+
+private:
+	/**
+	 * \brief makes sure that the input history can hold the given number of frames
+	 */
+	void _reserve(int frames);
+};
+
+#endif /* CRESAMPLER_H_ */
@@ -0,0 +1,119 @@
+#include <math.h>
+#include "CSampleConverter.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * number of samples quantized at once into the intermediate buffer
+ */
+#define CONV_CHUNK 256
+
+CSampleConverter::CSampleConverter(bool dither) {
+	m_dither = dither;
+	// arbitrary non zero seeds
+	m_rng[0] = 0x9e3779b9;
+	m_rng[1] = 0x7f4a7c15;
+	m_rng[2] = 0x85ebca6b;
+	m_rng[3] = 0xc2b2ae35;
+}
+
+void CSampleConverter::setDither(bool dither) {
+	m_dither = dither;
+}
+
+bool CSampleConverter::getDither() {
+	return m_dither;
+}
+
+uint32_t CSampleConverter::_random(int i) {
+	uint32_t x = m_rng[i];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	m_rng[i] = x;
+	return x;
+}
+
+void CSampleConverter::_quantize(const float *x, int32_t *y, int n,
+		float fullScale) {
+	const float maxVal = fullScale - 1.f, minVal = -fullScale;
+	// scales a signed 32 bit random number to -0.5 ... 0.5 LSB
+	const float rndScale = 1.f / 4294967296.f;
+	int i = 0;
+#ifdef __SSE2__
+	__m128 scale = _mm_set1_ps(fullScale);
+	__m128 vmax = _mm_set1_ps(maxVal), vmin = _mm_set1_ps(minVal);
+	__m128 vrnd = _mm_set1_ps(rndScale);
+	__m128i rng = _mm_loadu_si128((const __m128i*) m_rng);
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(x + i), scale);
+		if (m_dither) {
+			// two uniform random numbers per sample give a triangular density
+			__m128 d = _mm_setzero_ps();
+			for (int k = 0; k < 2; k++) {
+				rng = _mm_xor_si128(rng, _mm_slli_epi32(rng, 13));
+				rng = _mm_xor_si128(rng, _mm_srli_epi32(rng, 17));
+				rng = _mm_xor_si128(rng, _mm_slli_epi32(rng, 5));
+				d = _mm_add_ps(d, _mm_mul_ps(_mm_cvtepi32_ps(rng), vrnd));
+			}
+			v = _mm_add_ps(v, d);
+		}
+		// saturation and rounding to the nearest integer
+		v = _mm_min_ps(_mm_max_ps(v, vmin), vmax);
+		_mm_storeu_si128((__m128i*) (y + i), _mm_cvtps_epi32(v));
+	}
+	_mm_storeu_si128((__m128i*) m_rng, rng);
+#endif
+	for (; i < n; i++) {
+		float v = x[i] * fullScale;
+		if (m_dither) {
+			v += (int32_t) _random(i & 3) * rndScale;
+			v += (int32_t) _random(i & 3) * rndScale;
+		}
+		if (v > maxVal)
+			v = maxVal;
+		else if (v < minVal)
+			v = minVal;
+		y[i] = (int32_t) lrintf(v);
+	}
+}
+
+void CSampleConverter::toInt16(const float *x, int16_t *y, int n) {
+	int32_t tmp[CONV_CHUNK];
+	for (int pos = 0; pos < n; pos += CONV_CHUNK) {
+		int len = (n - pos < CONV_CHUNK) ? n - pos : CONV_CHUNK;
+		_quantize(x + pos, tmp, len, 32768.f);
+		int i = 0;
+#ifdef __SSE2__
+		// values are already saturated, so the saturating pack is exact
+		for (; i + 8 <= len; i += 8) {
+			__m128i lo = _mm_loadu_si128((const __m128i*) (tmp + i));
+			__m128i hi = _mm_loadu_si128((const __m128i*) (tmp + i + 4));
+			_mm_storeu_si128((__m128i*) (y + pos + i), _mm_packs_epi32(lo, hi));
+		}
+#endif
+		for (; i < len; i++)
+			y[pos + i] = (int16_t) tmp[i];
+	}
+}
+
+void CSampleConverter::toInt24(const float *x, uint8_t *y, int n) {
+	int32_t tmp[CONV_CHUNK];
+	for (int pos = 0; pos < n; pos += CONV_CHUNK) {
+		int len = (n - pos < CONV_CHUNK) ? n - pos : CONV_CHUNK;
+		_quantize(x + pos, tmp, len, 8388608.f);
+		uint8_t *p = y + 3 * pos;
+		for (int i = 0; i < len; i++) {
+			p[3 * i] = (uint8_t) tmp[i];
+			p[3 * i + 1] = (uint8_t) (tmp[i] >> 8);
+			p[3 * i + 2] = (uint8_t) (tmp[i] >> 16);
+		}
+	}
+}
+
+void CSampleConverter::toInt24in32(const float *x, int32_t *y, int n) {
+	_quantize(x, y, n, 8388608.f);
+	for (int i = 0; i < n; i++)
+		y[i] = (int32_t) ((uint32_t) y[i] << 8);
+}
@@ -0,0 +1,73 @@
+#ifndef CSAMPLECONVERTER_H_
+#define CSAMPLECONVERTER_H_
+
+#include <cstdint>
+
+/**
+ * \brief converts float samples (-1.0 ... 1.0) into integer samples
+ *
+ * - rounds to the nearest integer and saturates out of range samples
+ * - optionally adds TPDF dither (triangular probability density, +-1 LSB) before rounding
+ * - processes four samples at a time with SSE2 if available
+ *
+ * used by CAudioOutStream for integer device formats and by CSoundFile for
+ * writing dithered integer sound files
+ */
+class CSampleConverter {
+private:
+	/**
+	 * TPDF dither on/off
+	 */
+	bool m_dither;
+	/**
+	 * states of four xorshift random number generators (one per SIMD lane)
+	 */
+	uint32_t m_rng[4];
+
+public:
+	/**
+	 * \param dither [in] add TPDF dither before rounding
+	 */
+	CSampleConverter(bool dither = false);
+
+	/**
+	 * \brief switches the dither on or off
+	 */
+	void setDither(bool dither);
+	bool getDither();
+
+	/**
+	 * \brief converts n float samples into 16 bit integer samples
+	 */
+	void toInt16(const float *x, int16_t *y, int n);
+
+	/**
+	 * \brief converts n float samples into packed 24 bit integer samples (3 bytes
+	 * per sample, little endian, as expected by paInt24)
+	 */
+	void toInt24(const float *x, uint8_t *y, int n);
+
+	/**
+	 * \brief converts n float samples into 24 bit integer samples that are left
+	 * aligned in 32 bit integers (as expected by sf_write_int for 24 bit files)
+	 */
+	void toInt24in32(const float *x, int32_t *y, int n);
+
+private:
+	/**
+	 * \brief rounds n scaled samples to integers within [-fullScale, fullScale-1]
+	 *
+	 * \param x [in] float samples
+	 * \param y [out] rounded integer samples
+	 * \param n [in] number of samples
+	 * \param fullScale [in] 32768 (16 bit) or 8388608 (24 bit)
+	 */
+	void _quantize(const float *x, int32_t *y, int n, float fullScale);
+
+	/**
+	 * \return next value of the random number generator of lane i
+	 */
+	uint32_t _random(int i);
+};
+
+#endif /* CSAMPLECONVERTER_H_ */
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <thread>
+#include "CScriptedCVDevice.h"
+
+CScriptedCVDevice::CScriptedCVDevice() {
+	m_next = 0;
+	m_leds = 0;
+}
+
+double CScriptedCVDevice::now() {
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CScriptedCVDevice::setScript(const double *delays, int numEvents) {
+	double t0 = now();
+	m_events.clear();
+	for (int i = 0; i < numEvents; i++) {
+		KEYEVENT ev;
+		ev.tScheduled = t0 + delays[i];
+		ev.tDetected = 0.;
+		m_events.push_back(ev);
+	}
+	m_next = 0;
+}
+
+int CScriptedCVDevice::getNumEvents() {
+	return m_events.size();
+}
+
+CScriptedCVDevice::KEYEVENT CScriptedCVDevice::getEvent(int i) {
+	return m_events.at(i);
+}
+
+void CScriptedCVDevice::open() {
+}
+
+void CScriptedCVDevice::close() {
+}
+
+void CScriptedCVDevice::writeLEDs(uint16_t data) {
+	m_leds = data;
+}
+
+bool CScriptedCVDevice::keyPressed() {
+	if (m_next >= m_events.size())
+		return false;
+	double t = now();
+	if (t < m_events[m_next].tScheduled)
+		return false;
+	m_events[m_next++].tDetected = t;
+	return true;
+}
+
+bool CScriptedCVDevice::waitKeyPressed(int timeout_ms) {
+	if (m_next >= m_events.size())
+		return CPlayerCVDevice::waitKeyPressed(timeout_ms);	// returns after the timeout only
+	double tWake = m_events[m_next].tScheduled;
+	if ((timeout_ms != CVDEV_WAIT_INFINITE) && (now() + timeout_ms / 1000. < tWake))
+		tWake = now() + timeout_ms / 1000.;
+	double dt = tWake - now();
+	if (dt > 0.)
+		this_thread::sleep_for(chrono::duration<double>(dt));
+	return keyPressed();
+}
+
+string CScriptedCVDevice::getStateStr() {
+	return "scripted, " + to_string(m_next) + " of " + to_string(m_events.size())
+			+ " key presses";
+}
+
+string CScriptedCVDevice::getLastErrorStr() {
+	return "";
+}
@@ -0,0 +1,64 @@
+#ifndef CSCRIPTEDCVDEVICE_H_
+#define CSCRIPTEDCVDEVICE_H_
+
+#include <deque>
+#include "CPlayerCVDevice.h"
+
+/**
+ * \brief player control device driven by a script of key presses (test harnesses)
+ *
+ * keyPressed() returns true once for each scripted key press whose time has
+ * come. The time at which the player has seen the key press is recorded, so the
+ * control latency of the player can be measured. LED patterns are discarded.
+ *
+ * all times are seconds of chrono::steady_clock
+ */
+class CScriptedCVDevice: public CPlayerCVDevice {
+public:
+	/**
+	 * \brief a scripted key press
+	 */
+	struct KEYEVENT {
+		double tScheduled;	// time of the key press
+		double tDetected;	// time at which keyPressed() reported it (0: not yet)
+	};
+
+private:
+	deque<KEYEVENT> m_events;
+	unsigned int m_next;
+	uint16_t m_leds;
+
+public:
+	CScriptedCVDevice();
+
+	/**
+	 * \brief replaces the script
+	 * \param delays [in] times of the key presses relative to now [s] (ascending)
+	 * \param numEvents [in] number of key presses
+	 */
+	void setScript(const double *delays, int numEvents);
+
+	int getNumEvents();
+	KEYEVENT getEvent(int i);
+
+	/**
+	 * INTERFACE of CPlayerCVDevice
+	 */
+	void open();
+	void close();
+	void writeLEDs(uint16_t data);
+	bool keyPressed();
+	/**
+	 * sleeps until the next scripted key press
+	 */
+	bool waitKeyPressed(int timeout_ms);
+	string getStateStr();
+	string getLastErrorStr();
+
+	/**
+	 * \return current time [s]
+	 */
+	static double now();
+};
+
+#endif /* CSCRIPTEDCVDEVICE_H_ */
@@ -0,0 +1,233 @@
+#include <math.h>
+#include <stddef.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "CSpectrumAnalyzer.h"
+
+/*
+ * sum of re[k]^2 + im[k]^2 for k = lo ... hi-1
+ */
+static float binEnergy(const float *re, const float *im, int lo, int hi) {
+	float sum = 0.f;
+	int k = lo;
+#ifdef __SSE__
+	__m128 acc = _mm_setzero_ps();
+	for (; k + 4 <= hi; k += 4) {
+		__m128 r = _mm_loadu_ps(re + k);
+		__m128 i = _mm_loadu_ps(im + k);
+		acc = _mm_add_ps(acc, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i)));
+	}
+	float tmp[4];
+	_mm_storeu_ps(tmp, acc);
+	sum = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#endif
+	for (; k < hi; k++)
+		sum += re[k] * re[k] + im[k] * im[k];
+	return sum;
+}
+
+CSpectrumAnalyzer::CSpectrumAnalyzer() {
+	for (int i = 0; i < SPEC_RINGSIZE; i++)
+		m_ring[i].store(0.f, memory_order_relaxed);
+	m_writePos = 0;
+	m_writeEnd = 0;
+	m_fs = 0;
+	m_fftLen = 0;
+	m_window = m_cos = m_sin = m_splitCos = m_splitSin = NULL;
+	m_re = m_im = m_binRe = m_binIm = NULL;
+	m_bitrev = NULL;
+	for (int b = 0; b <= SPEC_NUMBANDS; b++)
+		m_bandBins[b] = 0;
+}
+
+CSpectrumAnalyzer::~CSpectrumAnalyzer() {
+	_free();
+}
+
+int CSpectrumAnalyzer::getFFTLength(int fs) {
+	int n = 64;
+	while ((n < SPEC_RINGSIZE) && (fs / (double) n > SPEC_RESOLUTION))
+		n <<= 1;
+	return n;
+}
+
+unsigned long CSpectrumAnalyzer::write(const float *databuf, long frames,
+		int numChan) {
+	unsigned long pos = m_writePos.load(memory_order_relaxed);
+	// only the last SPEC_RINGSIZE frames of a long block are kept
+	long skip = (frames > SPEC_RINGSIZE) ? frames - SPEC_RINGSIZE : 0;
+	pos += skip;
+	databuf += skip * numChan;
+	frames -= skip;
+
+	// announce the overwritten range before writing (seqlock, see analyze())
+	m_writeEnd.store(pos + frames, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	float scale = 1.f / numChan;
+	for (long f = 0; f < frames; f++) {
+		float sum = 0.f;
+		for (int ch = 0; ch < numChan; ch++)
+			sum += databuf[f * numChan + ch];
+		m_ring[(pos + f) & (SPEC_RINGSIZE - 1)].store(sum * scale, memory_order_relaxed);
+	}
+	m_writePos.store(pos + frames, memory_order_release);
+	return pos + frames;
+}
+
+bool CSpectrumAnalyzer::analyze(unsigned long endPos, int fs, float *bands) {
+	if (fs != m_fs)
+		_setup(fs);
+	int n = m_fftLen, half = n / 2;
+
+	unsigned long writePos = m_writePos.load(memory_order_acquire);
+	if (endPos > writePos)
+		endPos = writePos;
+
+	// windowed samples, even ones into the real and odd ones into the imaginary part
+	for (int i = 0; i < n; i++) {
+		float x = 0.f;
+		if (endPos >= (unsigned long) (n - i))		// before the first sample: silence
+			x = m_ring[(endPos - n + i) & (SPEC_RINGSIZE - 1)].load(memory_order_relaxed);
+		if (i & 1)
+			m_im[i >> 1] = x * m_window[i];
+		else
+			m_re[i >> 1] = x * m_window[i];
+	}
+	atomic_thread_fence(memory_order_acquire);
+	if (m_writeEnd.load(memory_order_relaxed) > endPos - n + SPEC_RINGSIZE)
+		return false;		// overwritten during the copy
+
+	_fft();
+
+	/*
+	 * split into the spectrum of the real signal (bins 0 ... n/2):
+	 * X[k] = (Z[k] + Z*[M-k]) / 2 - j/2 * e^(-j 2 pi k/n) * (Z[k] - Z*[M-k]), M = n/2
+	 */
+	for (int k = 0; k <= half; k++) {
+		int k1 = k & (half - 1), k2 = (half - k) & (half - 1);
+		float ar = 0.5f * (m_re[k1] + m_re[k2]), ai = 0.5f * (m_im[k1] - m_im[k2]);
+		float br = 0.5f * (m_im[k1] + m_im[k2]), bi = -0.5f * (m_re[k1] - m_re[k2]);
+		float c = m_splitCos[k], s = m_splitSin[k];
+		m_binRe[k] = ar + br * c + bi * s;
+		m_binIm[k] = ai + bi * c - br * s;
+	}
+
+	/*
+	 * a sine of amplitude A has the energy 3/32 * A^2 * n^2 in the bins of its
+	 * main lobe (Hann window)
+	 */
+	float norm = sqrt(32.f / 3.f) / n;
+	for (int b = 0; b < SPEC_NUMBANDS; b++)
+		bands[b] = norm * sqrt(binEnergy(m_binRe, m_binIm, m_bandBins[b],
+				m_bandBins[b + 1]));
+	return true;
+}
+
+void CSpectrumAnalyzer::_setup(int fs) {
+	_free();
+	m_fs = fs;
+	m_fftLen = getFFTLength(fs);
+	int n = m_fftLen, half = n / 2;
+
+	m_window = new float[n];
+	for (int i = 0; i < n; i++)
+		m_window[i] = 0.5 - 0.5 * cos(2. * M_PI * i / n);	// periodic Hann
+
+	m_cos = new float[half / 2];
+	m_sin = new float[half / 2];
+	for (int k = 0; k < half / 2; k++) {
+		m_cos[k] = cos(2. * M_PI * k / half);
+		m_sin[k] = sin(2. * M_PI * k / half);
+	}
+	m_bitrev = new int[half];
+	int bits = 0;
+	while ((1 << bits) < half)
+		bits++;
+	for (int i = 0; i < half; i++) {
+		int r = 0;
+		for (int b = 0; b < bits; b++)
+			if (i & (1 << b))
+				r |= 1 << (bits - 1 - b);
+		m_bitrev[i] = r;
+	}
+	m_splitCos = new float[half + 1];
+	m_splitSin = new float[half + 1];
+	for (int k = 0; k <= half; k++) {
+		m_splitCos[k] = cos(2. * M_PI * k / n);
+		m_splitSin[k] = sin(2. * M_PI * k / n);
+	}
+	m_re = new float[half];
+	m_im = new float[half];
+	m_binRe = new float[half + 1];
+	m_binIm = new float[half + 1];
+
+	/*
+	 * log spaced band edges, a band gets the bins from its lower edge to the
+	 * next band (at least the bin nearest to its center, bands above the Nyquist
+	 * frequency are empty)
+	 */
+	double df = (double) fs / n;
+	for (int b = 0; b <= SPEC_NUMBANDS; b++) {
+		double f = SPEC_FMIN * pow(SPEC_FMAX / SPEC_FMIN, (double) b / SPEC_NUMBANDS);
+		int bin = ceil(f / df);
+		m_bandBins[b] = (bin > half + 1) ? half + 1 : bin;
+	}
+	for (int b = 0; b < SPEC_NUMBANDS; b++) {
+		if ((m_bandBins[b] >= m_bandBins[b + 1]) && (m_bandBins[b] <= half)) {
+			double fc = SPEC_FMIN * pow(SPEC_FMAX / SPEC_FMIN, (b + 0.5) / SPEC_NUMBANDS);
+			int bin = floor(fc / df + 0.5);
+			m_bandBins[b] = bin;
+			if (m_bandBins[b + 1] <= bin)
+				m_bandBins[b + 1] = bin + 1;
+		}
+	}
+}
+
+void CSpectrumAnalyzer::_free() {
+	delete[] m_window;
+	delete[] m_cos;
+	delete[] m_sin;
+	delete[] m_bitrev;
+	delete[] m_splitCos;
+	delete[] m_splitSin;
+	delete[] m_re;
+	delete[] m_im;
+	delete[] m_binRe;
+	delete[] m_binIm;
+	m_window = m_cos = m_sin = m_splitCos = m_splitSin = NULL;
+	m_re = m_im = m_binRe = m_binIm = NULL;
+	m_bitrev = NULL;
+	m_fftLen = 0;
+	m_fs = 0;
+}
+
+void CSpectrumAnalyzer::_fft() {
+	int m = m_fftLen / 2;
+	for (int i = 0; i < m; i++) {
+		int j = m_bitrev[i];
+		if (i < j) {
+			float t = m_re[i];
+			m_re[i] = m_re[j];
+			m_re[j] = t;
+			t = m_im[i];
+			m_im[i] = m_im[j];
+			m_im[j] = t;
+		}
+	}
+	// radix 2 butterflies with the twiddle factors e^(-j 2 pi k/m)
+	for (int len = 2; len <= m; len <<= 1) {
+		int halfLen = len / 2, step = m / len;
+		for (int i = 0; i < m; i += len)
+			for (int k = 0; k < halfLen; k++) {
+				float wr = m_cos[k * step], wi = -m_sin[k * step];
+				int a = i + k, b = a + halfLen;
+				float tr = m_re[b] * wr - m_im[b] * wi;
+				float ti = m_re[b] * wi + m_im[b] * wr;
+				m_re[b] = m_re[a] - tr;
+				m_im[b] = m_im[a] - ti;
+				m_re[a] += tr;
+				m_im[a] += ti;
+			}
+	}
+}
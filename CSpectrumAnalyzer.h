@@ -0,0 +1,114 @@
+#ifndef CSPECTRUMANALYZER_H_
+#define CSPECTRUMANALYZER_H_
+
+#include <atomic>
+using namespace std;
+
+/**
+ * number of bands and edges of the lowest and the highest band [Hz] (log spaced)
+ */
+#define SPEC_NUMBANDS 16
+#define SPEC_FMIN 31.25
+#define SPEC_FMAX 16000.
+/**
+ * maximum bin spacing [Hz] (the FFT length is the next power of 2)
+ */
+#define SPEC_RESOLUTION 20.
+/**
+ * samples kept for the analysis (power of 2, at least the longest FFT)
+ */
+#define SPEC_RINGSIZE 32768
+
+/**
+ * \brief spectrum of the latest samples in SPEC_NUMBANDS log spaced bands
+ *
+ * The audio path appends its blocks with write() (mono downmix into a ring
+ * buffer, never blocks). The visualizer calls analyze() at its refresh rate:
+ * it takes the latest FFT length of samples up to a given position, applies a
+ * Hann window and a real FFT (complex FFT of half the length) and sums the
+ * bin energies of each band with SSE.
+ *
+ * The ring is read like a seqlock: if the audio path has overwritten the
+ * samples during the copy, analyze() fails and the refresh is skipped.
+ */
+class CSpectrumAnalyzer {
+private:
+	/**
+	 * ring of the downmixed samples and number of samples ever written
+	 * (m_writeEnd is set before, m_writePos after writing)
+	 */
+	atomic<float> m_ring[SPEC_RINGSIZE];
+	atomic<unsigned long> m_writePos;
+	atomic<unsigned long> m_writeEnd;
+
+	/**
+	 * analysis setup for m_fs (visualizer)
+	 */
+	int m_fs;
+	int m_fftLen;
+	float *m_window;
+	/**
+	 * complex FFT of m_fftLen/2 points: twiddle factors and bit reversed indices
+	 */
+	float *m_cos;
+	float *m_sin;
+	int *m_bitrev;
+	/**
+	 * twiddle factors of the split of the real FFT (m_fftLen/2 + 1)
+	 */
+	float *m_splitCos;
+	float *m_splitSin;
+	/**
+	 * work buffers (real and imaginary parts)
+	 */
+	float *m_re;
+	float *m_im;
+	float *m_binRe;
+	float *m_binIm;
+	/**
+	 * first bin of each band and end of the last band
+	 */
+	int m_bandBins[SPEC_NUMBANDS + 1];
+
+public:
+	CSpectrumAnalyzer();
+	~CSpectrumAnalyzer();
+
+	/**
+	 * \brief appends the downmix of a block (audio path, wait-free)
+	 * \param databuf [in] interleaved samples
+	 * \param frames [in] number of frames
+	 * \param numChan [in] number of channels
+	 * \return number of samples written since the creation (position after the block)
+	 */
+	unsigned long write(const float *databuf, long frames, int numChan);
+
+	/**
+	 * \brief calculates the band levels of the samples before a position (visualizer)
+	 *
+	 * \param endPos [in] position after the last sample analyzed (see write())
+	 * \param fs [in] sample rate
+	 * \param bands [out] amplitude per band (a sine of amplitude A gives A in its band)
+	 * \return false if the samples have been overwritten during the analysis
+	 */
+	bool analyze(unsigned long endPos, int fs, float *bands);
+
+	/**
+	 * \return FFT length used for the sample rate
+	 */
+	static int getFFTLength(int fs);
+
+private:
+	/**
+	 * \brief calculates window, twiddle factors and band bins for a sample rate
+	 */
+	void _setup(int fs);
+	void _free();
+
+	/**
+	 * \brief in place complex FFT of m_fftLen/2 points (m_re, m_im)
+	 */
+	void _fft();
+};
+
+#endif /* CSPECTRUMANALYZER_H_ */
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <SKSLib.h>
+#include "CTrace.h"
+
+atomic<CTrace::BUFFER*> CTrace::s_buffers(NULL);
+CTrace::BUFFER *CTrace::s_pFree = NULL;
+atomic<int> CTrace::s_numThreads(0);
+atomic<uint64_t> CTrace::s_epoch(0);
+thread_local CTrace::BUFFER *CTrace::t_pBuffer = NULL;
+thread_local CTrace::OWNER CTrace::t_owner;
+
+/*
+ * protects the free list (only used when a thread starts or exits)
+ */
+static pthread_mutex_t s_freeMut = PTHREAD_MUTEX_INITIALIZER;
+
+CTrace::BUFFER* CTrace::_registerThread() {
+	pthread_mutex_lock(&s_freeMut);
+	BUFFER *pB = s_pFree;
+	if (pB)
+		s_pFree = pB->pNextFree;
+	pthread_mutex_unlock(&s_freeMut);
+
+	if (pB == NULL) {
+		// the buffers are never deleted (dump() walks the list without a lock)
+		pB = new BUFFER;
+		pB->pNext = s_buffers.load();
+		while (!s_buffers.compare_exchange_weak(pB->pNext, pB))
+			;
+	}
+	// the events of the previous owner are dropped, the new owner gets a new id
+	pB->count.store(0, memory_order_relaxed);
+	pB->epoch.store(s_epoch.load(), memory_order_release);
+	pB->tid = s_numThreads.fetch_add(1) + 1;
+	pB->threadName = NULL;
+	pB->pNextFree = NULL;
+	t_pBuffer = pB;
+	(void) &t_owner;	// constructs the owner, its destructor runs at thread exit
+	return pB;
+}
+
+CTrace::OWNER::~OWNER() {
+	BUFFER *pB = t_pBuffer;
+	if (pB == NULL)
+		return;
+	t_pBuffer = NULL;
+	pthread_mutex_lock(&s_freeMut);
+	pB->pNextFree = s_pFree;
+	s_pFree = pB;
+	pthread_mutex_unlock(&s_freeMut);
+}
+
+void CTrace::setThreadName(const char *name) {
+	BUFFER *pB = t_pBuffer ? t_pBuffer : _registerThread();
+	pB->threadName = name;
+}
+
+void CTrace::clear() {
+	// only the owners write the counts
+	s_epoch.fetch_add(1);
+}
+
+uint64_t CTrace::_getNumEvents(BUFFER *pB, uint64_t epoch) {
+	if (pB->epoch.load(memory_order_acquire) != epoch)
+		return 0;		// cleared, the owner hasn't recorded since
+	return pB->count.load(memory_order_acquire);
+}
+
+unsigned long CTrace::dump(string path) {
+	FILE *pF = fopen(path.c_str(), "w");
+	if (pF == NULL)
+		throw CException(CException::SRC_File, -1, "Can't write the trace file " + path);
+
+	// timestamps relative to the oldest event (microseconds in the trace format)
+	int64_t t0 = INT64_MAX;
+	uint64_t epoch = s_epoch.load();
+	for (BUFFER *pB = s_buffers.load(); pB; pB = pB->pNext) {
+		uint64_t n = _getNumEvents(pB, epoch);
+		uint64_t first = (n > TRACE_BUFSIZE) ? n - TRACE_BUFSIZE : 0;
+		for (uint64_t i = first; i < n; i++)
+			if (pB->events[i & (TRACE_BUFSIZE - 1)].tStart < t0)
+				t0 = pB->events[i & (TRACE_BUFSIZE - 1)].tStart;
+	}
+
+	unsigned long numEvents = 0;
+	const char *sep = "";
+	fprintf(pF, "{\"traceEvents\": [\n");
+	for (BUFFER *pB = s_buffers.load(); pB; pB = pB->pNext) {
+		uint64_t n = _getNumEvents(pB, epoch);
+		if (pB->threadName && (n > 0)) {
+			fprintf(pF, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+					"\"args\": {\"name\": \"%s\"}}", sep, pB->tid, pB->threadName);
+			sep = ",\n";
+		}
+		uint64_t first = (n > TRACE_BUFSIZE) ? n - TRACE_BUFSIZE : 0;
+		for (uint64_t i = first; i < n; i++) {
+			EVENT &ev = pB->events[i & (TRACE_BUFSIZE - 1)];
+			fprintf(pF, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+					"\"ts\": %.3f, \"dur\": %.3f}", sep, ev.name, pB->tid,
+					(ev.tStart - t0) / 1e3, ev.duration / 1e3);
+			sep = ",\n";
+			numEvents++;
+		}
+	}
+	fprintf(pF, "\n], \"displayTimeUnit\": \"ms\"}\n");
+	fclose(pF);
+	return numEvents;
+}
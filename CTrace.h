@@ -0,0 +1,174 @@
+#ifndef CTRACE_H_
+#define CTRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+using namespace std;
+
+//#define PLAYER_TRACE		// enables the trace points (otherwise they are compiled out entirely)
+
+/**
+ * number of events per thread kept by the trace (power of 2, older events are overwritten)
+ */
+#define TRACE_BUFSIZE 16384
+
+/**
+ * \brief scoped trace points with Chrome trace event export
+ *
+ * usage:
+ *
+ *     TRACE_THREAD("decode");		// names the current thread in the trace
+ *     {
+ *         TRACE_SCOPE("read");		// records the duration of the enclosing scope
+ *         ...
+ *     }
+ *     TRACE_DUMP("trace.json");	// writes all events (view with Perfetto or chrome://tracing)
+ *     TRACE_CLEAR();				// removes all events
+ *
+ * each thread records into its own ring buffer (taken at its first event), so
+ * recording needs neither locks nor atomic read-modify-write operations. When a
+ * thread exits, its buffer goes to a free list and the next new thread records
+ * into it (the events of the exited thread are dumped until then). So the
+ * threads created per playback don't add buffers. The buffers are dumped while
+ * the traced threads are idle (e.g. after playback).
+ */
+class CTrace {
+public:
+	/**
+	 * \brief a completed scope
+	 */
+	struct EVENT {
+		const char *name;	// string literal
+		int64_t tStart;		// [ns] steady clock
+		int64_t duration;	// [ns]
+	};
+
+private:
+	/**
+	 * \brief event ring buffer of a thread
+	 */
+	struct BUFFER {
+		EVENT events[TRACE_BUFSIZE];
+		atomic<uint64_t> count;		// number of events since the epoch (only by the owner)
+		atomic<uint64_t> epoch;		// epoch of the events (only by the owner)
+		int tid;
+		const char *threadName;
+		BUFFER *pNext;				// list of all buffers
+		BUFFER *pNextFree;			// free list
+	};
+	/**
+	 * \brief returns the buffer of the thread to the free list when the thread exits
+	 */
+	struct OWNER {
+		~OWNER();
+	};
+	static atomic<BUFFER*> s_buffers;
+	static BUFFER *s_pFree;
+	static atomic<int> s_numThreads;
+	/**
+	 * incremented by clear(), the owner of a buffer removes its events when it
+	 * sees a new epoch
+	 */
+	static atomic<uint64_t> s_epoch;
+	static thread_local BUFFER *t_pBuffer;
+	static thread_local OWNER t_owner;
+
+public:
+	/**
+	 * \return current time of the steady clock [ns]
+	 */
+	static inline int64_t now() {
+		return chrono::duration_cast<chrono::nanoseconds>(
+				chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * \brief records a completed scope of the calling thread
+	 * \param name [in] name of the scope (string literal, not copied)
+	 * \param tStart [in] start time [ns]
+	 * \param tEnd [in] end time [ns]
+	 */
+	static inline void record(const char *name, int64_t tStart, int64_t tEnd) {
+		BUFFER *pB = t_pBuffer ? t_pBuffer : _registerThread();
+		uint64_t n = pB->count.load(memory_order_relaxed);
+		uint64_t epoch = s_epoch.load(memory_order_relaxed);
+		if (pB->epoch.load(memory_order_relaxed) != epoch) {
+			// cleared: the owner starts again
+			n = 0;
+			pB->count.store(0, memory_order_relaxed);
+			pB->epoch.store(epoch, memory_order_release);
+		}
+		EVENT &ev = pB->events[n & (TRACE_BUFSIZE - 1)];
+		ev.name = name;
+		ev.tStart = tStart;
+		ev.duration = tEnd - tStart;
+		pB->count.store(n + 1, memory_order_release);
+	}
+
+	/**
+	 * \brief names the calling thread in the trace
+	 * \param name [in] string literal (not copied)
+	 */
+	static void setThreadName(const char *name);
+
+	/**
+	 * \brief writes the events of all threads as Chrome trace event JSON
+	 * \param path [in] path of the JSON file
+	 * \return number of events written
+	 */
+	static unsigned long dump(string path);
+
+	/**
+	 * \brief removes all recorded events (the threads keep their buffers)
+	 *
+	 * the events are not dumped anymore, each thread overwrites its buffer with
+	 * its next event
+	 */
+	static void clear();
+
+private:
+	/**
+	 * \brief takes a buffer from the free list (or creates one) for the calling thread
+	 */
+	static BUFFER* _registerThread();
+
+	/**
+	 * \return number of events of a buffer recorded in the given epoch
+	 */
+	static uint64_t _getNumEvents(BUFFER *pB, uint64_t epoch);
+};
+
+/**
+ * \brief records the lifetime of an object as a trace event
+ */
+class CTraceScope {
+private:
+	const char *m_name;
+	int64_t m_tStart;
+public:
+	inline CTraceScope(const char *name) {
+		m_name = name;
+		m_tStart = CTrace::now();
+	}
+	inline ~CTraceScope() {
+		CTrace::record(m_name, m_tStart, CTrace::now());
+	}
+};
+
+#ifdef PLAYER_TRACE
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) CTraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+#define TRACE_THREAD(name) CTrace::setThreadName(name)
+#define TRACE_DUMP(path) CTrace::dump(path)
+#define TRACE_CLEAR() CTrace::clear()
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD(name)
+#define TRACE_DUMP(path)
+#define TRACE_CLEAR()
+#endif
+
+#endif /* CTRACE_H_ */
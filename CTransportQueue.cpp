@@ -0,0 +1,86 @@
+#include <time.h>
+#include <stddef.h>
+#include "CTransportQueue.h"
+
+CTransportQueue::CTransportQueue() {
+	m_pending = 0;
+	pthread_mutex_init(&m_mut, 0);
+	pthread_cond_init(&m_cond, 0);
+}
+
+CTransportQueue::~CTransportQueue() {
+	pthread_mutex_destroy(&m_mut);
+	pthread_cond_destroy(&m_cond);
+}
+
+void CTransportQueue::post(TRANSPORTCMD cmd) {
+	pthread_mutex_lock(&m_mut);
+	m_cmds.push_back(cmd);
+	m_pending.store(m_cmds.size(), memory_order_release);
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mut);
+}
+
+void CTransportQueue::post(TRANSPORTCMD::TYPES type, double position,
+		CFilterBase *pFilter) {
+	TRANSPORTCMD cmd;
+	cmd.type = type;
+	cmd.position = position;
+	cmd.pFilter = pFilter;
+	post(cmd);
+}
+
+bool CTransportQueue::get(TRANSPORTCMD &cmd) {
+	// common case of the audio path: nothing to do, no lock
+	if (m_pending.load(memory_order_acquire) == 0)
+		return false;
+
+	bool found = false;
+	pthread_mutex_lock(&m_mut);
+	if (!m_cmds.empty()) {
+		cmd = m_cmds.front();
+		m_cmds.pop_front();
+		m_pending.store(m_cmds.size(), memory_order_release);
+		found = true;
+	}
+	pthread_mutex_unlock(&m_mut);
+	return found;
+}
+
+bool CTransportQueue::waitGet(TRANSPORTCMD &cmd, int timeout_ms) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	bool found = false;
+	pthread_mutex_lock(&m_mut);
+	while (m_cmds.empty()) {
+		// wait unlocks at entrance and re-locks at the end
+		if (pthread_cond_timedwait(&m_cond, &m_mut, &ts) != 0)
+			break;
+	}
+	if (!m_cmds.empty()) {
+		cmd = m_cmds.front();
+		m_cmds.pop_front();
+		m_pending.store(m_cmds.size(), memory_order_release);
+		found = true;
+	}
+	pthread_mutex_unlock(&m_mut);
+	return found;
+}
+
+int CTransportQueue::pending() {
+	return m_pending.load(memory_order_acquire);
+}
+
+void CTransportQueue::clear() {
+	pthread_mutex_lock(&m_mut);
+	m_cmds.clear();
+	m_pending.store(0, memory_order_release);
+	pthread_mutex_unlock(&m_mut);
+}
@@ -0,0 +1,104 @@
+#ifndef CTRANSPORTQUEUE_H_
+#define CTRANSPORTQUEUE_H_
+
+#include <atomic>
+#include <deque>
+#include <pthread.h>
+using namespace std;
+
+class CFilterBase;
+
+/**
+ * \brief transport command of the player
+ */
+struct TRANSPORTCMD {
+	enum TYPES {
+		/**
+		 * resume a paused playback
+		 */
+		CMD_PLAY,
+		CMD_PAUSE,
+		/**
+		 * pause or resume (the single key of the control devices)
+		 */
+		CMD_TOGGLE,
+		/**
+		 * end the playback
+		 */
+		CMD_STOP,
+		/**
+		 * continue the playback at position [s]
+		 */
+		CMD_SEEK,
+		/**
+		 * filter the following blocks with pFilter (NULL: unfiltered)
+		 */
+		CMD_FILTER
+	};
+	TYPES type;
+	double position;
+	/**
+	 * borrowed: the controller owns the filters of a playback until the play()
+	 * of the pipeline returns, the DSP stage only switches to pFilter at a block
+	 * boundary and never deletes a filter (the previous one stays with its owner)
+	 */
+	CFilterBase *pFilter;
+};
+
+/**
+ * \brief queue of transport commands from any number of control threads to the audio path
+ *
+ * The control sources (console input thread, device polling, ...) post
+ * commands asynchronously. The audio path checks the queue between two device
+ * periods: the check is a single atomic load as long as the queue is empty, the
+ * mutex is only taken if commands are pending. While the audio path has nothing
+ * to play (pause), it sleeps in waitGet() until the next command arrives.
+ *
+ * (an eventfd/epoll pair would do the same on Linux only, the player also runs
+ * on Windows)
+ */
+class CTransportQueue {
+private:
+	deque<TRANSPORTCMD> m_cmds;
+	atomic<int> m_pending;
+	pthread_mutex_t m_mut;
+	pthread_cond_t m_cond;
+
+public:
+	CTransportQueue();
+	~CTransportQueue();
+
+	/**
+	 * \brief appends a command (any thread)
+	 */
+	void post(TRANSPORTCMD cmd);
+	void post(TRANSPORTCMD::TYPES type, double position = 0.,
+			CFilterBase *pFilter = NULL);
+
+	/**
+	 * \brief removes the oldest command (audio path, doesn't block)
+	 * \param cmd [out] command
+	 * \return false if there is no command
+	 */
+	bool get(TRANSPORTCMD &cmd);
+
+	/**
+	 * \brief removes the oldest command, waits if there is none
+	 * \param cmd [out] command
+	 * \param timeout_ms [in] maximum waiting time in milliseconds
+	 * \return false if there is still no command after the timeout
+	 */
+	bool waitGet(TRANSPORTCMD &cmd, int timeout_ms);
+
+	/**
+	 * \return number of pending commands
+	 */
+	int pending();
+
+	/**
+	 * \brief removes all pending commands
+	 */
+	void clear();
+};
+
+#endif /* CTRANSPORTQUEUE_H_ */
@@ -29,7 +29,17 @@ void CUserInterface::init(PLAYER_CV_DEVS playerCtrlDev) {
 			m_playerCVDev->open();
 		}
 	}
-	m_ampMeter.init(m_playerCVDev, CAmpMeter::SCALING_MODE_LIN, -2, 2, 0);
+	m_ledWriter.start(m_playerCVDev);
+	m_ampMeter.init(&m_ledWriter, CAmpMeter::SCALING_MODE_LIN, -2, 2, 0);
+	m_visualizer.start(&m_ampMeter);
+}
+
+void CUserInterface::init(CPlayerCVDevice *pPlayerCVDev) {
+	m_playerCVDev = pPlayerCVDev;
+	m_playerCVDev->open();
+	m_ledWriter.start(m_playerCVDev);
+	m_ampMeter.init(&m_ledWriter, CAmpMeter::SCALING_MODE_LIN, -2, 2, 0);
+	m_visualizer.start(&m_ampMeter);
 }
 
 int CUserInterface::getListSelection(string *items, const string prompt) {
@@ -62,13 +72,23 @@ int CUserInterface::getListSelection(string *items, const string prompt) {
 
 bool CUserInterface::keyPressed(bool bBlock) {
 	if (bBlock) {
-		while (m_playerCVDev->keyPressed() == false)
-			; // wait for  the user to press the start button
+		// the device sleeps until the user presses the start button
+		while (m_playerCVDev->waitKeyPressed(CVDEV_WAIT_INFINITE) == false)
+			;
 		return true;
 	} else
 		return m_playerCVDev->keyPressed();
 }
 
+bool CUserInterface::waitKeyPressed(int timeout_ms) {
+	return m_playerCVDev->waitKeyPressed(timeout_ms);
+}
+
+void CUserInterface::setTransport(CTransportQueue *pTransport,
+		CFilterBase *pFilter) {
+	CConsoleThread::getInstance()->setTransport(pTransport, pFilter);
+}
+
 int CUserInterface::getUserInputInt(const string prompt) {
 	// display the input request (if any)
 	if (!prompt.empty())
@@ -118,19 +138,45 @@ void CUserInterface::printMessage(const string msg) {
 	m_console.writeConsole(msg);
 }
 
-void CUserInterface::visualizeAmplitude(float *databuf, int bufsize) {
-	m_ampMeter.write(databuf, bufsize);
+void CUserInterface::visualizeAmplitude(float *databuf, int bufsize, int numChan,
+		int fs) {
+	METERSNAPSHOT snap;
+	m_ampMeter.measure(databuf, bufsize, numChan, fs, snap);
+	m_visualizer.publish(snap);
 }
 
 void CUserInterface::switchOffAmplitudeMeter() {
-	m_ampMeter.write(0.);
+	// through the visualizer, so an older snapshot can't switch the LEDs on again
+	METERSNAPSHOT snap;
+	snap.numChannels = 1;
+	snap.value[0] = snap.hold[0] = 0.f;
+	snap.numPoints = 0;
+	snap.spectrum = false;
+	snap.frames = 0;
+	m_ampMeter.resetBallistics();
+	m_visualizer.publish(snap);
 }
 
 void CUserInterface::setAmplitudeScaling(CAmpMeter::SCALING_MODE mode) {
 	//   implement setting of AmpMeter scaling here
 	if(mode == CAmpMeter::SCALING_MODE_LIN)
-		m_ampMeter.init(m_playerCVDev, mode, -2, 2, 0);
+		m_ampMeter.init(&m_ledWriter, mode, -2, 2, 0);
 	else
-		m_ampMeter.init(m_playerCVDev, mode, -2, 2, -30);
+		m_ampMeter.init(&m_ledWriter, mode, -2, 2, -30);
 }
 
+void CUserInterface::setAmplitudeMode(CAmpMeter::METER_MODE mode) {
+	m_ampMeter.setMeterMode(mode);
+}
+
+void CUserInterface::setAmplitudeRefreshRate(double refreshRate) {
+	m_visualizer.start(&m_ampMeter, refreshRate);
+}
+
+double CUserInterface::getAmplitudeRefreshRate() {
+	return m_visualizer.getRefreshRate();
+}
+
+void CUserInterface::setAmplitudeLayout(CAmpMeter::LED_LAYOUT layout) {
+	m_ampMeter.setLayout(layout);
+}
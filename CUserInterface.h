@@ -6,6 +6,8 @@ using namespace std;
 #include "CConsoleIO.h"
 #include "CPlayerIOCtrls.h"
 #include "CAmpMeter.h"
+#include "CVisualizer.h"
+#include "CLEDWriter.h"
 #include "CIOWarrior.h"
 
 #define CUI_UNKNOWN 0xffff // error value (maximum valid is CUI_UNKNOWN-1)
@@ -44,12 +46,26 @@ private:
 	 * this component can be attached either to text console or IoWarrior
 	 */
 	CPlayerCVDevice *m_playerCVDev;
+	/**
+	 * writes the LED patterns of the amplitude meter to the device
+	 *
+	 * skips unchanged patterns and limits the rate of the device writes
+	 * (declared before the meter, so it is stopped after the visualizer)
+	 */
+	CLEDWriter m_ledWriter;
 	/**
 	 * amplitude meter
 	 *
-	 * uses the attached control/visualization device to display the signal amplitude
+	 * uses the attached control/visualization device (through the LED writer)
+	 * to display the signal amplitude
 	 */
 	CAmpMeter m_ampMeter;
+	/**
+	 * shows the amplitude meter values from a thread of its own
+	 *
+	 * (declared after the meter, so it is stopped before the meter is destroyed)
+	 */
+	CVisualizer m_visualizer;
 
 public:
 	/**
@@ -72,6 +88,16 @@ public:
 	 */
 	void init(PLAYER_CV_DEVS playerCVDev = CONSOLE);
 
+	/**
+	 * \brief Initializes the user interface with a device created by the caller
+	 *
+	 * (e.g. a scripted device of a test harness). The device is opened but not
+	 * deleted by the user interface.
+	 *
+	 * \param pPlayerCVDev [in] device used for player control / visualization.
+	 */
+	void init(CPlayerCVDevice *pPlayerCVDev);
+
 	/**
 	 * \brief displays a menu and returns the user's choice
 	 *
@@ -145,13 +171,36 @@ public:
 	 */
 	bool keyPressed(bool bBlock = false);
 
+	/**
+	 * waits for pressed ENTER key or IoW button without busy waiting
+	 *
+	 * \param timeout_ms [in] maximum waiting time in milliseconds (CVDEV_WAIT_INFINITE: no limit)
+	 * \return false if the key hasn't been pressed within the timeout
+	 */
+	bool waitKeyPressed(int timeout_ms);
+
+	/**
+	 * \brief lets the console post its input as transport commands (see CConsoleThread::setTransport)
+	 *
+	 * \param pTransport [in] transport queue of the current playback or NULL
+	 * \param pFilter [in] filter of the current playback or NULL
+	 */
+	void setTransport(CTransportQueue *pTransport, CFilterBase *pFilter = NULL);
+
 	/**
 	 * Visualizes the amplitude of a data buffer on the LED line.
 	 *
+	 * The envelope is measured at once (with the meter's ballistics) and shown
+	 * by the visualizer thread at its refresh rate, the call never waits for
+	 * the device.
+	 *
 	 * \param databuf [in]: pointer on data buffer
 	 * \param bufsize [in]: size of data buffer.
+	 * \param numChan [in]: number of interleaved channels of the data buffer
+	 * \param fs [in]: sample rate of the data buffer
 	 */
-	void visualizeAmplitude(float *databuf, int bufsize);
+	void visualizeAmplitude(float *databuf, int bufsize, int numChan = 1,
+			int fs = 44100);
 
 	/**
 	 * Switches the LEDs off.
@@ -164,6 +213,32 @@ public:
 	 * \param mode [in]: scaling of amplitude meter instance
 	 */
 	void setAmplitudeScaling(CAmpMeter::SCALING_MODE mode);
+
+	/**
+	 * sets the value shown by the amplitude meter (peak, RMS or true peak)
+	 *
+	 * \param mode [in]: meter mode of amplitude meter instance
+	 */
+	void setAmplitudeMode(CAmpMeter::METER_MODE mode);
+
+	/**
+	 * sets the assignment of the channels to the LEDs (one bar, 8+8, cycling)
+	 *
+	 * \param layout [in]: LED layout of amplitude meter instance
+	 */
+	void setAmplitudeLayout(CAmpMeter::LED_LAYOUT layout);
+
+	/**
+	 * sets the refresh rate of the amplitude meter (restarts the visualizer)
+	 *
+	 * \param refreshRate [in]: refreshes of the LED bar per second
+	 */
+	void setAmplitudeRefreshRate(double refreshRate);
+
+	/**
+	 * \return refresh rate of the amplitude meter [Hz]
+	 */
+	double getAmplitudeRefreshRate();
 };
 
 #endif /* SRC_CUSERINTERFACE_H_ */
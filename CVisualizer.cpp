@@ -0,0 +1,172 @@
+#include <time.h>
+#include "CVisualizer.h"
+#include "CTrace.h"
+
+CVisualizer::CVisualizer() {
+	m_pMeter = NULL;
+	m_refreshRate = VIS_REFRESHRATE;
+	m_thread = pthread_t { };
+	m_running = false;
+	m_stop = false;
+	pthread_mutex_init(&m_mut, 0);
+	pthread_cond_init(&m_cond, 0);
+	m_numShown = 0;
+	m_numRefreshes = 0;
+	m_cur.numChannels = 0;
+	m_cur.numPoints = 0;
+	m_cur.spectrum = false;
+	m_curShown = 0;
+	m_pError = NULL;
+	m_failed = false;
+}
+
+CVisualizer::~CVisualizer() {
+	stop();
+	pthread_mutex_destroy(&m_mut);
+	pthread_cond_destroy(&m_cond);
+	delete m_pError;
+}
+
+void CVisualizer::start(CAmpMeter *pMeter, double refreshRate) {
+	stop();
+	m_pMeter = pMeter;
+	m_refreshRate = (refreshRate > 0.) ? refreshRate : VIS_REFRESHRATE;
+	m_stop = false;
+	m_numShown = 0;
+	m_numRefreshes = 0;
+	m_cur.numChannels = 0;
+	m_cur.numPoints = 0;
+	m_cur.spectrum = false;
+	m_curShown = 0;
+	delete m_pError;
+	m_pError = NULL;
+	m_failed = false;
+	if (pthread_create(&m_thread, NULL, visualizerThreadHandler, (void*) this) != 0)
+		throw CException(CException::SRC_AmpMeter, CAmpMeter::AMP_E_NOVISUALIZER,
+				"Can't start the visualizer thread.");
+	m_running = true;
+}
+
+void CVisualizer::stop() {
+	if (!m_running)
+		return;
+	pthread_mutex_lock(&m_mut);
+	m_stop = true;
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mut);
+	pthread_join(m_thread, NULL);
+	m_running = false;
+}
+
+void CVisualizer::publish(const METERSNAPSHOT &snap) {
+	if (m_failed.load(memory_order_acquire))
+		throw *m_pError;
+	m_buffer.publish(snap);
+}
+
+double CVisualizer::getRefreshRate() {
+	return m_refreshRate;
+}
+
+unsigned long CVisualizer::getNumShown() {
+	return m_numShown;
+}
+
+unsigned long CVisualizer::getNumRefreshes() {
+	return m_numRefreshes;
+}
+
+void CVisualizer::_refresh() {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (m_buffer.take(m_cur)) {
+		m_curStart = now;
+		m_curShown = -1;
+		m_numShown++;
+	}
+	if (m_cur.spectrum) {
+		// the analysis window ends at the playing position within the block
+		double t = chrono::duration<double>(now - m_curStart).count();
+		long played = t * m_cur.fs;
+		if (played > m_cur.frames)
+			played = m_cur.frames;
+		if (played <= m_curShown)
+			return;
+		m_curShown = played;
+		m_pMeter->writeSpectrum(m_cur.ringPos - m_cur.frames + played, m_cur.fs);
+		m_numRefreshes++;
+		return;
+	}
+
+	int numChan = m_cur.numChannels;
+	if (m_cur.numPoints == 0) {
+		if (m_curShown < 0) {		// snapshot of an empty block (e.g. switch off)
+			m_pMeter->write(m_cur.value, m_cur.hold, numChan);
+			m_curShown = 0;
+			m_numRefreshes++;
+		}
+		return;
+	}
+
+	// the point of the envelope that belongs to the current time
+	double t = chrono::duration<double>(now - m_curStart).count();
+	int idx = t / m_cur.pointDur;
+	if (idx >= m_cur.numPoints)
+		idx = m_cur.numPoints - 1;
+	if (idx <= m_curShown)		// end of the envelope reached, nothing new to show
+		return;
+
+	float values[METER_MAXCHANNELS];
+	for (int ch = 0; ch < numChan; ch++) {
+		values[ch] = 0.f;
+		for (int i = m_curShown + 1; i <= idx; i++)
+			if (values[ch] < m_cur.points[i * numChan + ch])
+				values[ch] = m_cur.points[i * numChan + ch];
+	}
+	m_curShown = idx;
+	m_pMeter->write(values, m_cur.hold, numChan);
+	m_numRefreshes++;
+}
+
+void* CVisualizer::visualizerThreadHandler(void *Obj) {
+	CVisualizer *pV = (CVisualizer*) Obj;
+	TRACE_THREAD("visualizer");
+	long period_ns = 1e9 / pV->m_refreshRate;
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	pthread_mutex_lock(&pV->m_mut);
+	while (!pV->m_stop) {
+		// fixed rate: the next deadline follows from the previous one (unless
+		// a slow device has missed it, then the refreshes don't try to catch up)
+		ts.tv_nsec += period_ns;
+		while (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		if ((ts.tv_sec < now.tv_sec)
+				|| ((ts.tv_sec == now.tv_sec) && (ts.tv_nsec < now.tv_nsec)))
+			ts = now;
+		// wait unlocks at entrance and re-locks at the end
+		while (!pV->m_stop
+				&& (pthread_cond_timedwait(&pV->m_cond, &pV->m_mut, &ts) == 0))
+			;
+		if (pV->m_stop)
+			break;
+		pthread_mutex_unlock(&pV->m_mut);
+
+		try {
+			TRACE_SCOPE("visualize");
+			pV->_refresh();
+		} catch (CException &e) {
+			// reported to the audio path by the next publish()
+			pV->m_pError = new CException(e);
+			pV->m_failed.store(true, memory_order_release);
+			return NULL;
+		}
+		pthread_mutex_lock(&pV->m_mut);
+	}
+	pthread_mutex_unlock(&pV->m_mut);
+	return NULL;
+}
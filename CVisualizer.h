@@ -0,0 +1,127 @@
+#ifndef CVISUALIZER_H_
+#define CVISUALIZER_H_
+
+#include <atomic>
+#include <chrono>
+#include <pthread.h>
+using namespace std;
+
+#include "CAmpMeter.h"
+#include "CMeterBuffer.h"
+#include "CException.h"
+
+/**
+ * default refresh rate of the amplitude meter [Hz]
+ */
+#define VIS_REFRESHRATE 30.
+
+/**
+ * \brief drives the amplitude meter from a thread of its own
+ *
+ * The audio path only measures its blocks and publishes the values as meter
+ * snapshots (wait-free, see CMeterBuffer). The visualizer thread wakes up at
+ * the refresh rate and shows the latest snapshot on the LED bar, so a slow
+ * device (console output, USB write of the IOWarrior) never delays the audio
+ * path. Snapshots published faster than the refresh rate are skipped.
+ *
+ * A snapshot holds the envelope over its block. The visualizer replays it in
+ * real time from the arrival of the snapshot, so the bar moves at the refresh
+ * rate even if a block lasts several refresh periods. Each refresh shows the
+ * maximum of the envelope points since the previous refresh (no peak is
+ * skipped) and the peak hold LED of each channel in the layout of the meter.
+ *
+ * In spectrum mode, the meter analyzes the samples up to the playing position
+ * at each refresh (the FFT runs in the visualizer thread, not in the audio path).
+ *
+ * The configuration of the meter (scaling, thresholds) must not be changed
+ * while the visualizer shows snapshots (i.e. during a playback).
+ */
+class CVisualizer {
+private:
+	CAmpMeter *m_pMeter;
+	CMeterBuffer m_buffer;
+	double m_refreshRate;
+
+	pthread_t m_thread;
+	bool m_running;
+	/**
+	 * stop request (the thread sleeps on the condition between two refreshes)
+	 */
+	bool m_stop;
+	pthread_mutex_t m_mut;
+	pthread_cond_t m_cond;
+
+	/**
+	 * snapshot being replayed, its arrival time and the last point (spectrum
+	 * mode: frame) shown (visualizer thread)
+	 */
+	METERSNAPSHOT m_cur;
+	chrono::steady_clock::time_point m_curStart;
+	int m_curShown;
+
+	/**
+	 * number of snapshots and refreshes shown
+	 */
+	atomic<unsigned long> m_numShown;
+	atomic<unsigned long> m_numRefreshes;
+	/**
+	 * error of the device thrown in the visualizer thread (ends the thread)
+	 */
+	CException *m_pError;
+	atomic<bool> m_failed;
+
+public:
+	CVisualizer();
+	/**
+	 * stops the thread
+	 */
+	~CVisualizer();
+
+	/**
+	 * \brief starts the visualizer thread
+	 * \param pMeter [in] initialized amplitude meter (borrowed)
+	 * \param refreshRate [in] refreshes per second
+	 */
+	void start(CAmpMeter *pMeter, double refreshRate = VIS_REFRESHRATE);
+
+	/**
+	 * \brief stops the visualizer thread (the last snapshot may not be shown)
+	 */
+	void stop();
+
+	/**
+	 * \brief publishes the meter value of a block (audio path, never blocks)
+	 *
+	 * throws the error of the device if the visualizer thread has failed
+	 *
+	 * \param snap [in] snapshot
+	 */
+	void publish(const METERSNAPSHOT &snap);
+
+	double getRefreshRate();
+
+	/**
+	 * \return number of snapshots shown since the start
+	 */
+	unsigned long getNumShown();
+
+	/**
+	 * \return number of LED bar refreshes since the start
+	 */
+	unsigned long getNumRefreshes();
+
+private:
+	/**
+	 * \brief shows the envelope of the current snapshot at the current time (visualizer thread)
+	 */
+	void _refresh();
+
+	/**
+	 * \brief shows the latest snapshot at the refresh rate
+	 *
+	 * \param Obj pointer on the instance
+	 */
+	static void* visualizerThreadHandler(void *Obj);
+};
+
+#endif /* CVISUALIZER_H_ */
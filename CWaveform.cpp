@@ -0,0 +1,398 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include <SKSLib.h>
+#include "CWaveform.h"
+
+/*
+ * rounding of a bucket to the stored resolution (outwards, the stored range
+ * contains the samples)
+ */
+static WAVEBUCKET toBucket(float min, float max, double sq, long frames) {
+	WAVEBUCKET b;
+	double rms = (frames > 0) ? sqrt(sq / frames) : 0.;
+	b.min = fmax(fmin(floor(min * 32767.), 32767.), -32768.);
+	b.max = fmax(fmin(ceil(max * 32767.), 32767.), -32768.);
+	b.rms = fmin(ceil(rms * 65535.), 65535.);
+	b.reserved = 0;
+	return b;
+}
+
+CWaveformBuilder::CWaveformBuilder() {
+	init(1);
+}
+
+void CWaveformBuilder::init(int numChan) {
+	if (numChan <= 0)
+		throw CException(CException::SRC_File, CFileBase::FILE_E_SPECIAL,
+				"invalid number of channels for the waveform overview");
+	m_numChan = numChan;
+	// lcm(numChan, 4)
+	int gcd = (numChan % 4 == 0) ? 4 : ((numChan % 2 == 0) ? 2 : 1);
+	m_numSlots = 4 * numChan / gcd;
+	m_slotMin.assign(m_numSlots, HUGE_VALF);
+	m_slotMax.assign(m_numSlots, -HUGE_VALF);
+	m_slotSq.assign(m_numSlots, 0.f);
+	m_pos = 0;
+	for (int l = 0; l < WAVE_NUMLEVELS; l++) {
+		m_min[l].assign(numChan, HUGE_VALF);
+		m_max[l].assign(numChan, -HUGE_VALF);
+		m_sq[l].assign(numChan, 0.);
+		m_frames[l] = 0;
+		m_buckets[l].clear();
+	}
+}
+
+void CWaveformBuilder::analyze(const float *buf, long frames) {
+	long n = frames * m_numChan;
+	long bucketSamples = WAVE_BUCKETFRAMES * m_numChan;
+	while (n > 0) {
+		long k = bucketSamples - m_pos;
+		if (k > n)
+			k = n;
+		_accumulate(buf, k);
+		buf += k;
+		n -= k;
+		if (m_pos == bucketSamples)
+			_endBucket(0);
+	}
+}
+
+void CWaveformBuilder::finish() {
+	if (m_pos > 0)
+		_endBucket(0);
+	for (int l = 1; l < WAVE_NUMLEVELS; l++)
+		if (m_frames[l] > 0)
+			_endBucket(l);
+}
+
+int CWaveformBuilder::getNumChannels() {
+	return m_numChan;
+}
+
+const vector<WAVEBUCKET>& CWaveformBuilder::getBuckets(int level) {
+	return m_buckets[level];
+}
+
+long CWaveformBuilder::getBucketFrames(int level) {
+	long frames = WAVE_BUCKETFRAMES;
+	for (int l = 0; l < level; l++)
+		frames *= WAVE_LEVELRATIO;
+	return frames;
+}
+
+void CWaveformBuilder::_accumulate(const float *buf, long n) {
+	float *pMin = m_slotMin.data();
+	float *pMax = m_slotMax.data();
+	float *pSq = m_slotSq.data();
+	long i = 0;
+	int slot = m_pos % m_numSlots;
+#ifdef __SSE__
+	// up to the beginning of the slots
+	for (; (i < n) && (slot != 0); i++) {
+		float x = buf[i];
+		pMin[slot] = fmin(pMin[slot], x);
+		pMax[slot] = fmax(pMax[slot], x);
+		pSq[slot] += x * x;
+		if (++slot == m_numSlots)
+			slot = 0;
+	}
+	// all slots at a time, one vector of slots after the other
+	long rounds = (n - i) / m_numSlots;
+	if (rounds > 0) {
+		for (int j = 0; j < m_numSlots; j += 4) {
+			__m128 mn = _mm_loadu_ps(pMin + j);
+			__m128 mx = _mm_loadu_ps(pMax + j);
+			__m128 sq = _mm_loadu_ps(pSq + j);
+			const float *p = buf + i + j;
+			for (long r = 0; r < rounds; r++, p += m_numSlots) {
+				__m128 x = _mm_loadu_ps(p);
+				mn = _mm_min_ps(mn, x);
+				mx = _mm_max_ps(mx, x);
+				sq = _mm_add_ps(sq, _mm_mul_ps(x, x));
+			}
+			_mm_storeu_ps(pMin + j, mn);
+			_mm_storeu_ps(pMax + j, mx);
+			_mm_storeu_ps(pSq + j, sq);
+		}
+		i += rounds * m_numSlots;
+	}
+#endif
+	for (; i < n; i++) {
+		float x = buf[i];
+		pMin[slot] = fmin(pMin[slot], x);
+		pMax[slot] = fmax(pMax[slot], x);
+		pSq[slot] += x * x;
+		if (++slot == m_numSlots)
+			slot = 0;
+	}
+	m_pos += n;
+}
+
+void CWaveformBuilder::_endBucket(int level) {
+	long frames;
+	if (level == 0) {
+		// channels of the slots
+		for (int s = 0; s < m_numSlots; s++) {
+			int c = s % m_numChan;
+			m_min[0][c] = fmin(m_min[0][c], m_slotMin[s]);
+			m_max[0][c] = fmax(m_max[0][c], m_slotMax[s]);
+			m_sq[0][c] += m_slotSq[s];
+		}
+		m_slotMin.assign(m_numSlots, HUGE_VALF);
+		m_slotMax.assign(m_numSlots, -HUGE_VALF);
+		m_slotSq.assign(m_numSlots, 0.f);
+		frames = m_pos / m_numChan;
+		m_pos = 0;
+	} else
+		frames = m_frames[level];
+
+	for (int c = 0; c < m_numChan; c++) {
+		m_buckets[level].push_back(
+				toBucket(m_min[level][c], m_max[level][c], m_sq[level][c], frames));
+		if (level + 1 < WAVE_NUMLEVELS) {
+			m_min[level + 1][c] = fmin(m_min[level + 1][c], m_min[level][c]);
+			m_max[level + 1][c] = fmax(m_max[level + 1][c], m_max[level][c]);
+			m_sq[level + 1][c] += m_sq[level][c];
+		}
+	}
+	m_min[level].assign(m_numChan, HUGE_VALF);
+	m_max[level].assign(m_numChan, -HUGE_VALF);
+	m_sq[level].assign(m_numChan, 0.);
+	m_frames[level] = 0;
+
+	if (level + 1 < WAVE_NUMLEVELS) {
+		m_frames[level + 1] += frames;
+		if (m_frames[level + 1] == getBucketFrames(level + 1))
+			_endBucket(level + 1);
+	}
+}
+
+CWaveformFile::CWaveformFile(string path, FILEMODES mode) :
+		CFileBase(path, mode) {
+	m_pData = NULL;
+	m_dataSize = 0;
+	m_mapped = false;
+	m_pHeader = NULL;
+}
+
+CWaveformFile::~CWaveformFile() {
+	close();
+}
+
+void CWaveformFile::write(CWaveformBuilder &builder, CSoundFile &sfile) {
+	if (!isFileW() && !isFileWA())
+		throw CException(CException::SRC_File, FILE_E_CANTWRITE,
+				getErrorTxt(FILE_E_CANTWRITE));
+
+	WAVEHEADER hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, WAVE_MAGIC, 4);
+	hdr.version = WAVE_VERSION;
+	hdr.numChan = builder.getNumChannels();
+	hdr.fs = sfile.getSampleRate();
+	hdr.frames = sfile.getNumFrames();
+	struct stat st;
+	if (stat(sfile.getPath().c_str(), &st) == 0) {
+		hdr.size = st.st_size;
+		hdr.mtime = st.st_mtime;
+	}
+	hdr.numLevels = WAVE_NUMLEVELS;
+	uint64_t offset = sizeof(hdr);
+	for (int l = 0; l < WAVE_NUMLEVELS; l++) {
+		hdr.levels[l].bucketFrames = CWaveformBuilder::getBucketFrames(l);
+		hdr.levels[l].numBuckets = builder.getBuckets(l).size() / hdr.numChan;
+		hdr.levels[l].offset = offset;
+		offset += builder.getBuckets(l).size() * sizeof(WAVEBUCKET);
+	}
+
+	/*
+	 * the file may be mapped by a reader (e.g. the overview of the player): it is
+	 * replaced by a complete new file, truncating it would invalidate the mapping
+	 */
+	string tmpPath = m_path + ".tmp";
+	FILE *pFile = fopen(tmpPath.c_str(), "wb");
+	if (pFile == NULL)
+		throw CException(CException::SRC_File, FILE_E_NOFILE,
+				getErrorTxt(FILE_E_NOFILE));
+	bool ok = (fwrite(&hdr, sizeof(hdr), 1, pFile) == 1);
+	for (int l = 0; ok && (l < WAVE_NUMLEVELS); l++) {
+		const vector<WAVEBUCKET> &b = builder.getBuckets(l);
+		ok = (fwrite(b.data(), sizeof(WAVEBUCKET), b.size(), pFile) == b.size());
+	}
+	if ((fclose(pFile) != 0) || !ok) {
+		remove(tmpPath.c_str());
+		ok = false;
+	} else
+		ok = replaceFile(tmpPath, m_path);
+	if (!ok)
+		throw CException(CException::SRC_File, FILE_E_WRITE,
+				getErrorTxt(FILE_E_WRITE));
+}
+
+bool CWaveformFile::open() {
+	if (!isFileR())
+		throw CException(CException::SRC_File, FILE_E_CANTREAD,
+				getErrorTxt(FILE_E_CANTREAD));
+	close();
+#ifdef _WIN32
+	ifstream file(m_path.c_str(), ios::binary | ios::ate);
+	if (!file)
+		return false;
+	m_dataSize = file.tellg();
+	char *pData = new char[m_dataSize];
+	file.seekg(0);
+	if (!file.read(pData, m_dataSize)) {
+		delete[] pData;
+		m_dataSize = 0;
+		return false;
+	}
+	m_pData = pData;
+#else
+	int fd = ::open(m_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	void *p = MAP_FAILED;
+	if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);	// the mapping remains
+	if (p == MAP_FAILED)
+		return false;
+	m_pData = (const char*) p;
+	m_dataSize = st.st_size;
+	m_mapped = true;
+#endif
+
+	// a file of another format or an incomplete file is not used
+	const WAVEHEADER *pHdr = (const WAVEHEADER*) m_pData;
+	bool valid = (m_dataSize >= sizeof(WAVEHEADER))
+			&& (memcmp(pHdr->magic, WAVE_MAGIC, 4) == 0)
+			&& (pHdr->version == WAVE_VERSION) && (pHdr->numChan > 0)
+			&& (pHdr->numLevels == WAVE_NUMLEVELS);
+	for (int l = 0; valid && (l < WAVE_NUMLEVELS); l++) {
+		const WAVELEVEL &lev = pHdr->levels[l];
+		valid = (lev.bucketFrames == CWaveformBuilder::getBucketFrames(l))
+				&& (lev.offset % sizeof(WAVEBUCKET) == 0)
+				&& (lev.offset + lev.numBuckets * pHdr->numChan * sizeof(WAVEBUCKET)
+						<= m_dataSize);
+	}
+	if (!valid) {
+		close();
+		return false;
+	}
+	m_pHeader = pHdr;
+	return true;
+}
+
+void CWaveformFile::close() {
+	if (m_pData == NULL)
+		return;
+#ifdef _WIN32
+	delete[] m_pData;
+#else
+	if (m_mapped)
+		munmap((void*) m_pData, m_dataSize);
+#endif
+	m_pData = NULL;
+	m_dataSize = 0;
+	m_mapped = false;
+	m_pHeader = NULL;
+}
+
+bool CWaveformFile::isCurrent(CSoundFile &sfile) {
+	struct stat st;
+	if ((m_pHeader == NULL) || (stat(sfile.getPath().c_str(), &st) != 0))
+		return false;
+	return (m_pHeader->frames == (uint64_t) sfile.getNumFrames())
+			&& (m_pHeader->fs == (uint32_t) sfile.getSampleRate())
+			&& (m_pHeader->numChan == (uint32_t) sfile.getNumChannels())
+			&& (m_pHeader->size == (int64_t) st.st_size)
+			&& (m_pHeader->mtime == (int64_t) st.st_mtime);
+}
+
+long CWaveformFile::getNumFrames() {
+	return m_pHeader ? m_pHeader->frames : 0;
+}
+
+int CWaveformFile::getNumChannels() {
+	return m_pHeader ? m_pHeader->numChan : 0;
+}
+
+int CWaveformFile::getSampleRate() {
+	return m_pHeader ? m_pHeader->fs : 0;
+}
+
+void CWaveformFile::getPeaks(int channel, long startFrame, long numFrames,
+		WAVEPEAK *pPeaks, int numPeaks) {
+	if (m_pHeader == NULL)
+		throw CException(CException::SRC_File, FILE_E_FILENOTOPEN,
+				getErrorTxt(FILE_E_FILENOTOPEN));
+	int numChan = m_pHeader->numChan;
+	if ((channel < 0) || (channel >= numChan) || (numFrames <= 0) || (numPeaks <= 0))
+		throw CException(CException::SRC_File, FILE_E_SPECIAL,
+				getErrorTxt(FILE_E_SPECIAL) + "invalid waveform range");
+
+	// coarsest level with at least one bucket per part
+	double framesPerPeak = (double) numFrames / numPeaks;
+	int level = 0;
+	while ((level + 1 < WAVE_NUMLEVELS)
+			&& (m_pHeader->levels[level + 1].bucketFrames <= framesPerPeak))
+		level++;
+	const WAVELEVEL &lev = m_pHeader->levels[level];
+	const WAVEBUCKET *pB = (const WAVEBUCKET*) (m_pData + lev.offset) + channel;
+	long numBuckets = lev.numBuckets;
+
+	for (int p = 0; p < numPeaks; p++) {
+		long f0 = startFrame + (long) (p * framesPerPeak);
+		long f1 = startFrame + (long) ((p + 1) * framesPerPeak);
+		if (f1 <= f0)
+			f1 = f0 + 1;		// part of less than a frame
+		long b0 = (f0 >= 0) ? f0 / lev.bucketFrames : 0;
+		long b1 = (f1 + lev.bucketFrames - 1) / (long) lev.bucketFrames;
+		if (b1 > numBuckets)
+			b1 = numBuckets;
+		if ((f1 <= 0) || (b0 >= b1)) {
+			// outside of the sound file
+			pPeaks[p].min = pPeaks[p].max = pPeaks[p].rms = 0.f;
+			continue;
+		}
+		int mn = 32767, mx = -32768;
+		double sq = 0.;
+		for (long b = b0; b < b1; b++) {
+			const WAVEBUCKET &bucket = pB[b * numChan];
+			if (bucket.min < mn)
+				mn = bucket.min;
+			if (bucket.max > mx)
+				mx = bucket.max;
+			sq += (double) bucket.rms * bucket.rms;
+		}
+		pPeaks[p].min = mn / 32767.f;
+		pPeaks[p].max = mx / 32767.f;
+		pPeaks[p].rms = sqrt(sq / (b1 - b0)) / 65535.f;
+	}
+}
+
+void CWaveformFile::print(void) {
+	CFileBase::print();
+	if (m_pHeader == NULL)
+		return;
+	cout << "channels = " << m_pHeader->numChan << ", fs = " << m_pHeader->fs
+			<< ", frames = " << m_pHeader->frames << endl;
+	for (int l = 0; l < WAVE_NUMLEVELS; l++)
+		cout << "level " << l << ": " << m_pHeader->levels[l].numBuckets
+				<< " buckets of " << m_pHeader->levels[l].bucketFrames << " frames"
+				<< endl;
+}
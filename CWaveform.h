@@ -0,0 +1,231 @@
+#ifndef CWAVEFORM_H_
+#define CWAVEFORM_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "CFile.h"
+
+/**
+ * the waveform overview of a sound file is stored in a file with the path of
+ * the sound file and this extension (see CWaveformFile)
+ */
+#define WAVE_EXT ".peaks"
+/**
+ * levels of the pyramid: frames per bucket of the finest level and ratio of
+ * the bucket sizes of neighbouring levels (256, 4096 and 65536 frames)
+ */
+#define WAVE_NUMLEVELS 3
+#define WAVE_BUCKETFRAMES 256
+#define WAVE_LEVELRATIO 16
+/**
+ * identification and version of the file format
+ */
+#define WAVE_MAGIC "WPYR"
+#define WAVE_VERSION 1
+
+/**
+ * \brief minimum, maximum and rms of a bucket of one channel in the file
+ *
+ * min and max are rounded outwards to 1/32767 (the bucket is within the
+ * stored range), rms is rounded up to 1/65535
+ */
+struct WAVEBUCKET {
+	int16_t min;
+	int16_t max;
+	uint16_t rms;
+	uint16_t reserved;
+};
+
+/**
+ * \brief description of a level in the header of the file
+ */
+struct WAVELEVEL {
+	uint32_t bucketFrames;	// frames per bucket
+	uint32_t reserved;
+	uint64_t numBuckets;	// buckets per channel
+	uint64_t offset;		// file offset of the buckets (interleaved channels)
+};
+
+/**
+ * \brief header of the file (the levels follow, all little endian and aligned,
+ * so the file may be mapped into memory as it is)
+ */
+struct WAVEHEADER {
+	char magic[4];			// WAVE_MAGIC
+	uint32_t version;		// WAVE_VERSION
+	uint32_t numChan;
+	uint32_t fs;
+	uint64_t frames;
+	int64_t size;			// size and modification time of the sound file
+	int64_t mtime;
+	uint32_t numLevels;
+	uint32_t reserved;
+	WAVELEVEL levels[WAVE_NUMLEVELS];
+};
+
+/**
+ * \brief minimum, maximum and rms of a range of frames of one channel
+ */
+struct WAVEPEAK {
+	float min;
+	float max;
+	float rms;
+};
+
+/**
+ * \brief builds the min/max/rms pyramid of a sound file in one streaming pass
+ *
+ * The buckets of the finest level are computed from the samples, those of the
+ * coarser levels from the exact (not rounded) values of the finer ones. With
+ * SSE, the samples of a bucket are accumulated four at a time in slots of
+ * lcm(channels, 4) samples, the channels are separated at the end of the bucket.
+ */
+class CWaveformBuilder {
+private:
+	int m_numChan;
+	/**
+	 * slots of the accumulators (multiple of 4 and of the channels) and minimum,
+	 * maximum and squared sum per slot of the current bucket of the finest level
+	 */
+	int m_numSlots;
+	vector<float> m_slotMin;
+	vector<float> m_slotMax;
+	vector<float> m_slotSq;
+	/**
+	 * samples of the current bucket of the finest level
+	 */
+	long m_pos;
+	/**
+	 * current bucket of each level per channel (minimum, maximum, squared sum)
+	 * and its number of frames
+	 */
+	vector<float> m_min[WAVE_NUMLEVELS];
+	vector<float> m_max[WAVE_NUMLEVELS];
+	vector<double> m_sq[WAVE_NUMLEVELS];
+	long m_frames[WAVE_NUMLEVELS];
+	/**
+	 * complete buckets of each level (interleaved channels)
+	 */
+	vector<WAVEBUCKET> m_buckets[WAVE_NUMLEVELS];
+
+public:
+	CWaveformBuilder();
+
+	/**
+	 * \brief prepares a new pyramid
+	 * \param numChan [in] number of interleaved channels
+	 */
+	void init(int numChan);
+
+	/**
+	 * \brief adds a buffer to the pyramid
+	 * \param buf [in] interleaved samples
+	 * \param frames [in] number of frames
+	 */
+	void analyze(const float *buf, long frames);
+
+	/**
+	 * \brief completes the last (incomplete) buckets, called after the last buffer
+	 */
+	void finish();
+
+	int getNumChannels();
+
+	/**
+	 * \return buckets of a level (interleaved channels)
+	 */
+	const vector<WAVEBUCKET>& getBuckets(int level);
+
+	/**
+	 * \return frames per bucket of a level
+	 */
+	static long getBucketFrames(int level);
+
+private:
+	/**
+	 * \brief adds samples of the current bucket of the finest level to the slots
+	 * \param buf [in] interleaved samples
+	 * \param n [in] number of samples (not more than the rest of the bucket)
+	 */
+	void _accumulate(const float *buf, long n);
+
+	/**
+	 * \brief ends the current bucket of a level and adds it to the next level
+	 */
+	void _endBucket(int level);
+};
+
+/**
+ * \brief file of the waveform pyramid of a sound file
+ *
+ * The file is written once from a CWaveformBuilder and mapped into memory (read
+ * into memory without mmap), so queries at any zoom level only combine a few
+ * buckets of the best level and don't touch the sound file.
+ */
+class CWaveformFile: public CFileBase {
+private:
+	/**
+	 * contents of the file (NULL if not open) and their size
+	 */
+	const char *m_pData;
+	size_t m_dataSize;
+	bool m_mapped;
+	const WAVEHEADER *m_pHeader;
+
+public:
+	/**
+	 * initializes attributes
+	 */
+	CWaveformFile(string path, FILEMODES mode = FILE_MODEUNKNOWN);
+	~CWaveformFile();
+
+	/**
+	 * \brief writes the pyramid of a sound file (replaces the file)
+	 * \param builder [in] finished pyramid
+	 * \param sfile [in] open sound file the pyramid has been built from
+	 */
+	void write(CWaveformBuilder &builder, CSoundFile &sfile);
+
+	/**
+	 * \brief maps the file into memory
+	 * \return false if the file doesn't exist or is not a valid pyramid
+	 */
+	bool open();
+
+	void close();
+
+	/**
+	 * \param sfile [in] open sound file
+	 * \return true if the open file belongs to the current version of the sound file
+	 */
+	bool isCurrent(CSoundFile &sfile);
+
+	long getNumFrames();
+	int getNumChannels();
+	int getSampleRate();
+
+	/**
+	 * \brief minimum, maximum and rms of equal parts of a range of frames
+	 *
+	 * the parts are computed from the coarsest level with at least one bucket per
+	 * part, so the answer doesn't depend on the length of the range
+	 *
+	 * \param channel [in] channel
+	 * \param startFrame [in] first frame of the range
+	 * \param numFrames [in] number of frames of the range
+	 * \param pPeaks [out] one entry per part (e.g. per pixel of an overview)
+	 * \param numPeaks [in] number of parts
+	 */
+	void getPeaks(int channel, long startFrame, long numFrames, WAVEPEAK *pPeaks,
+			int numPeaks);
+
+	/**
+	 * prints the header on console
+	 */
+	void print(void);
+};
+
+#endif /* CWAVEFORM_H_ */
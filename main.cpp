@@ -1,5 +1,14 @@
 #include "CAudioPlayerController.h"
+#include "CMixer.h"
+#include "CBlockPool.h"
+#include "CBatchRenderer.h"
+#include "CBenchmark.h"
+#include "CLatencyHarness.h"
+#include "CBlockSizer.h"
+#include <fstream>
 #include <iostream>
+#include <chrono>
+#include <math.h>
 
 /**
  * horizontal divider for test list output
@@ -13,18 +22,51 @@ string hDivider(80, '-');
  */
 
 void Test01_SoundFilterPlayTest(string &soundfile, string &sndfile_w,
-		string &fltfile);
+		string &fltfile, CBlockPool &pool);
+void Test02_MixerBenchmark(CBlockPool &pool);
+int BatchRender(int argc, char *argv[], CBlockPool &pool);
+int Benchmark(int argc, char *argv[]);
+int LatencyTest(int argc, char *argv[]);
 
-int main(void) {
+int main(int argc, char *argv[]) {
 	setvbuf(stdout, NULL, _IONBF, 0);
+
+	// headless batch mode: no tests, no audio device, no user interface
+	if ((argc > 1) && (string(argv[1]) == "--render")) {
+		CBlockPool batchPool;
+		return BatchRender(argc - 2, argv + 2, batchPool);
+	}
+	// micro benchmarks of the hot paths and of the mixer
+	if ((argc > 1) && (string(argv[1]) == "--bench")) {
+		CBlockPool benchPool;
+		Test02_MixerBenchmark(benchPool);
+		return Benchmark(argc - 2, argv + 2);
+	}
+	// end to end latencies with scripted key presses
+	if ((argc > 1) && (string(argv[1]) == "--latency"))
+		return LatencyTest(argc - 2, argv + 2);
+
 	cout << "Systemintegration started" << endl;
 	string sndname = "jazzyfrenchy";
 	string sndf = ".\\files\\sounds\\" + sndname + ".wav";
 	string sndfw = ".\\files\\sounds\\" + sndname + "_filtered.wav";
 	string fltf = ".\\files\\filters\\2000Hz_lowpass_Order6.txt";
-	Test01_SoundFilterPlayTest(sndf, sndfw, fltf);
 
-	CAudioPlayerController myController; 	// create the controller
+	// block buffers of the tests and the player (preallocated for stereo up to 48 kHz
+	// and the default latency target: 125 ms blocks of Test01 and the play queue,
+	// up to twice as long blocks of the playback pipeline)
+	CBlockPool blockPool;
+	try {
+		blockPool.reserve(2 * 6200, 4);
+		blockPool.reserve(2 * 2 * 6200, 2 * PIPE_NUMBLOCKS);
+	} catch (CException &e) {
+		cout << e << endl;
+		return -1;
+	}
+
+	Test01_SoundFilterPlayTest(sndf, sndfw, fltf, blockPool);
+
+	CAudioPlayerController myController(&blockPool); 	// create the controller
 
 	try {
 		myController.run();					// run the controller
@@ -36,7 +78,11 @@ int main(void) {
 
 // Test01 SoundFilterPlayTest() implemented here
 void Test01_SoundFilterPlayTest(string &soundfile, string &sndfile_w,
-		string &fltfile) {
+		string &fltfile, CBlockPool &pool) {
+
+	// the pool buffers are returned after the try block (also after an error)
+	float *sbufBlock = NULL;
+	float *sbufBlock_f = NULL;
 
 	try{
 
@@ -64,14 +110,16 @@ void Test01_SoundFilterPlayTest(string &soundfile, string &sndfile_w,
 
 		CAudioOutStream caudiostream;
 
-		float block_Duration = 1; //Block Duration in seconds
-
-		long framesPerBlock = sndfile.getSampleRate() * block_Duration;
+		// block size from the measured cost of reading and filtering
+		CBlockSizer sizer;
+		sizer.calibrate(&sndfile, &fltr);
+		long framesPerBlock = sizer.getFramesPerBlock(sndfile.getSampleRate());
+		cout << sizer.getStateStr(sndfile.getSampleRate());
 
 		int sbufsize = sndfile.getNumChannels() * framesPerBlock;
 
-		float *sbufBlock = new float[sbufsize];
-		float *sbufBlock_f = new float[sbufsize];
+		sbufBlock = pool.acquire(sbufsize);
+		sbufBlock_f = pool.acquire(sbufsize);
 
 		caudiostream.open(sndfile.getNumChannels(), sndfile.getSampleRate(), framesPerBlock);
 		caudiostream.start();
@@ -93,8 +141,6 @@ void Test01_SoundFilterPlayTest(string &soundfile, string &sndfile_w,
 		caudiostream.stop();
 		cout << endl << __FUNCTION__ << " finished." << endl << hDivider << endl;
 		caudiostream.close();
-		delete[] sbufBlock, 					//Destroy Original Signal Buffer
-		delete[] sbufBlock_f,					//Destroy Filtered Signal Buffer
 		sndfile.close();
 		soundfile_f.close();
 
@@ -104,7 +150,177 @@ void Test01_SoundFilterPlayTest(string &soundfile, string &sndfile_w,
 	{
 		err.print();
 	}
+	pool.release(sbufBlock); 				//Return Original Signal Buffer
+	pool.release(sbufBlock_f);				//Return Filtered Signal Buffer
 }
 
+/**
+ * synthetic stereo mixer source: repeats one period of a sine wave (no file
+ * access, so the benchmark measures the mixer only)
+ */
+class CSineSource: public CMixerSource {
+private:
+	float m_period[2 * 960];
+	int m_len;
+	int m_pos;
+public:
+	CSineSource(int periodFrames) {
+		m_len = (periodFrames > 960) ? 960 : periodFrames;
+		m_pos = 0;
+		for (int k = 0; k < m_len; k++)
+			m_period[2 * k] = m_period[2 * k + 1] = sin(2 * M_PI * k / m_len);
+	}
+	int getNumChannels() {
+		return 2;
+	}
+	int read(float *buf, int frames) {
+		for (int k = 0; k < frames; k++) {
+			buf[2 * k] = m_period[2 * m_pos];
+			buf[2 * k + 1] = m_period[2 * m_pos + 1];
+			if (++m_pos == m_len)
+				m_pos = 0;
+		}
+		return frames;
+	}
+};
+
+// Test02 MixerBenchmark() implemented here
+void Test02_MixerBenchmark(CBlockPool &pool) {
+	cout << endl << hDivider << endl << __FUNCTION__ << " started." << endl << endl;
 
+	const int fs = 48000, framesPerBlock = 512, numBlocks = 938;	// 10 s of stereo audio
+	float *mixblock = pool.acquire(2 * framesPerBlock);
 
+	for (int numSources = 1; numSources <= MIX_MAXSOURCES; numSources *= 2) {
+		CMixer mixer(2, framesPerBlock);
+		for (int i = 0; i < numSources; i++)
+			mixer.addSource(new CSineSource(480 / (i + 1)), 1.f / numSources);
+
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		for (int b = 0; b < numBlocks; b++) {
+			// changing gains exercise the ramps
+			mixer.setGain(0, (b & 1) ? 0.5f : 1.f);
+			mixer.process(mixblock, framesPerBlock);
+		}
+		double dt = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+		double audioSec = (double) numBlocks * framesPerBlock / fs;
+		cout << numSources << " sources: " << dt * 1e3 << " ms for " << audioSec
+				<< " s audio, " << numSources * numBlocks * framesPerBlock * 2 / dt / 1e6
+				<< " Msamples/s mixed, " << audioSec / dt << "x realtime" << endl;
+	}
+	pool.release(mixblock);
+
+	cout << endl << __FUNCTION__ << " finished." << endl << hDivider << endl;
+}
+
+/**
+ * batch render mode (filters files faster than real time without audio output)
+ *
+ * arguments: [-j threads] soundfile filterfile outputfile [soundfile filterfile outputfile ...]
+ * ("-" as filter file: no filter, threads default to the number of cores)
+ *
+ * \return number of files that could not be rendered (-1: wrong arguments)
+ */
+int BatchRender(int argc, char *argv[], CBlockPool &pool) {
+	int numThreads = 0, first = 0;
+	if ((argc >= 2) && (string(argv[0]) == "-j")) {
+		numThreads = atoi(argv[1]);
+		first = 2;
+	}
+	if ((argc - first < 3) || ((argc - first) % 3)) {
+		cout << "usage: --render [-j threads] soundfile filterfile outputfile [...]"
+				<< endl << "       (filterfile \"-\": no filter)" << endl;
+		return -1;
+	}
+
+	try {
+		CBatchRenderer renderer(&pool);
+		for (int i = first; i < argc; i += 3) {
+			string flt = argv[i + 1];
+			renderer.addJob(argv[i], (flt == "-") ? "" : flt, argv[i + 2]);
+		}
+
+		int failed = renderer.run(numThreads);
+
+		for (int i = 0; i < renderer.getNumJobs(); i++) {
+			CBatchRenderer::JOB job = renderer.getJob(i);
+			if (job.ok) {
+				double sec = (double) job.frames / job.fs;
+				cout << job.outPath << ": " << sec << " s audio in " << job.seconds
+						<< " s (" << sec / job.seconds << "x realtime)" << endl;
+			} else
+				cout << job.inPath << ": failed: " << job.error << endl;
+		}
+		cout << renderer.getNumJobs() - failed << " of " << renderer.getNumJobs()
+				<< " files rendered, " << renderer.getAudioSeconds() << " s audio in "
+				<< renderer.getWallTime() << " s (" << renderer.getRealtimeFactor()
+				<< "x realtime)" << endl;
+		return failed;
+	} catch (CException &e) {
+		cout << e << endl;
+		return -1;
+	}
+}
+
+/**
+ * micro benchmark mode
+ *
+ * arguments: [jsonfile] (results are written as JSON to the file, otherwise to stdout)
+ *
+ * \return 0 or -1 on errors
+ */
+int Benchmark(int argc, char *argv[]) {
+	try {
+		CBenchmark bench;
+		bench.run();
+		cout << bench.getResultStr();
+		if (argc > 0) {
+			ofstream json(argv[0]);
+			if (!json) {
+				cout << "Can't write " << argv[0] << endl;
+				return -1;
+			}
+			json << bench.getJSON();
+		} else
+			cout << bench.getJSON();
+		return 0;
+	} catch (CException &e) {
+		cout << e << endl;
+		return -1;
+	}
+}
+
+/**
+ * latency measurement mode (needs an audio output device)
+ *
+ * arguments: [trials [jsonfile]] (default: 20 trials, JSON to stdout)
+ *
+ * \return 0 or -1 on errors
+ */
+int LatencyTest(int argc, char *argv[]) {
+	int numTrials = (argc > 0) ? atoi(argv[0]) : 20;
+	if (numTrials <= 0) {
+		cout << "usage: --latency [trials [jsonfile]]" << endl;
+		return -1;
+	}
+	try {
+		CBlockPool pool;
+		CLatencyHarness harness(&pool);
+		harness.run(numTrials);
+		cout << harness.getResultStr();
+		if (argc > 1) {
+			ofstream json(argv[1]);
+			if (!json) {
+				cout << "Can't write " << argv[1] << endl;
+				return -1;
+			}
+			json << harness.getJSON();
+		} else
+			cout << harness.getJSON();
+		return 0;
+	} catch (CException &e) {
+		cout << e << endl;
+		return -1;
+	}
+}